@@ -0,0 +1,147 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "arena.h"
+#include "utilities.h"
+#include <assert.h>
+#include <string.h>
+
+enum { arena_default_block_size = 64*1024 };
+
+// All allocations are rounded up to a multiple of this many bytes, which is
+// enough for any of the types we store (pointers, doubles, size_t).
+enum { arena_alignment = 8 };
+
+typedef struct Block Block;
+struct Block {
+    Block* next;    // next block in the arena's chain, or null
+    size_t size;    // usable bytes in `data`
+    double data[1]; // start of usable memory (double for alignment)
+};
+
+struct Json_arena {
+    Block* head;        // first block in the chain
+    Block* curr;        // block currently being carved up
+    char* next;         // next free byte in `curr`
+    char* limit;        // one past the last usable byte in `curr`
+    size_t block_size;  // minimum size of newly allocated blocks
+    size_t used;        // bytes handed out from blocks before `curr`
+};
+
+static void _use_block(Json_arena* a, Block* b)
+{
+    if (a->curr != NULL) {
+        a->used += a->next - (char*) a->curr->data;
+    }
+    a->curr = b;
+    a->next = (char*) b->data;
+    a->limit = a->next + b->size;
+}
+
+// Moves on to a block that can hold `n` bytes. Blocks left over from before
+// the last reset are reused when they are large enough; otherwise a new block
+// is spliced into the chain after the current one.
+static void _next_block(Json_arena* a, size_t n)
+{
+    Block* b = a->curr ? a->curr->next : a->head;
+
+    if (b == NULL || b->size < n) {
+        const size_t size = n > a->block_size ? n : a->block_size;
+        Block* new_block = (Block*) emalloc(sizeof(Block) + size);
+        new_block->size = size;
+        new_block->next = b;
+        if (a->curr != NULL) {
+            a->curr->next = new_block;
+        } else {
+            a->head = new_block;
+        }
+        b = new_block;
+    }
+    _use_block(a, b);
+}
+
+Json_arena* json_arena_create(size_t block_size)
+{
+    Json_arena* a = (Json_arena*) emalloc(sizeof(Json_arena));
+    a->head = a->curr = NULL;
+    a->next = a->limit = NULL;
+    a->block_size = block_size > 0 ? block_size : arena_default_block_size;
+    a->used = 0;
+    return a;
+}
+
+void json_arena_destroy(Json_arena* a)
+{
+    if (!a) return;
+
+    Block* b = a->head;
+    while (b != NULL) {
+        Block* next = b->next;
+        free(b);
+        b = next;
+    }
+    free(a);
+}
+
+void json_arena_reset(Json_arena* a)
+{
+    a->curr = NULL;
+    a->next = a->limit = NULL;
+    a->used = 0;
+}
+
+void* json_arena_alloc(Json_arena* a, size_t n)
+{
+    n = (n + arena_alignment - 1) & ~(size_t) (arena_alignment - 1);
+    if ((size_t) (a->limit - a->next) < n) {
+        _next_block(a, n);
+    }
+    void* p = a->next;
+    a->next += n;
+    return p;
+}
+
+char* json_arena_strdup(Json_arena* a, const char* s)
+{
+    if (s == NULL) {
+        return NULL;
+    }
+    const size_t n = strlen(s) + 1;
+    char* t = (char*) json_arena_alloc(a, n);
+    memcpy(t, s, n);
+    return t;
+}
+
+size_t json_arena_bytes_used(const Json_arena* a)
+{
+    if (a->curr == NULL) {
+        return 0;
+    }
+    return a->used + (a->next - (char*) a->curr->data);
+}
+
+Json_arena_mark json_arena_mark(const Json_arena* a)
+{
+    Json_arena_mark mark;
+    mark.block = a->curr;
+    mark.next = a->next;
+    mark.used = a->used;
+    return mark;
+}
+
+void json_arena_rewind(Json_arena* a, Json_arena_mark mark)
+{
+    if (mark.block == NULL) {
+        json_arena_reset(a);
+        return;
+    }
+    a->curr = (Block*) mark.block;
+    a->next = mark.next;
+    a->limit = (char*) a->curr->data + a->curr->size;
+    a->used = mark.used;
+}
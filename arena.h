@@ -0,0 +1,58 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_ARENA__
+#define __INCLUDED_LIBJSON_ARENA__
+
+// Bump allocator for documents that are built and thrown away as a unit.
+// Allocations are never freed individually; the whole arena is rewound by
+// json_arena_reset (keeping its memory for reuse) or released by
+// json_arena_destroy.
+
+#include <stddef.h>
+
+typedef struct Json_arena Json_arena;
+
+// Creates an empty arena. Memory is obtained from malloc in blocks of at least
+// `block_size` bytes; a zero `block_size` selects a reasonable default.
+Json_arena* json_arena_create(size_t block_size);
+
+// Releases the arena and everything allocated from it.
+void json_arena_destroy(Json_arena* a);
+
+// Invalidates everything allocated from the arena. The arena's blocks are
+// kept and reused by subsequent allocations.
+void json_arena_reset(Json_arena* a);
+
+// Returns `n` bytes of suitably aligned memory; aborts if memory runs out.
+void* json_arena_alloc(Json_arena* a, size_t n);
+
+// Copies the nul-terminated string `s` into the arena. Returns null if `s` is
+// null.
+char* json_arena_strdup(Json_arena* a, const char* s);
+
+// Returns the number of bytes handed out since the last reset.
+size_t json_arena_bytes_used(const Json_arena* a);
+
+// A point in an arena's allocations, as returned by json_arena_mark.
+typedef struct Json_arena_mark Json_arena_mark;
+struct Json_arena_mark {
+    void* block;
+    char* next;
+    size_t used;
+};
+
+// Returns the arena's current point, to which json_arena_rewind returns it.
+Json_arena_mark json_arena_mark(const Json_arena* a);
+
+// Invalidates everything allocated from the arena since `mark` was taken,
+// which must not be before the last reset. The memory is reused, as after
+// json_arena_reset.
+void json_arena_rewind(Json_arena* a, Json_arena_mark mark);
+
+#endif
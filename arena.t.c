@@ -0,0 +1,138 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "arena.h"
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void test_new_arena()
+{
+    Json_arena* a = json_arena_create(0);
+    mu_assert(json_arena_bytes_used(a) == 0);
+    json_arena_destroy(a);
+}
+
+static void test_alignment()
+{
+    Json_arena* a = json_arena_create(64);
+    int i;
+    for (i = 1; i < 100; i++) {
+        char* p = (char*) json_arena_alloc(a, i);
+        mu_assert(((size_t) p) % sizeof(double) == 0);
+        memset(p, 'x', i);
+    }
+    json_arena_destroy(a);
+}
+
+static void test_large_allocation()
+{
+    Json_arena* a = json_arena_create(16);
+    char* p = (char*) json_arena_alloc(a, 1000);
+    memset(p, 0, 1000);
+    char* q = (char*) json_arena_alloc(a, 8);
+    mu_assert(q < p || q >= p + 1000);
+    mu_assert(json_arena_bytes_used(a) == 1008);
+    json_arena_destroy(a);
+}
+
+static void test_reset_reuses_memory()
+{
+    Json_arena* a = json_arena_create(128);
+    char* first = (char*) json_arena_alloc(a, 8);
+    int i;
+    for (i = 0; i < 100; i++) {
+        json_arena_alloc(a, 40);
+    }
+    json_arena_reset(a);
+    mu_assert(json_arena_bytes_used(a) == 0);
+    mu_assert((char*) json_arena_alloc(a, 8) == first);
+    json_arena_destroy(a);
+}
+
+static void test_rewind()
+{
+    Json_arena* a = json_arena_create(128);
+    int i;
+
+    json_arena_alloc(a, 8);
+    const Json_arena_mark mark = json_arena_mark(a);
+    char* second = (char*) json_arena_alloc(a, 8);
+    for (i = 0; i < 100; i++) {
+        json_arena_alloc(a, 40);
+    }
+    json_arena_rewind(a, mark);
+    mu_assert(json_arena_bytes_used(a) == 8);
+    mu_assert((char*) json_arena_alloc(a, 8) == second);
+
+    // A mark taken before anything was allocated rewinds to the start.
+    json_arena_reset(a);
+    const Json_arena_mark start = json_arena_mark(a);
+    char* first = (char*) json_arena_alloc(a, 8);
+    json_arena_alloc(a, 1000);
+    json_arena_rewind(a, start);
+    mu_assert(json_arena_bytes_used(a) == 0);
+    mu_assert((char*) json_arena_alloc(a, 8) == first);
+    json_arena_destroy(a);
+}
+
+static void test_strdup()
+{
+    Json_arena* a = json_arena_create(0);
+    char* s = json_arena_strdup(a, "Hello, world!");
+    mu_assert(strcmp(s, "Hello, world!") == 0);
+    mu_assert(json_arena_strdup(a, NULL) == NULL);
+    json_arena_destroy(a);
+}
+
+static void test_parse_into_arena()
+{
+    Json_arena* a = json_arena_create(256);
+    int round;
+
+    for (round = 0; round < 3; round++) {
+        Json_value* v = json_parse_arena(
+            "{ \"a\": [1, 2, 3], \"b\": \"str\", c: true, \"a\": null,"
+            "  \"d\": 1, \"e\": 2, \"f\": 3, \"g\": 4, \"h\": 5, \"i\": 6 }",
+            a, NULL);
+        mu_assert(v != NULL);
+        mu_assert(json_value_count_members(v) == 9);
+        mu_assert(json_value_has_type(json_value_get_key(v, "a"),
+                                      json_type_null));
+        mu_assert(strcmp(json_value_get_cstr(json_value_get_key(v, "b")),
+                         "str") == 0);
+        mu_assert(json_value_get_double(json_value_get_key(v, "i")) == 6);
+
+        // Mutating and destroying arena values must not touch the heap.
+        json_value_set_key(v, "b", json_value_from_bool_in(a, 0));
+        json_value_destroy(v);
+
+        mu_assert(json_parse_arena("[1, 2", a, NULL) == NULL);
+        json_arena_reset(a);
+    }
+    json_arena_destroy(a);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_new_arena);
+    mu_run_test(test_alignment);
+    mu_run_test(test_large_allocation);
+    mu_run_test(test_reset_reuses_memory);
+    mu_run_test(test_rewind);
+    mu_run_test(test_strdup);
+    mu_run_test(test_parse_into_arena);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -0,0 +1,436 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "batch.h"
+#include "lexer.h"
+#include "utilities.h"
+#include <pthread.h>
+#include <string.h>
+
+// Size of input from which a chunk is made, give or take a record.
+enum { batch_chunk_bytes = 64 * 1024 };
+
+// Number of chunks in flight per worker: one being parsed and one waiting.
+enum { batch_chunks_per_worker = 2 };
+
+typedef enum Chunk_state Chunk_state;
+enum Chunk_state {
+    chunk_state_queued,     // waiting for a worker
+    chunk_state_parsing,
+    chunk_state_done,       // waiting to be passed on, in order
+};
+
+// A run of whole records, and what became of them.
+typedef struct Chunk Chunk;
+struct Chunk {
+    const char* start;
+    const char* end;
+    size_t first_index;     // index of the first record
+    Chunk_state state;
+    Json_arena* arena;      // holds the values of the records
+    Json_record* records;
+    int n_records;
+    int size;               // capacity of `records`
+};
+
+// A thread that parses chunks, or the calling thread if there are none.
+typedef struct Worker Worker;
+struct Worker {
+    Json_batch* batch;
+    int id;
+    pthread_t thread;
+};
+
+struct Json_batch {
+    Worker* workers;
+    int n_workers;
+    Worker caller;          // parses chunks when there are no workers
+
+    // The chunks form a ring, in which those numbered from `delivered` to
+    // `filled` (exclusive; the numbers only ever grow) are in flight, and
+    // `taken` is the next to be given to a worker. All of this and the
+    // fields below are guarded by `lock`.
+    Chunk* chunks;
+    int n_chunks;
+    size_t filled;
+    size_t taken;
+    size_t delivered;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;  // signalled when a chunk is queued, or on exit
+    pthread_cond_t parsed;  // signalled when a chunk has been parsed
+    int exiting;
+
+    // The batch being run.
+    int flags;
+    Json_batch_callback callback;
+    void* context;
+    int cancelled;
+};
+
+//
+// +-----------+
+// | splitting |
+// +-----------+
+//
+
+static int _is_blank(const char* p, const char* end)
+{
+    for (; p < end; p++) {
+        if (*p != ' ' && *p != '\t' && *p != '\r') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Finds the next line in [p, end) that is not blank. Sets `*start` and
+// `*stop` to its text, without the line ending, and returns where the line
+// after it begins, or null if there are no more records.
+static const char* _next_line(const char* p,
+                              const char* end,
+                              const char** start,
+                              const char** stop)
+{
+    while (p < end) {
+        const char* nl = (const char*) memchr(p, '\n', end - p);
+        const char* e = nl ? nl : end;
+        if (!_is_blank(p, e)) {
+            *start = p;
+            *stop = e > p && e[-1] == '\r' ? e - 1 : e;
+            return nl ? nl + 1 : end;
+        }
+        p = nl ? nl + 1 : end;
+    }
+    return NULL;
+}
+
+// Finds the next document in [p, end), as _next_line finds lines. Only the
+// extent of the document is found: arrays and objects are skipped by
+// matching brackets. After a lexical error, the rest of the input is taken
+// as one record, whose parse then reports the error.
+static const char* _next_document(const char* p,
+                                  const char* end,
+                                  const char** start,
+                                  const char** stop)
+{
+    Lexer lexer;
+    Json_token_type type;
+
+    lexer_init_validating(&lexer, p, end - p);
+    if (!lexer_advance(&lexer)) {
+        if (lexer_error(&lexer) == lexer_error_input_exhausted) {
+            return NULL;
+        }
+        *start = p;
+        *stop = end;
+        return end;
+    }
+
+    *start = lexer_token_start(&lexer);
+    type = lexer_token(&lexer).type;
+    if ((type == json_token_type_left_bracket
+         || type == json_token_type_left_curly)
+        && !lexer_skip_container(&lexer))
+    {
+        *stop = end;
+        return end;
+    }
+    *stop = lexer_position(&lexer);
+    return *stop;
+}
+
+// Finds the next record in [p, end), according to `flags`.
+static const char* _next_record(int flags,
+                                const char* p,
+                                const char* end,
+                                const char** start,
+                                const char** stop)
+{
+    if (flags & json_batch_concatenated) {
+        return _next_document(p, end, start, stop);
+    }
+    return _next_line(p, end, start, stop);
+}
+
+// Returns where the chunk that begins at `p` should end: after the first
+// record that ends at least batch_chunk_bytes on. Counts its records in
+// `*count`, so that they can be numbered before those of earlier chunks
+// have been found.
+static const char* _chunk_end(int flags,
+                              const char* p,
+                              const char* end,
+                              size_t* count)
+{
+    const char* q = p;
+    const char* start;
+    const char* stop;
+
+    *count = 0;
+    while (q - p < batch_chunk_bytes
+           && (q = _next_record(flags, q, end, &start, &stop)) != NULL)
+    {
+        (*count)++;
+    }
+    return q ? q : end;
+}
+
+//
+// +---------+
+// | parsing |
+// +---------+
+//
+
+// Parses the record numbered `index`, from `start` to `stop`, into `chunk`.
+static void _parse_record(Worker* worker,
+                          Chunk* chunk,
+                          size_t index,
+                          const char* start,
+                          const char* stop)
+{
+    const size_t length = stop - start;
+    Json_record* r;
+
+    if (chunk->n_records == chunk->size) {
+        chunk->size *= 2;
+        chunk->records = (Json_record*) erealloc(
+            chunk->records, chunk->size * sizeof(Json_record));
+    }
+    r = &chunk->records[chunk->n_records];
+    r->index = index;
+    r->text = start;
+    r->length = length;
+    r->arena = chunk->arena;
+    r->worker = worker->id;
+    chunk->n_records++;
+
+    r->value = json_parse_length(start, length, chunk->arena, &r->error);
+}
+
+// Records that the callback stopped the batch.
+static void _cancel(Json_batch* b)
+{
+    pthread_mutex_lock(&b->lock);
+    b->cancelled = 1;
+    pthread_mutex_unlock(&b->lock);
+}
+
+// Parses the records of `chunk`, passing each on at once in an unordered
+// batch.
+static void _parse_chunk(Worker* worker, Chunk* chunk)
+{
+    Json_batch* b = worker->batch;
+    const char* p = chunk->start;
+    size_t index = chunk->first_index;
+    const char* start;
+    const char* stop;
+
+    chunk->n_records = 0;
+    while ((p = _next_record(b->flags, p, chunk->end, &start, &stop))) {
+        _parse_record(worker, chunk, index++, start, stop);
+        if (b->flags & json_batch_unordered) {
+            if (!b->callback(b->context, &chunk->records[0])) {
+                _cancel(b);
+                return;
+            }
+            chunk->n_records = 0;
+            json_arena_reset(chunk->arena);
+        }
+    }
+}
+
+static void* _work(void* arg)
+{
+    Worker* worker = (Worker*) arg;
+    Json_batch* b = worker->batch;
+
+    pthread_mutex_lock(&b->lock);
+    for (;;) {
+        if (b->exiting) {
+            break;
+        }
+        if (b->taken == b->filled) {
+            pthread_cond_wait(&b->queued, &b->lock);
+            continue;
+        }
+        Chunk* chunk = &b->chunks[b->taken++ % b->n_chunks];
+        chunk->state = chunk_state_parsing;
+        const int skip = b->cancelled;
+        pthread_mutex_unlock(&b->lock);
+
+        if (!skip) {
+            _parse_chunk(worker, chunk);
+        }
+
+        pthread_mutex_lock(&b->lock);
+        chunk->state = chunk_state_done;
+        pthread_cond_broadcast(&b->parsed);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+static void _init_worker(Worker* worker, Json_batch* b, int id)
+{
+    worker->batch = b;
+    worker->id = id;
+}
+
+//
+// +------------+
+// | public API |
+// +------------+
+//
+
+Json_batch* json_batch_create(int n_workers)
+{
+    Json_batch* b = (Json_batch*) emalloc(sizeof(Json_batch));
+    int i;
+
+    b->n_workers = n_workers > 0 ? n_workers : 0;
+    b->n_chunks = b->n_workers > 0
+        ? batch_chunks_per_worker * b->n_workers : 1;
+    b->chunks = (Chunk*) emalloc(b->n_chunks * sizeof(Chunk));
+    for (i = 0; i < b->n_chunks; i++) {
+        b->chunks[i].arena = json_arena_create(0);
+        b->chunks[i].size = 64;
+        b->chunks[i].records =
+            (Json_record*) emalloc(b->chunks[i].size * sizeof(Json_record));
+        b->chunks[i].n_records = 0;
+    }
+    b->filled = b->taken = b->delivered = 0;
+    b->exiting = 0;
+    b->cancelled = 0;
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->queued, NULL);
+    pthread_cond_init(&b->parsed, NULL);
+
+    _init_worker(&b->caller, b, 0);
+    b->workers = (Worker*) emalloc((b->n_workers + 1) * sizeof(Worker));
+    for (i = 0; i < b->n_workers; i++) {
+        _init_worker(&b->workers[i], b, i);
+        if (pthread_create(&b->workers[i].thread, NULL, _work,
+                           &b->workers[i]) != 0)
+        {
+            JSON_PANIC(("cannot create worker thread"));
+        }
+    }
+    return b;
+}
+
+void json_batch_destroy(Json_batch* b)
+{
+    int i;
+
+    if (!b) return;
+
+    pthread_mutex_lock(&b->lock);
+    b->exiting = 1;
+    pthread_cond_broadcast(&b->queued);
+    pthread_mutex_unlock(&b->lock);
+    for (i = 0; i < b->n_workers; i++) {
+        pthread_join(b->workers[i].thread, NULL);
+    }
+    free(b->workers);
+
+    for (i = 0; i < b->n_chunks; i++) {
+        json_arena_destroy(b->chunks[i].arena);
+        free(b->chunks[i].records);
+    }
+    free(b->chunks);
+    pthread_cond_destroy(&b->parsed);
+    pthread_cond_destroy(&b->queued);
+    pthread_mutex_destroy(&b->lock);
+    free(b);
+}
+
+// Passes on the records of the oldest chunk in flight, which has been
+// parsed, in order. In ordered batches, only the calling thread sets
+// `cancelled`, so it can be read here without the lock.
+static void _deliver(Json_batch* b, Chunk* chunk)
+{
+    int i;
+
+    if (b->flags & json_batch_unordered) {
+        return;
+    }
+    for (i = 0; i < chunk->n_records && !b->cancelled; i++) {
+        if (!b->callback(b->context, &chunk->records[i])) {
+            _cancel(b);
+        }
+    }
+}
+
+int json_batch_parse(Json_batch* b,
+                     const char* input,
+                     size_t length,
+                     int flags,
+                     Json_batch_callback callback,
+                     void* context)
+{
+    const char* p = input;
+    const char* end = input + length;
+    size_t index = 0;
+    size_t count;
+
+    pthread_mutex_lock(&b->lock);
+    b->flags = flags;
+    b->callback = callback;
+    b->context = context;
+    b->cancelled = 0;
+    pthread_mutex_unlock(&b->lock);
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+
+        // Queue chunks while there is room for them.
+        while (p < end && !b->cancelled
+               && b->filled - b->delivered < (size_t) b->n_chunks)
+        {
+            Chunk* chunk = &b->chunks[b->filled % b->n_chunks];
+            pthread_mutex_unlock(&b->lock);
+
+            chunk->start = p;
+            chunk->end = p = _chunk_end(flags, p, end, &count);
+            chunk->first_index = index;
+            index += count;
+            chunk->state = chunk_state_queued;
+            json_arena_reset(chunk->arena);
+
+            pthread_mutex_lock(&b->lock);
+            b->filled++;
+            pthread_cond_signal(&b->queued);
+        }
+        if (b->delivered == b->filled) {
+            pthread_mutex_unlock(&b->lock);
+            break;
+        }
+
+        // Wait for the oldest chunk, unless it is up to this thread.
+        Chunk* oldest = &b->chunks[b->delivered % b->n_chunks];
+        if (b->n_workers == 0) {
+            b->taken++;
+            pthread_mutex_unlock(&b->lock);
+            if (!b->cancelled) {
+                _parse_chunk(&b->caller, oldest);
+            }
+        } else {
+            while (oldest->state != chunk_state_done) {
+                pthread_cond_wait(&b->parsed, &b->lock);
+            }
+            pthread_mutex_unlock(&b->lock);
+        }
+
+        _deliver(b, oldest);
+
+        pthread_mutex_lock(&b->lock);
+        b->delivered++;
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    return !b->cancelled;
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_BATCH__
+#define __INCLUDED_LIBJSON_BATCH__
+
+// Parsing of many documents in one buffer by a pool of worker threads. The
+// documents (records) are either JSON Lines (NDJSON), one per line, or
+// simply written one after another. The buffer is cut into chunks of whole
+// records, which the workers take in turn; each chunk is parsed into an
+// arena of its own (see json_parse_arena), so the workers never contend for
+// memory, and each record is parsed, and fails, independently of the rest.
+
+#include "json.h"
+#include "parser.h"
+
+typedef struct Json_batch Json_batch;
+
+// Flags for json_batch_parse.
+enum {
+    // Records are whole documents written one after another, with or
+    // without whitespace between them, rather than lines. Finding where
+    // each ends takes an extra pass over the input (matching brackets, as
+    // json_parse_lazy does) on the calling thread.
+    json_batch_concatenated = 1,
+
+    // Records are passed to the callback by the workers, as soon as each is
+    // parsed, rather than in order by the calling thread. The callback must
+    // then be safe to call from several threads at once.
+    json_batch_unordered = 2,
+};
+
+typedef struct Json_record Json_record;
+struct Json_record {
+    size_t index;           // number of the record in the input, from 0
+    const char* text;       // the record's text, within the input
+    size_t length;
+    Json_value* value;      // the result, or null if the record is invalid
+    Json_parse_error error; // why, if `value` is null (lines from 0 within
+                            // the record)
+    Json_arena* arena;      // where `value` was allocated
+    int worker;             // which worker parsed it, from 0
+};
+
+// Called with each record. The record, its value and anything allocated
+// from its arena are valid only during the call; the callback may use the
+// arena for memory of its own with the same lifetime. Returns nonzero to
+// continue or zero to stop.
+typedef int (*Json_batch_callback)(void* context, const Json_record* record);
+
+// Creates a pool of `n_workers` threads. With no workers, records are parsed
+// by the calling thread.
+Json_batch* json_batch_create(int n_workers);
+
+// Stops the workers and releases the pool.
+void json_batch_destroy(Json_batch* b);
+
+// Parses the records in the `length` bytes at `input`, according to
+// `flags`, and passes them to `callback` with `context`. Lines (or the
+// space between documents) holding only whitespace are not records; a
+// carriage return ending a line is not part of the record. Returns 1 after
+// every record has been passed on, or 0 if the callback stopped the batch;
+// in unordered batches, records already being parsed by other workers may
+// still be passed on after that. A pool runs one batch at a time.
+int json_batch_parse(Json_batch* b,
+                     const char* input,
+                     size_t length,
+                     int flags,
+                     Json_batch_callback callback,
+                     void* context);
+
+#endif
@@ -0,0 +1,264 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "batch.h"
+#include "json.h"
+#include "parser.h"
+#include "str.h"
+#include "munit.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Collects the records of a batch: their values, stringified (or "error:"
+// and the error code), one per line in order of index.
+typedef struct Results Results;
+struct Results {
+    pthread_mutex_t lock;
+    char** lines;
+    size_t n_lines;
+    size_t count;
+    size_t stop_at;     // when to stop the batch, if ever
+    int in_order;       // did the records arrive in order?
+    int bad_text;       // did a record's text differ from its value?
+};
+
+static void init_results(Results* r, size_t n_lines)
+{
+    pthread_mutex_init(&r->lock, NULL);
+    r->lines = (char**) calloc(n_lines, sizeof(char*));
+    r->n_lines = n_lines;
+    r->count = 0;
+    r->stop_at = (size_t) -1;
+    r->in_order = 1;
+    r->bad_text = 0;
+}
+
+static void free_results(Results* r)
+{
+    size_t i;
+    for (i = 0; i < r->n_lines; i++) {
+        free(r->lines[i]);
+    }
+    free(r->lines);
+    pthread_mutex_destroy(&r->lock);
+}
+
+static int collect(void* context, const Json_record* record)
+{
+    Results* r = (Results*) context;
+    char* s;
+
+    if (record->value) {
+        s = json_stringify(record->value);
+
+        // Reparsing the record's text gives the same value.
+        char* text = (char*) malloc(record->length + 1);
+        memcpy(text, record->text, record->length);
+        text[record->length] = '\0';
+        Json_value* v = json_parse(text, NULL);
+        char* t = v ? json_stringify(v) : NULL;
+        if (t == NULL || strcmp(s, t) != 0) {
+            pthread_mutex_lock(&r->lock);
+            r->bad_text = 1;
+            pthread_mutex_unlock(&r->lock);
+        }
+        free(t);
+        json_value_destroy(v);
+        free(text);
+
+        // The arena is available to the callback.
+        json_arena_alloc(record->arena, 16);
+    } else {
+        s = (char*) malloc(32);
+        sprintf(s, "error:%d@%zu", (int) record->error.code,
+                record->error.column);
+    }
+
+    pthread_mutex_lock(&r->lock);
+    if (record->index != r->count) {
+        r->in_order = 0;
+    }
+    if (record->index < r->n_lines) {
+        r->lines[record->index] = s;
+    } else {
+        free(s);
+    }
+    const int more = ++r->count != r->stop_at;
+    pthread_mutex_unlock(&r->lock);
+    return more;
+}
+
+// Returns the collected lines joined by newlines.
+static char* joined(Results* r)
+{
+    Str* s = str_create(64);
+    size_t i;
+    for (i = 0; i < r->n_lines && r->lines[i]; i++) {
+        str_append_cstr(&s, i ? "\n" : "");
+        str_append_cstr(&s, r->lines[i]);
+    }
+    return str_destroy_and_copy(s);
+}
+
+static const int worker_counts[] = { 0, 1, 3 };
+enum { n_worker_counts = sizeof(worker_counts)/sizeof(worker_counts[0]) };
+
+// Tests that a batch of the `length` bytes at `input` with `flags` gives
+// `expected`, in order, with each number of workers.
+static int gives_length(const char* input,
+                        size_t length,
+                        int flags,
+                        const char* expected)
+{
+    int ok = 1;
+    int i;
+
+    for (i = 0; i < n_worker_counts; i++) {
+        Json_batch* b = json_batch_create(worker_counts[i]);
+        Results r;
+        init_results(&r, 16);
+        ok = ok && json_batch_parse(b, input, length, flags, collect, &r);
+        char* s = joined(&r);
+        ok = ok && strcmp(s, expected) == 0 && !r.bad_text;
+        if (!(flags & json_batch_unordered)) {
+            ok = ok && r.in_order;
+        }
+        free(s);
+        free_results(&r);
+        json_batch_destroy(b);
+    }
+    return ok;
+}
+
+static int gives(const char* input, int flags, const char* expected)
+{
+    return gives_length(input, strlen(input), flags, expected);
+}
+
+static void test_lines()
+{
+    mu_assert(gives("{\"a\": 1}\n[1, 2]\r\n\n  \t\n\"x\"\n3", 0,
+                    "{\"a\":1}\n[1, 2]\n\"x\"\n3"));
+    mu_assert(gives("", 0, ""));
+    mu_assert(gives("\n\n", 0, ""));
+    mu_assert(gives("[1]\n", json_batch_unordered, "[1]"));
+
+    // Each record fails on its own, with positions within the record.
+    mu_assert(gives("[1, 2\n{\"a\": 1}\n 1 2\n[3]", 0,
+                    "error:3@5\n{\"a\":1}\nerror:8@4\n[3]"));
+
+    // A nul does not end a record.
+    mu_assert(gives_length("{\"a\": 1}\0junk\n[1]", 17, 0,
+                           "error:8@8\n[1]"));
+}
+
+static void test_concatenated()
+{
+    mu_assert(gives("{\"a\": [1, \"]\"]}[2] 3 \"x\"// end\n{}/* c */ true",
+                    json_batch_concatenated,
+                    "{\"a\":[1, \"]\"]}\n[2]\n3\n\"x\"\n{}\ntrue"));
+    mu_assert(gives("  // nothing\n", json_batch_concatenated, ""));
+
+    // After a lexical error, the rest is one record.
+    mu_assert(gives("[1] @ [2]", json_batch_concatenated, "[1]\nerror:2@1"));
+    mu_assert(gives("[1] [2", json_batch_concatenated, "[1]\nerror:3@2"));
+}
+
+// Many records, which make many chunks.
+static void test_many()
+{
+    enum { n = 20000 };
+    Str* s = str_create(n * 32);
+    char line[64];
+    size_t i, w;
+
+    for (i = 0; i < n; i++) {
+        sprintf(line, i % 100 == 7 ? "[%d,\n"
+                                   : "{\"i\": %d, \"s\": \"x\"}\n",
+                (int) i);
+        str_append_cstr(&s, line);
+    }
+    char* input = str_destroy_and_copy(s);
+
+    for (w = 0; w < n_worker_counts; w++) {
+        const int flags[] = { 0, json_batch_unordered };
+        size_t f;
+        for (f = 0; f < 2; f++) {
+            Json_batch* b = json_batch_create(worker_counts[w]);
+            Results r;
+            init_results(&r, n);
+            mu_assert(json_batch_parse(b, input, strlen(input), flags[f],
+                                       collect, &r));
+            mu_assert(r.count == n);
+            mu_assert(!r.bad_text);
+            for (i = 0; i < n; i++) {
+                if (i % 100 == 7) {
+                    const int column = sprintf(line, "[%d,", (int) i);
+                    sprintf(line, "error:3@%d", column);
+                } else {
+                    sprintf(line, "{\"i\":%d, \"s\":\"x\"}", (int) i);
+                }
+                if (strcmp(r.lines[i], line) != 0)
+                    break;
+            }
+            mu_assert(i == n);
+            if (flags[f] == 0) {
+                mu_assert(r.in_order);
+            }
+            free_results(&r);
+            json_batch_destroy(b);
+        }
+    }
+    free(input);
+}
+
+static void test_cancel()
+{
+    enum { n = 5000 };
+    Str* s = str_create(n * 8);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        str_append_cstr(&s, "[1, 2]\n");
+    }
+    char* input = str_destroy_and_copy(s);
+
+    for (i = 0; i < n_worker_counts; i++) {
+        Json_batch* b = json_batch_create(worker_counts[i]);
+        Results r;
+        init_results(&r, n);
+        r.stop_at = 10;
+        mu_assert(!json_batch_parse(b, input, strlen(input), 0, collect, &r));
+        mu_assert(r.count == 10);
+        free_results(&r);
+
+        // The pool can be used again.
+        init_results(&r, n);
+        mu_assert(json_batch_parse(b, input, strlen(input), 0, collect, &r));
+        mu_assert(r.count == n);
+        free_results(&r);
+        json_batch_destroy(b);
+    }
+    free(input);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_lines);
+    mu_run_test(test_concatenated);
+    mu_run_test(test_many);
+    mu_run_test(test_cancel);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
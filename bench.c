@@ -0,0 +1,977 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+// Throughput benchmarks on synthetic documents.
+//
+//     usage: bench [benchmark ...]
+//
+// With no arguments, every benchmark is run.
+
+#include "batch.h"
+#include "cbor.h"
+#include "intern.h"
+#include "json.h"
+#include "parser.h"
+#include "query.h"
+#include "scan.h"
+#include "str.h"
+#include "tape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Each measurement repeats its work until at least this much time has passed.
+static const double min_seconds = 0.5;
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Prints the throughput of processing `bytes` bytes `reps` times.
+static void _report(const char* label, size_t bytes, int reps, double seconds)
+{
+    printf("  %-24s %9.1f MB/s\n", label, bytes * reps / seconds / 1e6);
+}
+
+// Parses `input` repeatedly with `parse` and reports the throughput.
+static void _time_parse_with(const char* label,
+                             const char* input,
+                             Json_value* (*parse)(const char*,
+                                                  Json_parse_error*))
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_value* v = parse(input, NULL);
+        if (v == NULL) {
+            fprintf(stderr, "bench: parse failed\n");
+            exit(2);
+        }
+        json_value_destroy(v);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _time_parse(const char* label, const char* input)
+{
+    _time_parse_with(label, input, json_parse);
+}
+
+static Json_value* _parse_two_stage(const char* input,
+                                    Json_parse_error* errorp)
+{
+    return json_parse_two_stage(input, strlen(input), NULL, errorp);
+}
+
+// Validates `input` repeatedly and reports the throughput.
+static void _time_validate(const char* label, const char* input)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        if (!json_validate(input, n, NULL)) {
+            fprintf(stderr, "bench: validation failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static int _count_event(void* context)
+{
+    ++*(long*) context;
+    return 1;
+}
+
+static int _count_string(void* context, const char* s, size_t length)
+{
+    return _count_event(context);
+}
+
+static int _count_number(void* context, double n)
+{
+    return _count_event(context);
+}
+
+static int _count_boolean(void* context, int b)
+{
+    return _count_event(context);
+}
+
+// Counts every part of a document.
+static const Json_handler counter = {
+    _count_event, _count_event, _count_event, _count_event,
+    _count_string, _count_string, _count_number, _count_boolean,
+    _count_event,
+};
+
+// Parses `input` into events repeatedly and reports the throughput.
+static void _time_events(const char* label, const char* input)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        long count = 0;
+        if (!json_parse_events(input, &counter, &count, NULL)) {
+            fprintf(stderr, "bench: parse failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+// Stringifies `v` repeatedly and reports the throughput in output bytes.
+static void _time_stringify(const char* label, const Json_value* v)
+{
+    size_t n = 0;
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        char* s = json_stringify(v);
+        n = strlen(s);
+        free(s);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+//
+// +------------+
+// | benchmarks |
+// +------------+
+//
+
+// An array of strings of assorted lengths, a few with escape sequences.
+static char* _make_string_document(int count)
+{
+    Str* s = str_create(count * 140);
+    int i, j;
+
+    srand(1);
+    str_append_char(&s, '[');
+    for (i = 0; i < count; i++) {
+        const int length = 8 + rand() % 250;
+        str_append_cstr(&s, i ? ", \"" : "\"");
+        for (j = 0; j < length; j++) {
+            if (rand() % 500 == 0) {
+                str_append_cstr(&s, "\\n");
+            } else {
+                str_append_char(&s, 'a' + rand() % 26);
+            }
+        }
+        str_append_char(&s, '"');
+    }
+    str_append_char(&s, ']');
+    return str_destroy_and_copy(s);
+}
+
+static void _bench_strings()
+{
+    static const char* implementations[] = { "scalar", "sse2", "avx2" };
+    char* input = _make_string_document(50000);
+    int i;
+
+    for (i = 0; i < sizeof(implementations)/sizeof(implementations[0]); i++) {
+        if (scan_use_implementation(implementations[i])) {
+            _time_parse(implementations[i], input);
+        }
+    }
+    scan_use_implementation(NULL);
+    free(input);
+}
+
+// A pretty-printed document of nested records, indented with spaces, with
+// CRLF line endings and a few comments.
+static char* _make_indented_document(int count)
+{
+    Str* s = str_create(count * 200);
+    int i;
+
+    str_append_cstr(&s, "[\r\n");
+    for (i = 0; i < count; i++) {
+        str_append_cstr(&s, i ? ",\r\n" : "");
+        str_append_cstr(&s,
+            "        {\r\n"
+            "            /* record */\r\n"
+            "            \"id\": 12,\r\n"
+            "            \"tags\": [\r\n"
+            "                \"x\",\r\n"
+            "                \"y\"\r\n"
+            "            ],\r\n"
+            "            \"ok\": true // checked\r\n"
+            "        }");
+    }
+    str_append_cstr(&s, "\r\n]\r\n");
+    return str_destroy_and_copy(s);
+}
+
+static void _bench_whitespace()
+{
+    static const char* implementations[] = { "scalar", "sse2", "avx2" };
+    char* input = _make_indented_document(50000);
+    char label[64];
+    int i;
+
+    for (i = 0; i < sizeof(implementations)/sizeof(implementations[0]); i++) {
+        if (scan_use_implementation(implementations[i])) {
+            _time_parse(implementations[i], input);
+            sprintf(label, "%s, validate", implementations[i]);
+            _time_validate(label, input);
+        }
+    }
+    scan_use_implementation(NULL);
+    free(input);
+}
+
+// Arrays of coordinate pairs and sensor readings, as in geographic and
+// telemetry dumps.
+static char* _make_number_document(int count)
+{
+    Str* s = str_create(count * 40);
+    char buf[64];
+    int i;
+
+    srand(1);
+    str_append_char(&s, '[');
+    for (i = 0; i < count; i++) {
+        sprintf(buf, "%s[%.6f, %.6f, %d, %.3e]", i ? ", " : "",
+                (rand() % 360000000) / 1e6 - 180.0,
+                (rand() % 180000000) / 1e6 - 90.0,
+                rand() % 100000,
+                rand() / 7.0);
+        str_append_cstr(&s, buf);
+    }
+    str_append_char(&s, ']');
+    return str_destroy_and_copy(s);
+}
+
+static void _bench_numbers()
+{
+    char* input = _make_number_document(200000);
+    _time_parse("parse", input);
+    Json_value* v = json_parse(input, NULL);
+    _time_stringify("stringify", v);
+    json_value_destroy(v);
+    free(input);
+}
+
+static void _bench_events()
+{
+    char* input = _make_number_document(200000);
+    _time_parse("tree", input);
+    _time_events("events", input);
+    free(input);
+}
+
+// Records of the kind web APIs return, as strict JSON.
+static char* _make_record_document(int count)
+{
+    Str* s = str_create(count * 160);
+    char buf[256];
+    int i;
+
+    srand(1);
+    str_append_cstr(&s, "[\n");
+    for (i = 0; i < count; i++) {
+        sprintf(buf,
+                "%s  {\"id\": %d, \"name\": \"user %d\", \"active\": %s, "
+                "\"score\": %.4f, \"tags\": [\"a\", \"b\\tc\"], "
+                "\"address\": {\"city\": \"Springfield\", \"zip\": null}}",
+                i ? ",\n" : "", rand(), i, rand() % 2 ? "true" : "false",
+                rand() / 1e6);
+        str_append_cstr(&s, buf);
+    }
+    str_append_cstr(&s, "\n]\n");
+    return str_destroy_and_copy(s);
+}
+
+static void _bench_structural()
+{
+    char* input = _make_record_document(100000);
+    const size_t n = strlen(input);
+    char* lenient = (char*) malloc(n + 4);
+
+    _time_parse("general", input);
+    _time_parse_with("two-stage", input, _parse_two_stage);
+
+    // Lenient input is parsed twice, in part: stage two gives up at the
+    // first byte that is not strict JSON, here the first or the last.
+    sprintf(lenient, "//\n%s", input);
+    _time_parse("general, lenient start", lenient);
+    _time_parse_with("two-stage, lenient start", lenient, _parse_two_stage);
+    input[n - 3] = ',';
+    _time_parse("general, lenient end", input);
+    _time_parse_with("two-stage, lenient end", input, _parse_two_stage);
+    free(lenient);
+    free(input);
+}
+
+static void _bench_keys()
+{
+    char* input = _make_record_document(100000);
+    intern_set_enabled(0);
+    _time_parse("general, copied", input);
+    intern_set_enabled(1);
+    _time_parse("general, interned", input);
+    intern_set_enabled(0);
+    _time_parse_with("two-stage, copied", input, _parse_two_stage);
+    intern_set_enabled(1);
+    _time_parse_with("two-stage, interned", input, _parse_two_stage);
+    free(input);
+}
+
+// Looks up a few top-level fields of a large response, parsing it either
+// fully or lazily, and reports the throughput.
+static void _time_lookup(const char* label, const char* input, int lazy)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_value* v = lazy ? json_parse_lazy(input, NULL, NULL)
+                             : json_parse(input, NULL);
+        if (v == NULL || json_value_get_key(v, "status") == NULL
+            || json_value_get_key(json_value_get_key(v, "meta"),
+                                  "next") == NULL)
+        {
+            fprintf(stderr, "bench: lookup failed\n");
+            exit(2);
+        }
+        json_value_destroy(v);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_lazy()
+{
+    char* records = _make_record_document(1200);
+    Str* s = str_create(strlen(records) + 200);
+    str_append_cstr(&s, "{\"status\": \"ok\", \"meta\": {\"count\": 1200, "
+                        "\"next\": \"/page/2\"}, \"results\": ");
+    str_append_cstr(&s, records);
+    str_append_cstr(&s, "}");
+    char* input = str_destroy_and_copy(s);
+
+    _time_lookup("full", input, 0);
+    _time_lookup("lazy", input, 1);
+    free(input);
+    free(records);
+}
+
+static int _sum_score(void* context, const Json_value* v)
+{
+    *(double*) context += json_value_get_double(v);
+    return 1;
+}
+
+// Sums the scores of the records of `input` and reports the throughput,
+// either with a query or by parsing the document and walking the tree.
+static void _time_extract(const char* label, const char* input, int query)
+{
+    const size_t n = strlen(input);
+    Json_query* q = json_query_compile("$[*].score");
+    const double start = _now();
+    double elapsed;
+    double sum;
+    int reps = 0;
+
+    do {
+        sum = 0;
+        if (query) {
+            json_query_run(q, input, _sum_score, &sum, NULL);
+        } else {
+            Json_value* v = json_parse(input, NULL);
+            Json_iterator* i = json_iterator_create(v);
+            for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+                _sum_score(&sum, json_value_get_key(
+                               json_iterator_curr_value(i), "score"));
+            }
+            json_iterator_destroy(i);
+            json_value_destroy(v);
+        }
+        if (sum == 0) {
+            fprintf(stderr, "bench: extraction failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    json_query_destroy(q);
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_query()
+{
+    char* input = _make_record_document(100000);
+    _time_extract("parse and walk", input, 0);
+    _time_extract("query", input, 1);
+    free(input);
+}
+
+static void _bench_validate()
+{
+    char* input = _make_record_document(100000);
+    _time_parse("parse", input);
+    _time_validate("validate", input);
+    free(input);
+}
+
+static int _discard(void* context, const char* data, size_t length)
+{
+    return 0;
+}
+
+// Compacts `input` repeatedly, either by minifying it or by parsing and
+// writing it, and reports the throughput.
+static void _time_compact(const char* label, const char* input, int minify)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_sink* sink = json_sink_create(_discard, NULL, 0);
+        int ok;
+        if (minify) {
+            ok = json_minify(input, sink, json_minify_strict, NULL);
+        } else {
+            Json_value* v = json_parse(input, NULL);
+            ok = v && json_write(v, sink) == 0;
+            json_value_destroy(v);
+        }
+        json_sink_destroy(sink);
+        if (!ok) {
+            fprintf(stderr, "bench: compaction failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_minify()
+{
+    char* input = _make_indented_document(50000);
+    _time_compact("parse and write", input, 0);
+    _time_compact("minify", input, 1);
+    free(input);
+}
+
+static int _count_record(void* context, const Json_record* record)
+{
+    return record->value != NULL;
+}
+
+// Parses the lines of `input` repeatedly with `n_workers` workers and
+// reports the throughput.
+static void _time_batch(const char* label, const char* input, int n_workers)
+{
+    const size_t n = strlen(input);
+    Json_batch* b = json_batch_create(n_workers);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        if (!json_batch_parse(b, input, n, 0, _count_record, NULL)) {
+            fprintf(stderr, "bench: batch failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    json_batch_destroy(b);
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_ndjson()
+{
+    char* records = _make_record_document(100000);
+    char* p;
+
+    // One record per line, without the enclosing array.
+    for (p = records; (p = strstr(p, ",\n")) != NULL; p++) {
+        *p = ' ';
+    }
+    records[0] = ' ';
+    strrchr(records, ']')[0] = ' ';
+
+    _time_batch("calling thread", records, 0);
+    _time_batch("1 worker", records, 1);
+    _time_batch("4 workers", records, 4);
+    free(records);
+}
+
+// Parses `input` on `n_threads` threads repeatedly and reports the
+// throughput.
+static void _time_parallel(const char* label,
+                           const char* input,
+                           int n_threads)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_value* v = json_parse_parallel(input, n_threads, NULL);
+        if (v == NULL) {
+            fprintf(stderr, "bench: parallel parse failed\n");
+            exit(2);
+        }
+        json_value_destroy(v);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_parallel()
+{
+    char* input = _make_record_document(100000);
+    _time_parse("json_parse", input);
+    _time_parallel("2 threads", input, 2);
+    _time_parallel("4 threads", input, 4);
+    free(input);
+}
+
+// Parses the file at `path`, of `n` bytes, repeatedly, either reading it into
+// the heap first or mapping it, and reports the throughput.
+static void _time_file(const char* label, const char* path, size_t n, int map)
+{
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_value* v;
+        if (map) {
+            v = json_parse_file(path, NULL, NULL);
+        } else {
+            FILE* fp = fopen(path, "rb");
+            char* input = (char*) malloc(n + 1);
+            input[fread(input, 1, n, fp)] = '\0';
+            fclose(fp);
+            v = json_parse(input, NULL);
+            free(input);
+        }
+        if (v == NULL) {
+            fprintf(stderr, "bench: file parse failed\n");
+            exit(2);
+        }
+        json_value_destroy(v);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_file()
+{
+    char* input = _make_record_document(100000);
+    char path[] = "/tmp/bench.XXXXXX";
+    const int fd = mkstemp(path);
+    const size_t n = strlen(input);
+
+    if (fd < 0 || write(fd, input, n) != (ssize_t) n) {
+        fprintf(stderr, "bench: cannot write %s\n", path);
+        exit(2);
+    }
+    close(fd);
+    _time_file("read and parse", path, n, 0);
+    _time_file("json_parse_file", path, n, 1);
+    unlink(path);
+    free(input);
+}
+
+// Sums the numbers and string lengths in `v`, as a reader of every value
+// would.
+static double _sum_value(const Json_value* v)
+{
+    Json_iterator* i;
+    double sum = 0;
+
+    switch (json_value_get_type(v)) {
+    case json_type_number:
+        return json_value_get_double(v);
+    case json_type_string:
+        return json_value_get_cstr_length(v);
+    case json_type_array:
+    case json_type_object:
+        i = json_iterator_create(v);
+        for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+            sum += _sum_value(json_iterator_curr_value(i));
+        }
+        json_iterator_destroy(i);
+        return sum;
+    default:
+        return 0;
+    }
+}
+
+// Does for the value `v` of a tape what _sum_value does for a Json_value.
+static double _sum_tape(const Json_tape* t, size_t v)
+{
+    Json_tape_iterator i;
+    double sum = 0;
+
+    switch (json_tape_get_type(t, v)) {
+    case json_type_number:
+        return json_tape_get_double(t, v);
+    case json_type_string:
+        return json_tape_get_cstr_length(t, v);
+    case json_type_array:
+    case json_type_object:
+        json_tape_iterator_init(&i, t, v);
+        for (; json_tape_iterator_is_valid(&i);
+             json_tape_iterator_advance(&i))
+        {
+            sum += _sum_tape(t, json_tape_iterator_curr_value(&i));
+        }
+        return sum;
+    default:
+        return 0;
+    }
+}
+
+// Reads every value of `input`, parsed once as a Json_value or as a tape,
+// repeatedly, and reports the throughput.
+static void _time_traversal(const char* label, const char* input, int tape)
+{
+    const size_t n = strlen(input);
+    Json_value* v = tape ? NULL : json_parse(input, NULL);
+    Json_tape* t = tape ? json_tape_parse(input, NULL) : NULL;
+    double sum = 0, expected = 0, start, elapsed;
+    int reps = 0;
+
+    if (v == NULL && t == NULL) {
+        fprintf(stderr, "bench: parse failed\n");
+        exit(2);
+    }
+    start = _now();
+    do {
+        sum = tape ? _sum_tape(t, 0) : _sum_value(v);
+        if (reps > 0 && sum != expected) {
+            fprintf(stderr, "bench: traversal is inconsistent\n");
+            exit(2);
+        }
+        expected = sum;
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    if (t)
+        json_tape_destroy(t);
+    json_value_destroy(v);
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_tape()
+{
+    char* input = _make_record_document(100000);
+    _time_parse("parse to Json_value", input);
+    _time_traversal("read Json_value", input, 0);
+    _time_traversal("read tape", input, 1);
+    free(input);
+}
+
+static int _append_str(void* context, const char* data, size_t length)
+{
+    str_append_chars((Str**) context, data, length);
+    return 0;
+}
+
+// Decodes the CBOR encoding of `input` repeatedly, either to a Json_value or
+// to text, and reports the throughput in bytes of `input`, so that it
+// compares directly with parsing `input`.
+static void _time_cbor(const char* label, const char* input, int to_text)
+{
+    const size_t n = strlen(input);
+    Str* cbor = str_create(n);
+    Json_sink* sink = json_sink_create(_append_str, &cbor, 0);
+    Json_value* v = json_parse(input, NULL);
+    double start, elapsed;
+    int reps = 0;
+
+    json_value_to_cbor(v, sink);
+    json_sink_destroy(sink);
+    json_value_destroy(v);
+    sink = json_sink_create(_discard, NULL, 0);
+
+    start = _now();
+    do {
+        int ok;
+        if (to_text) {
+            ok = json_cbor_to_text(str_cstr(cbor), str_length(cbor), sink,
+                                   NULL);
+        } else {
+            v = json_value_from_cbor(str_cstr(cbor), str_length(cbor), NULL,
+                                     NULL);
+            ok = v != NULL;
+            json_value_destroy(v);
+        }
+        if (!ok) {
+            fprintf(stderr, "bench: CBOR decoding failed\n");
+            exit(2);
+        }
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    json_sink_destroy(sink);
+    str_destroy(cbor);
+    _report(label, n, reps, elapsed);
+}
+
+// Long series of readings, which CBOR packs (see cbor.h).
+static char* _make_series_document(int count)
+{
+    Str* s = str_create(count * 400);
+    char buf[32];
+    int i, j;
+
+    srand(1);
+    str_append_char(&s, '[');
+    for (i = 0; i < count; i++) {
+        str_append_cstr(&s, i ? ", [" : "[");
+        for (j = 0; j < 32; j++) {
+            sprintf(buf, "%s%.4f", j ? ", " : "", rand() / 1e6);
+            str_append_cstr(&s, buf);
+        }
+        str_append_char(&s, ']');
+    }
+    str_append_char(&s, ']');
+    return str_destroy_and_copy(s);
+}
+
+static void _bench_cbor()
+{
+    char* input = _make_number_document(200000);
+    _time_parse("parse text", input);
+    _time_cbor("decode CBOR", input, 0);
+    _time_cbor("transcode CBOR to text", input, 1);
+    free(input);
+
+    input = _make_series_document(20000);
+    _time_parse("parse series text", input);
+    _time_cbor("decode packed CBOR", input, 0);
+    free(input);
+}
+
+// Maps the image at `path` of a document of `n` bytes repeatedly, reading
+// one field of it each time, and reports the throughput in bytes of the
+// document.
+static void _time_map(const char* label, const char* path, size_t n)
+{
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_tape* t = json_tape_map(path, NULL);
+        if (t == NULL || json_tape_get_type(t, 0) != json_type_array) {
+            fprintf(stderr, "bench: cannot map %s\n", path);
+            exit(2);
+        }
+        json_tape_destroy(t);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_image()
+{
+    char* input = _make_record_document(100000);
+    char path[] = "/tmp/bench.XXXXXX";
+    const int fd = mkstemp(path);
+    Json_tape* t = json_tape_parse(input, NULL);
+    Json_sink* sink = json_sink_create_fd(fd);
+
+    if (fd < 0 || t == NULL || json_tape_write_image(t, sink) != 0) {
+        fprintf(stderr, "bench: cannot write %s\n", path);
+        exit(2);
+    }
+    json_sink_destroy(sink);
+    json_tape_destroy(t);
+    close(fd);
+    _time_parse("parse to Json_value", input);
+    _time_map("map and check image", path, strlen(input));
+    unlink(path);
+    free(input);
+}
+
+// Copies `v`, a cached response, and changes one field of one record of the
+// copy, as a request handler might, and reports the throughput in bytes of
+// the document it came from.
+static void _time_copy(const char* label, const Json_value* v, size_t n)
+{
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+
+    do {
+        Json_value* w = json_value_copy(v);
+        Json_value* record = json_value_get_element_mutable(w, reps % 100);
+        if (record == NULL) {
+            fprintf(stderr, "bench: copy failed\n");
+            exit(2);
+        }
+        json_value_set_key(record, "active", json_value_from_bool(1));
+        json_value_destroy(w);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+static void _bench_copy()
+{
+    char* input = _make_record_document(10000);
+    Json_arena* a = json_arena_create(0);
+    Json_value* in_arena = json_parse_arena(input, a, NULL);
+    Json_value* on_heap = json_parse(input, NULL);
+
+    // Arena values cannot be shared, and are copied in full.
+    _time_copy("copy in full", in_arena, strlen(input));
+    _time_copy("copy on write", on_heap, strlen(input));
+    json_value_destroy(on_heap);
+    json_arena_destroy(a);
+    free(input);
+}
+
+// Feeds `input` to a push parser `chunk` bytes at a time, repeatedly, and
+// reports the throughput.
+static void _time_push(const char* label, const char* input, size_t chunk)
+{
+    const size_t n = strlen(input);
+    const double start = _now();
+    double elapsed;
+    int reps = 0;
+    size_t i;
+
+    do {
+        Json_parser* p = json_parser_create(NULL);
+        for (i = 0; i < n; i += chunk) {
+            json_parser_feed(p, input + i, n - i < chunk ? n - i : chunk);
+        }
+        Json_value* v = json_parser_finish(p, NULL);
+        if (v == NULL) {
+            fprintf(stderr, "bench: push parse failed\n");
+            exit(2);
+        }
+        json_value_destroy(v);
+        json_parser_destroy(p);
+        reps++;
+    } while ((elapsed = _now() - start) < min_seconds);
+
+    _report(label, n, reps, elapsed);
+}
+
+// A document that is one string of `n` bytes.
+static char* _make_long_string_document(int n)
+{
+    char* input = (char*) malloc(n + 3);
+    memset(input + 1, 'x', n);
+    input[0] = input[n + 1] = '"';
+    input[n + 2] = '\0';
+    return input;
+}
+
+static void _bench_push()
+{
+    char* input = _make_record_document(100000);
+    _time_parse("records, whole", input);
+    _time_push("records, 4 KB chunks", input, 4096);
+    free(input);
+    input = _make_long_string_document(16 << 20);
+    _time_parse("string, whole", input);
+    _time_push("string, 4 KB chunks", input, 4096);
+    free(input);
+}
+
+typedef struct Benchmark Benchmark;
+struct Benchmark {
+    const char* name;
+    const char* description;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    { "strings", "parse string-heavy document", _bench_strings },
+    { "whitespace", "parse and validate indented document",
+      _bench_whitespace },
+    { "numbers", "parse and stringify number-heavy document", _bench_numbers },
+    { "events", "parse number-heavy document without a tree", _bench_events },
+    { "structural", "parse documents in one or two stages",
+      _bench_structural },
+    { "keys", "parse records with keys copied or interned", _bench_keys },
+    { "lazy", "read a few fields of a large document", _bench_lazy },
+    { "query", "extract a field from every record", _bench_query },
+    { "validate", "check a document without parsing it", _bench_validate },
+    { "minify", "compact an indented document", _bench_minify },
+    { "ndjson", "parse JSON Lines with a pool of threads", _bench_ndjson },
+    { "parallel", "parse one large array on several threads",
+      _bench_parallel },
+    { "file", "parse a file read into memory or mapped", _bench_file },
+    { "tape", "read every value of a Json_value or a flat tape",
+      _bench_tape },
+    { "cbor", "decode numeric documents from CBOR instead of text",
+      _bench_cbor },
+    { "image", "map a saved tape instead of parsing its document",
+      _bench_image },
+    { "push", "parse input fed in chunks as it arrives", _bench_push },
+    { "copy", "copy a cached document and change one field", _bench_copy },
+};
+
+enum { n_benchmarks = sizeof(benchmarks)/sizeof(benchmarks[0]) };
+
+int main(int argc, char** argv)
+{
+    int i, j;
+
+    for (i = 0; i < n_benchmarks; i++) {
+        int selected = argc < 2;
+        for (j = 1; j < argc; j++) {
+            if (strcmp(argv[j], benchmarks[i].name) == 0)
+                selected = 1;
+        }
+        if (selected) {
+            printf("%s: %s\n", benchmarks[i].name, benchmarks[i].description);
+            benchmarks[i].run();
+        }
+    }
+    return 0;
+}
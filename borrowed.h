@@ -0,0 +1,24 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_BORROWED__
+#define __INCLUDED_LIBJSON_BORROWED__
+
+// Internal interface between the parser and Json_value for values that refer
+// to memory they do not own (see json_parse_insitu).
+
+#include "json.h"
+
+// Marks the array or object `v` as one that will hold such values, before
+// it is added to another, so that json_value_copy copies it (and whatever
+// it is added to) in full rather than sharing it. Arrays and objects are
+// otherwise marked as such values are added to them, which is too late for
+// a parser that adds them before their contents.
+void json_value_mark_borrowing(Json_value* v);
+
+#endif
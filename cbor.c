@@ -0,0 +1,847 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "cbor.h"
+#include "intern.h"
+#include "number.h"
+#include "utilities.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Major types, the top three bits of the first byte of each data item.
+enum {
+    major_unsigned = 0,
+    major_negative = 1,
+    major_bytes = 2,
+    major_text = 3,
+    major_array = 4,
+    major_map = 5,
+    major_tag = 6,
+    major_simple = 7,
+};
+
+// The low five bits of the first byte: the argument itself, if below 24, or
+// how many bytes of it follow.
+enum {
+    info_1_byte = 24,
+    info_2_bytes = 25,
+    info_4_bytes = 26,
+    info_8_bytes = 27,
+    info_indefinite = 31,
+};
+
+// Arguments of major_simple.
+enum {
+    simple_false = 20,
+    simple_true = 21,
+    simple_null = 22,
+    simple_undefined = 23,
+};
+
+enum { cbor_break = 0xff };
+
+// Typed arrays of doubles (RFC 8746).
+enum {
+    tag_float64_big_endian = 82,
+    tag_float64_little_endian = 86,
+};
+
+//
+// +----------+
+// | encoding |
+// +----------+
+//
+
+// Writes the head of a data item: its major type and argument.
+static void _put_head(Json_sink* sink, int major, uint64_t arg)
+{
+    unsigned char buf[9];
+    int n, i;
+
+    if (arg < info_1_byte) {
+        buf[0] = (major << 5) | arg;
+        n = 0;
+    } else if (arg <= 0xff) {
+        buf[0] = (major << 5) | info_1_byte;
+        n = 1;
+    } else if (arg <= 0xffff) {
+        buf[0] = (major << 5) | info_2_bytes;
+        n = 2;
+    } else if (arg <= 0xffffffff) {
+        buf[0] = (major << 5) | info_4_bytes;
+        n = 4;
+    } else {
+        buf[0] = (major << 5) | info_8_bytes;
+        n = 8;
+    }
+    for (i = n; i > 0; i--) {
+        buf[i] = (unsigned char) arg;
+        arg >>= 8;
+    }
+    json_sink_write(sink, (const char*) buf, n + 1);
+}
+
+// Writes the head of a major_simple item with the `n`-byte argument `bits`
+// (a float of that size).
+static void _put_float(Json_sink* sink, int info, uint64_t bits, int n)
+{
+    unsigned char buf[9];
+    int i;
+
+    buf[0] = (major_simple << 5) | info;
+    for (i = n; i > 0; i--) {
+        buf[i] = (unsigned char) bits;
+        bits >>= 8;
+    }
+    json_sink_write(sink, (const char*) buf, n + 1);
+}
+
+// Returns nonzero if `d` is written as a CBOR integer, namely if it is an
+// integer (other than negative zero) of magnitude below 2^64.
+static int _is_integer(double d)
+{
+    if (d >= 0 && d < 18446744073709551616.0) {
+        return (double) (uint64_t) d == d && !signbit(d);
+    }
+    if (d < 0 && d > -18446744073709551616.0) {
+        return (double) (uint64_t) -d == -d;
+    }
+    return 0;
+}
+
+static void _put_number(Json_sink* sink, double d)
+{
+    if (_is_integer(d)) {
+        if (d >= 0) {
+            _put_head(sink, major_unsigned, (uint64_t) d);
+        } else {
+            _put_head(sink, major_negative, (uint64_t) -d - 1);
+        }
+    } else if ((double) (float) d == d) {
+        const float f = (float) d;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        _put_float(sink, info_4_bytes, bits, 4);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        _put_float(sink, info_8_bytes, bits, 8);
+    }
+}
+
+static void _put_text(Json_sink* sink, const char* s, size_t length)
+{
+    _put_head(sink, major_text, length);
+    json_sink_write(sink, s, length);
+}
+
+// Returns nonzero if the array `v` is written packed.
+static int _is_packable(const Json_value* v)
+{
+    int integers = 1;
+
+    if (json_value_count_members(v) < json_cbor_packed_min_length)
+        return 0;
+
+    Json_iterator* i = json_iterator_create(v);
+    for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+        const Json_value* e = json_iterator_curr_value(i);
+        if (!json_value_has_type(e, json_type_number))
+            break;
+        integers = integers && _is_integer(json_value_get_double(e));
+    }
+    const int numbers = !json_iterator_is_valid(i);
+    json_iterator_destroy(i);
+    return numbers && !integers;
+}
+
+// Writes the array `v`, of numbers only, as a typed array of doubles.
+static void _put_packed(Json_sink* sink, const Json_value* v)
+{
+    unsigned char buf[8];
+    int j;
+
+    _put_head(sink, major_tag, tag_float64_little_endian);
+    _put_head(sink, major_bytes, 8 * json_value_count_members(v));
+
+    Json_iterator* i = json_iterator_create(v);
+    for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+        const double d = json_value_get_double(json_iterator_curr_value(i));
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        for (j = 0; j < 8; j++) {
+            buf[j] = (unsigned char) bits;
+            bits >>= 8;
+        }
+        json_sink_write(sink, (const char*) buf, 8);
+    }
+    json_iterator_destroy(i);
+}
+
+static void _put_value(Json_sink* sink, const Json_value* v)
+{
+    Json_iterator* i;
+
+    switch (json_value_get_type(v)) {
+    case json_type_null:
+        _put_head(sink, major_simple, simple_null);
+        break;
+    case json_type_string:
+        _put_text(sink, json_value_get_cstr(v),
+                  json_value_get_cstr_length(v));
+        break;
+    case json_type_number:
+        _put_number(sink, json_value_get_double(v));
+        break;
+    case json_type_bool:
+        _put_head(sink, major_simple,
+                  json_value_get_bool(v) ? simple_true : simple_false);
+        break;
+    case json_type_array:
+        if (_is_packable(v)) {
+            _put_packed(sink, v);
+            break;
+        }
+        _put_head(sink, major_array, json_value_count_members(v));
+        i = json_iterator_create(v);
+        for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+            _put_value(sink, json_iterator_curr_value(i));
+        }
+        json_iterator_destroy(i);
+        break;
+    case json_type_object:
+        _put_head(sink, major_map, json_value_count_members(v));
+        i = json_iterator_create(v);
+        for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+            const char* key = json_iterator_curr_key(i);
+            _put_text(sink, key, strlen(key));
+            _put_value(sink, json_iterator_curr_value(i));
+        }
+        json_iterator_destroy(i);
+        break;
+    }
+}
+
+int json_value_to_cbor(const Json_value* v, Json_sink* sink)
+{
+    _put_value(sink, v);
+    return json_sink_flush(sink);
+}
+
+//
+// +----------+
+// | decoding |
+// +----------+
+//
+
+typedef struct Decoder Decoder;
+struct Decoder {
+    const unsigned char* start;
+    const unsigned char* p;
+    const unsigned char* end;
+    Json_arena* arena;
+    Json_parse_error_code error;
+    size_t error_offset;
+    char* scratch;          // the current string, nul-terminated
+    size_t scratch_size;
+};
+
+static void _init_decoder(Decoder* d,
+                          const char* data,
+                          size_t length,
+                          Json_arena* arena)
+{
+    d->start = (const unsigned char*) data;
+    d->p = d->start;
+    d->end = d->start + length;
+    d->arena = arena;
+    d->error = json_parse_error_success;
+    d->error_offset = 0;
+    d->scratch = NULL;
+    d->scratch_size = 0;
+}
+
+// Records an error at `at`, unless one has been recorded already. Returns 0.
+static int _fail(Decoder* d, Json_parse_error_code code,
+                 const unsigned char* at)
+{
+    if (d->error == json_parse_error_success) {
+        d->error = code;
+        d->error_offset = at - d->start;
+    }
+    return 0;
+}
+
+// Ends decoding: checks that nothing follows the data item, if it was
+// decoded, and reports the error, if any. Returns nonzero on success.
+static int _finish_decoder(Decoder* d, int ok, Json_parse_error* errorp)
+{
+    if (ok && d->p != d->end) {
+        _fail(d, json_parse_error_extraneous_input, d->p);
+    }
+    free(d->scratch);
+    if (d->error != json_parse_error_success && errorp) {
+        errorp->code = d->error;
+        errorp->line = 0;
+        errorp->column = d->error_offset;
+        errorp->expected_token_types[0] = json_token_type_error;
+        errorp->actual_token_type = json_token_type_error;
+    }
+    return d->error == json_parse_error_success;
+}
+
+// Returns the `n` bytes at `p` as a big-endian integer.
+static uint64_t _get_big_endian(const unsigned char* p, int n)
+{
+    uint64_t x = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        x = (x << 8) | p[i];
+    }
+    return x;
+}
+
+// Reads the head of the next data item, storing its major type, the low
+// bits of its first byte and its argument (which, for floats, is their
+// bits). Returns 0 on error.
+static int _read_head(Decoder* d, int* major, int* info, uint64_t* arg)
+{
+    const unsigned char* const head = d->p;
+    int n;
+
+    if (d->p == d->end) {
+        return _fail(d, json_parse_error_unexpected_end_of_input, d->p);
+    }
+    *major = *d->p >> 5;
+    *info = *d->p & 0x1f;
+    d->p++;
+
+    if (*info < info_1_byte || *info == info_indefinite) {
+        *arg = *info;
+        if (*info == info_indefinite
+            && (*major == major_unsigned || *major == major_negative
+                || *major == major_tag))
+        {
+            return _fail(d, json_parse_error_invalid_cbor, head);
+        }
+        return 1;
+    }
+    if (*info > info_8_bytes) {
+        return _fail(d, json_parse_error_invalid_cbor, head);
+    }
+    n = 1 << (*info - info_1_byte);
+    if ((size_t) (d->end - d->p) < (size_t) n) {
+        return _fail(d, json_parse_error_unexpected_end_of_input, d->end);
+    }
+    *arg = _get_big_endian(d->p, n);
+    d->p += n;
+    return 1;
+}
+
+// Consumes the break that ends an indefinite-length item, if it is next.
+static int _at_break(Decoder* d)
+{
+    if (d->p < d->end && *d->p == cbor_break) {
+        d->p++;
+        return 1;
+    }
+    return 0;
+}
+
+// Checks that `n` more bytes of input remain.
+static int _have(Decoder* d, uint64_t n)
+{
+    if ((uint64_t) (d->end - d->p) < n) {
+        return _fail(d, json_parse_error_unexpected_end_of_input, d->end);
+    }
+    return 1;
+}
+
+// Appends the `length` bytes at `s` to the scratch string, which begins at
+// `used`.
+static void _append_scratch(Decoder* d, size_t used,
+                            const unsigned char* s, size_t length)
+{
+    if (used + length + 1 > d->scratch_size) {
+        d->scratch_size = egrow(d->scratch_size ? d->scratch_size : 64,
+                                used + length + 1);
+        d->scratch = (char*) erealloc(d->scratch, d->scratch_size);
+    }
+    memcpy(d->scratch + used, s, length);
+    d->scratch[used + length] = '\0';
+}
+
+// Reads the text string whose head has been read, into the scratch string.
+// A definite-length string is one piece; an indefinite-length one, a run of
+// definite-length text strings ended by a break. Returns 0 on error.
+static int _read_text(Decoder* d, int info, uint64_t arg, size_t* length)
+{
+    int major;
+
+    if (info != info_indefinite) {
+        if (!_have(d, arg))
+            return 0;
+        _append_scratch(d, 0, d->p, arg);
+        d->p += arg;
+        *length = arg;
+        return 1;
+    }
+
+    _append_scratch(d, 0, d->p, 0);
+    *length = 0;
+    while (!_at_break(d)) {
+        const unsigned char* const head = d->p;
+        if (!_read_head(d, &major, &info, &arg))
+            return 0;
+        if (major != major_text || info == info_indefinite)
+            return _fail(d, json_parse_error_invalid_cbor, head);
+        if (!_have(d, arg))
+            return 0;
+        _append_scratch(d, *length, d->p, arg);
+        d->p += arg;
+        *length += arg;
+    }
+    return 1;
+}
+
+// Returns the IEEE half-precision float whose bits are `h`.
+static double _half_to_double(unsigned h)
+{
+    const int exponent = (h >> 10) & 0x1f;
+    const int mantissa = h & 0x3ff;
+    double d;
+
+    // Subnormals are mantissa * 2^-24, and normal numbers
+    // (1024 + mantissa) * 2^(exponent - 25).
+    if (exponent == 0) {
+        d = mantissa / 16777216.0;
+    } else if (exponent != 31) {
+        d = (mantissa + 1024) * (double) (1 << exponent) / 33554432.0;
+    } else {
+        d = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (h & 0x8000) ? -d : d;
+}
+
+// Returns the number that is the data item with the given head, which is an
+// integer or a float. Returns 0 and sets *ok to 0 if it is neither.
+static double _number(int major, int info, uint64_t arg, int* ok)
+{
+    *ok = 1;
+    if (major == major_unsigned) {
+        return (double) arg;
+    }
+    if (major == major_negative) {
+        return arg == UINT64_MAX ? -18446744073709551616.0
+                                 : -(double) (arg + 1);
+    }
+    if (major == major_simple) {
+        if (info == info_2_bytes) {
+            return _half_to_double((unsigned) arg);
+        }
+        if (info == info_4_bytes) {
+            const uint32_t bits = (uint32_t) arg;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            return f;
+        }
+        if (info == info_8_bytes) {
+            double d;
+            memcpy(&d, &arg, sizeof(d));
+            return d;
+        }
+    }
+    *ok = 0;
+    return 0;
+}
+
+// Reads the byte string that follows the tag of a typed array of doubles,
+// storing a pointer to its first double and their number. Returns 0 on
+// error.
+static int _read_packed(Decoder* d,
+                        const unsigned char** elements,
+                        size_t* n)
+{
+    const unsigned char* const head = d->p;
+    int major, info;
+    uint64_t arg;
+
+    if (!_read_head(d, &major, &info, &arg))
+        return 0;
+    if (major != major_bytes || info == info_indefinite || arg % 8 != 0)
+        return _fail(d, json_parse_error_invalid_cbor, head);
+    if (!_have(d, arg))
+        return 0;
+    *elements = d->p;
+    *n = arg / 8;
+    d->p += arg;
+    return 1;
+}
+
+// Returns the `i`th double of a typed array.
+static double _packed_element(const unsigned char* elements,
+                              size_t i,
+                              int tag)
+{
+    const unsigned char* p = elements + 8 * i;
+    uint64_t bits;
+    double d;
+    int j;
+
+    if (tag == tag_float64_big_endian) {
+        bits = _get_big_endian(p, 8);
+    } else {
+        bits = 0;
+        for (j = 7; j >= 0; j--) {
+            bits = (bits << 8) | p[j];
+        }
+    }
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// Returns the size hint for an array or map of length `arg`, of which each
+// element takes at least `n` bytes: its length, but no more than the input
+// that remains could hold, so that a corrupt length cannot make the decoder
+// reserve memory for members that are not there.
+static size_t _size_hint(const Decoder* d, int info, uint64_t arg, int n)
+{
+    const uint64_t most = (uint64_t) (d->end - d->p) / n;
+    return info == info_indefinite ? 0 : arg < most ? arg : most;
+}
+
+static Json_value* _decode_value(Decoder* d, int depth);
+
+// Decodes the members of the map whose head has been read into `object`.
+static int _decode_members(Decoder* d, Json_value* object,
+                           int info, uint64_t arg, int depth)
+{
+    const char* interned;
+    int major, key_info;
+    uint64_t i, key_arg;
+    size_t length;
+
+    for (i = 0; info == info_indefinite ? !_at_break(d) : i < arg; i++) {
+        const unsigned char* const head = d->p;
+        if (!_read_head(d, &major, &key_info, &key_arg))
+            return 0;
+        if (major != major_text)
+            return _fail(d, json_parse_error_invalid_cbor, head);
+        if (!_read_text(d, key_info, key_arg, &length))
+            return 0;
+
+        // Keep the key before decoding the value, which reuses the scratch
+        // string.
+        char* key = NULL;
+        if ((interned = intern_key(d->scratch, length)) == NULL)
+            key = d->arena ? json_arena_strdup(d->arena, d->scratch)
+                           : estrdup(d->scratch);
+
+        Json_value* v = _decode_value(d, depth + 1);
+        if (v == NULL) {
+            if (!d->arena)
+                free(key);
+            return 0;
+        }
+        if (interned || d->arena) {
+            json_value_set_key_nocopy(object, interned ? interned : key, v);
+        } else {
+            json_value_set_key(object, key, v);
+            free(key);
+        }
+    }
+    return 1;
+}
+
+static Json_value* _decode_value(Decoder* d, int depth)
+{
+    const unsigned char* const head = d->p;
+    const unsigned char* elements;
+    Json_value* v;
+    int major, info, ok;
+    uint64_t arg, i;
+    size_t length, n;
+
+    if (depth > json_cbor_max_depth) {
+        _fail(d, json_parse_error_nesting_too_deep, head);
+        return NULL;
+    }
+    if (!_read_head(d, &major, &info, &arg))
+        return NULL;
+
+    switch (major) {
+    case major_text:
+        if (!_read_text(d, info, arg, &length))
+            return NULL;
+        return json_value_from_cstr_in(d->arena, d->scratch);
+
+    case major_array:
+        v = json_value_new_array_in(d->arena, _size_hint(d, info, arg, 1));
+        for (i = 0; info == info_indefinite ? !_at_break(d) : i < arg; i++) {
+            Json_value* e = _decode_value(d, depth + 1);
+            if (e == NULL) {
+                json_value_destroy(v);
+                return NULL;
+            }
+            json_value_append(v, e);
+        }
+        return v;
+
+    case major_map:
+        v = json_value_new_object_in(d->arena, _size_hint(d, info, arg, 2));
+        if (!_decode_members(d, v, info, arg, depth)) {
+            json_value_destroy(v);
+            return NULL;
+        }
+        return v;
+
+    case major_tag:
+        if (arg != tag_float64_big_endian && arg != tag_float64_little_endian)
+            return _decode_value(d, depth + 1);
+        if (!_read_packed(d, &elements, &n))
+            return NULL;
+        v = json_value_new_array_in(d->arena, n);
+        for (i = 0; i < n; i++) {
+            json_value_append(v, json_value_from_double_in(
+                d->arena, _packed_element(elements, i, (int) arg)));
+        }
+        return v;
+
+    case major_simple:
+        switch (info) {
+        case simple_false:
+        case simple_true:
+            return json_value_from_bool_in(d->arena, info == simple_true);
+        case simple_null:
+        case simple_undefined:
+            return json_value_new_null_in(d->arena);
+        }
+        break;
+    }
+
+    const double number = _number(major, info, arg, &ok);
+    if (ok)
+        return json_value_from_double_in(d->arena, number);
+    _fail(d, json_parse_error_invalid_cbor, head);
+    return NULL;
+}
+
+Json_value* json_value_from_cbor(const char* data,
+                                 size_t length,
+                                 Json_arena* arena,
+                                 Json_parse_error* errorp)
+{
+    Decoder d;
+
+    _init_decoder(&d, data, length, arena);
+    Json_value* v = _decode_value(&d, 0);
+    if (!_finish_decoder(&d, v != NULL, errorp)) {
+        json_value_destroy(v);
+        return NULL;
+    }
+    return v;
+}
+
+//
+// +-------------------------+
+// | transcoding to text     |
+// +-------------------------+
+//
+
+// Writes the number `d` as json_write does.
+static void _write_number(Json_sink* sink, double d)
+{
+    char buf[number_max_format_length];
+    const int n = number_format(d, buf);
+    json_sink_write(sink, buf, n);
+}
+
+// Writes the scratch string, which holds `length` bytes, as json_write
+// would write it once it became a value: up to its first nul, if any.
+static void _write_scratch(Json_sink* sink, const Decoder* d, size_t length)
+{
+    const char* nul = (const char*) memchr(d->scratch, '\0', length);
+    json_write_string(sink, d->scratch, nul ? nul - d->scratch : length);
+}
+
+static int _transcode_value(Decoder* d, Json_sink* sink, int depth)
+{
+    const unsigned char* const head = d->p;
+    const unsigned char* elements;
+    int major, info, ok;
+    uint64_t arg, i;
+    size_t length, n;
+
+    if (depth > json_cbor_max_depth)
+        return _fail(d, json_parse_error_nesting_too_deep, head);
+    if (!_read_head(d, &major, &info, &arg))
+        return 0;
+
+    switch (major) {
+    case major_text:
+        if (!_read_text(d, info, arg, &length))
+            return 0;
+        _write_scratch(sink, d, length);
+        return 1;
+
+    case major_array:
+        json_sink_put(sink, '[');
+        for (i = 0; info == info_indefinite ? !_at_break(d) : i < arg; i++) {
+            if (i > 0)
+                json_sink_write(sink, ", ", 2);
+            if (!_transcode_value(d, sink, depth + 1))
+                return 0;
+        }
+        json_sink_put(sink, ']');
+        return 1;
+
+    case major_map:
+        json_sink_put(sink, '{');
+        for (i = 0; info == info_indefinite ? !_at_break(d) : i < arg; i++) {
+            const unsigned char* const key_head = d->p;
+            int key_major, key_info;
+            uint64_t key_arg;
+
+            if (i > 0)
+                json_sink_write(sink, ", ", 2);
+            if (!_read_head(d, &key_major, &key_info, &key_arg))
+                return 0;
+            if (key_major != major_text)
+                return _fail(d, json_parse_error_invalid_cbor, key_head);
+            if (!_read_text(d, key_info, key_arg, &length))
+                return 0;
+            _write_scratch(sink, d, length);
+            json_sink_put(sink, ':');
+            if (!_transcode_value(d, sink, depth + 1))
+                return 0;
+        }
+        json_sink_put(sink, '}');
+        return 1;
+
+    case major_tag:
+        if (arg != tag_float64_big_endian && arg != tag_float64_little_endian)
+            return _transcode_value(d, sink, depth + 1);
+        if (!_read_packed(d, &elements, &n))
+            return 0;
+        json_sink_put(sink, '[');
+        for (i = 0; i < n; i++) {
+            if (i > 0)
+                json_sink_write(sink, ", ", 2);
+            _write_number(sink, _packed_element(elements, i, (int) arg));
+        }
+        json_sink_put(sink, ']');
+        return 1;
+
+    case major_simple:
+        switch (info) {
+        case simple_false:
+            json_sink_write(sink, "false", 5);
+            return 1;
+        case simple_true:
+            json_sink_write(sink, "true", 4);
+            return 1;
+        case simple_null:
+        case simple_undefined:
+            json_sink_write(sink, "null", 4);
+            return 1;
+        }
+        break;
+    }
+
+    const double number = _number(major, info, arg, &ok);
+    if (!ok)
+        return _fail(d, json_parse_error_invalid_cbor, head);
+    _write_number(sink, number);
+    return 1;
+}
+
+int json_cbor_to_text(const char* data,
+                      size_t length,
+                      Json_sink* sink,
+                      Json_parse_error* errorp)
+{
+    Decoder d;
+
+    _init_decoder(&d, data, length, NULL);
+    const int ok = _finish_decoder(&d, _transcode_value(&d, sink, 0), errorp);
+    return json_sink_flush(sink) == 0 && ok;
+}
+
+//
+// +-------------------------+
+// | transcoding from text   |
+// +-------------------------+
+//
+
+static int _start_object(void* context)
+{
+    json_sink_put((Json_sink*) context,
+                  (char) ((major_map << 5) | info_indefinite));
+    return 1;
+}
+
+static int _start_array(void* context)
+{
+    json_sink_put((Json_sink*) context,
+                  (char) ((major_array << 5) | info_indefinite));
+    return 1;
+}
+
+static int _end(void* context)
+{
+    json_sink_put((Json_sink*) context, (char) cbor_break);
+    return 1;
+}
+
+static int _text(void* context, const char* s, size_t length)
+{
+    _put_text((Json_sink*) context, s, length);
+    return 1;
+}
+
+static int _number_event(void* context, double n)
+{
+    _put_number((Json_sink*) context, n);
+    return 1;
+}
+
+static int _boolean(void* context, int b)
+{
+    _put_head((Json_sink*) context, major_simple,
+              b ? simple_true : simple_false);
+    return 1;
+}
+
+static int _null(void* context)
+{
+    _put_head((Json_sink*) context, major_simple, simple_null);
+    return 1;
+}
+
+static const Json_handler _encoder = {
+    _start_object,
+    _end,
+    _start_array,
+    _end,
+    _text,
+    _text,
+    _number_event,
+    _boolean,
+    _null,
+};
+
+int json_text_to_cbor(const char* input,
+                      Json_sink* sink,
+                      Json_parse_error* errorp)
+{
+    const int ok = json_parse_events(input, &_encoder, sink, errorp);
+    return json_sink_flush(sink) == 0 && ok;
+}
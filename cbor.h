@@ -0,0 +1,77 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_CBOR__
+#define __INCLUDED_LIBJSON_CBOR__
+
+// Conversions between JSON and CBOR (RFC 8949), a binary encoding of the
+// same data model that is smaller and much cheaper to decode: lengths are
+// given up front instead of being found by scanning, and numbers are stored
+// in binary instead of decimal.
+//
+// Numbers that are integers of magnitude below 2^64 are written as CBOR
+// integers, in as few bytes as they need; others as single-precision floats
+// if that loses nothing, and as doubles otherwise. An array of at least
+// json_cbor_packed_min_length numbers, not all of them integers, is written
+// packed: as a typed array of little-endian doubles (RFC 8746, tag 86),
+// eight bytes each, which decodes with no work per element.
+//
+// Decoding accepts any well-formed CBOR whose data has a JSON equivalent:
+// integers, floats of every precision, text strings, arrays and maps whose
+// keys are text strings, definite or indefinite in length, and false, true,
+// null and undefined (which becomes null). Typed arrays of doubles in either
+// byte order become arrays of numbers, and other tags are ignored. Byte
+// strings, other simple values and other keys are errors, reported as
+// json_parse_error_invalid_cbor (see parser.h); input that ends early, as
+// json_parse_error_unexpected_end_of_input; and anything after the first
+// data item, as json_parse_error_extraneous_input. The error's line is 0
+// and its column the offset of the offending byte. Arrays, maps and tags
+// may nest at most json_cbor_max_depth deep, beyond which the error is
+// json_parse_error_nesting_too_deep.
+
+#include "json.h"
+#include "parser.h"
+#include "sink.h"
+
+enum { json_cbor_packed_min_length = 8 };
+enum { json_cbor_max_depth = 4096 };
+
+// Writes `v` to `sink` as CBOR and flushes it. Returns zero on success and
+// nonzero if the sink failed.
+int json_value_to_cbor(const Json_value* v, Json_sink* sink);
+
+// Decodes the CBOR data item that is the `length` bytes at `data`. Values
+// are allocated from `arena`, or the heap if `arena` is null (see
+// json_parse_arena). Returns null on error.
+Json_value* json_value_from_cbor(const char* data,
+                                 size_t length,
+                                 Json_arena* arena,
+                                 Json_parse_error* errorp);
+
+// Streaming transcoders, which convert one encoding to the other as they
+// read it, without building a Json_value, so that memory use does not grow
+// with the size of the document. Both flush the sink, and return 1 on
+// success and 0 if the input is invalid, setting *errorp, or if the sink
+// fails (see json_sink_flush); what was written before an error was found
+// is left in the sink.
+//
+// json_text_to_cbor accepts what json_parse accepts, reporting the same
+// errors. As the lengths of arrays and objects are not known until they
+// end, they are written as indefinite-length arrays and maps, and numbers
+// are never packed. json_cbor_to_text writes what json_write would write of
+// json_value_from_cbor's result, except that keys are escaped as strings
+// are.
+int json_text_to_cbor(const char* input,
+                      Json_sink* sink,
+                      Json_parse_error* errorp);
+int json_cbor_to_text(const char* data,
+                      size_t length,
+                      Json_sink* sink,
+                      Json_parse_error* errorp);
+
+#endif
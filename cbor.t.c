@@ -0,0 +1,307 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "cbor.h"
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { buffer_size = 64 * 1024 };
+
+static char buffer[buffer_size];
+
+// Encodes the document `input` into `buffer`, and returns its length, or 0
+// on failure (as no encoding is empty).
+static size_t encode(const char* input)
+{
+    Json_value* v = json_parse(input, NULL);
+    Json_sink* sink = json_sink_create_buffer(buffer, buffer_size);
+    size_t length = 0;
+
+    if (v != NULL && json_value_to_cbor(v, sink) == 0)
+        length = json_sink_bytes_written(sink);
+    json_sink_destroy(sink);
+    json_value_destroy(v);
+    return length;
+}
+
+// Tests that `input` encodes as the bytes `expected`, given in hex.
+static int encodes_as(const char* input, const char* expected)
+{
+    const size_t length = encode(input);
+    char hex[2 * 128 + 1];
+    size_t i;
+
+    if (length > 128)
+        return 0;
+    for (i = 0; i < length; i++) {
+        sprintf(hex + 2 * i, "%02x", (unsigned char) buffer[i]);
+    }
+    hex[2 * length] = '\0';
+    return strcmp(hex, expected) == 0;
+}
+
+// Converts the hex string `hex` into `buffer`, returning its length.
+static size_t unhex(const char* hex)
+{
+    size_t i;
+    unsigned byte;
+
+    for (i = 0; hex[2 * i] != '\0'; i++) {
+        sscanf(hex + 2 * i, "%2x", &byte);
+        buffer[i] = (char) byte;
+    }
+    return i;
+}
+
+// Tests that the CBOR `hex` decodes, both to a value and to text, as the
+// document `expected` (stringified as json_write would).
+static int decodes_as(const char* hex, const char* expected)
+{
+    const size_t length = unhex(hex);
+    Json_value* v = json_value_from_cbor(buffer, length, NULL, NULL);
+    char* s = v ? json_stringify(v) : NULL;
+    char text[1024];
+    int ok = s != NULL && strcmp(s, expected) == 0;
+
+    Json_sink* sink = json_sink_create_buffer(text, sizeof(text));
+    ok = ok && json_cbor_to_text(buffer, length, sink, NULL)
+        && strcmp(text, expected) == 0;
+    json_sink_destroy(sink);
+    free(s);
+    json_value_destroy(v);
+    return ok;
+}
+
+// Tests that the CBOR `hex` fails to decode, both to a value and to text,
+// with the error `code` at the byte offset `column`.
+static int fails_with(const char* hex,
+                      Json_parse_error_code code,
+                      size_t column)
+{
+    const size_t length = unhex(hex);
+    Json_parse_error e, f;
+    char text[1024];
+
+    Json_sink* sink = json_sink_create_buffer(text, sizeof(text));
+    const int ok = json_value_from_cbor(buffer, length, NULL, &e) == NULL
+        && !json_cbor_to_text(buffer, length, sink, &f);
+    json_sink_destroy(sink);
+    return ok && e.code == code && e.column == column
+        && f.code == code && f.column == column;
+}
+
+// Tests that `input` survives each way of converting it to CBOR and back.
+static int round_trips(const char* input)
+{
+    Json_value* v = json_parse(input, NULL);
+    char* expected = json_stringify(v);
+    Json_arena* a = json_arena_create(0);
+    char text[buffer_size];
+    size_t length;
+    int ok;
+
+    // Through values, on the heap and in an arena.
+    length = encode(input);
+    Json_value* w = json_value_from_cbor(buffer, length, NULL, NULL);
+    char* s = w ? json_stringify(w) : NULL;
+    ok = s != NULL && strcmp(s, expected) == 0;
+    free(s);
+    json_value_destroy(w);
+    w = json_value_from_cbor(buffer, length, a, NULL);
+    s = w ? json_stringify(w) : NULL;
+    ok = ok && s != NULL && strcmp(s, expected) == 0;
+    free(s);
+
+    // Through values, then transcoding to text.
+    Json_sink* sink = json_sink_create_buffer(text, sizeof(text));
+    ok = ok && json_cbor_to_text(buffer, length, sink, NULL)
+        && strcmp(text, expected) == 0;
+    json_sink_destroy(sink);
+
+    // Transcoding both ways.
+    sink = json_sink_create_buffer(buffer, buffer_size);
+    ok = ok && json_text_to_cbor(input, sink, NULL);
+    length = json_sink_bytes_written(sink);
+    json_sink_destroy(sink);
+    sink = json_sink_create_buffer(text, sizeof(text));
+    ok = ok && json_cbor_to_text(buffer, length, sink, NULL)
+        && strcmp(text, expected) == 0;
+    json_sink_destroy(sink);
+
+    json_arena_destroy(a);
+    json_value_destroy(v);
+    free(expected);
+    return ok;
+}
+
+static void test_encoding()
+{
+    // From RFC 8949, Appendix A, where the encoding is the preferred one.
+    mu_assert(encodes_as("0", "00"));
+    mu_assert(encodes_as("23", "17"));
+    mu_assert(encodes_as("24", "1818"));
+    mu_assert(encodes_as("1000", "1903e8"));
+    mu_assert(encodes_as("1000000", "1a000f4240"));
+    mu_assert(encodes_as("1000000000000", "1b000000e8d4a51000"));
+    mu_assert(encodes_as("18446744073709549568", "1bfffffffffffff800"));
+    mu_assert(encodes_as("-1", "20"));
+    mu_assert(encodes_as("-1000", "3903e7"));
+    mu_assert(encodes_as("1.1", "fb3ff199999999999a"));
+    mu_assert(encodes_as("1e300", "fb7e37e43c8800759c"));
+    mu_assert(encodes_as("\"\"", "60"));
+    mu_assert(encodes_as("\"IETF\"", "6449455446"));
+    mu_assert(encodes_as("[]", "80"));
+    mu_assert(encodes_as("[1, [2, 3], [4, 5]]", "8301820203820405"));
+    mu_assert(encodes_as("{\"a\": 1}", "a1616101"));
+    mu_assert(encodes_as("[false, true, null]", "83f4f5f6"));
+
+    // Choices of our own.
+    mu_assert(encodes_as("1.5", "fa3fc00000"));
+    mu_assert(encodes_as("-0", "fa80000000"));
+    mu_assert(encodes_as("1e19", "1b8ac7230489e80000"));
+    mu_assert(encodes_as("1e20", "fb4415af1d78b58c40"));
+    mu_assert(encodes_as("[1, 2, 3, 4, 5, 6, 7, 8]", "88""0102030405060708"));
+    mu_assert(encodes_as("[1, 2, 3, 4, 5, 6, 7, 0.5]",
+                         "d8565840"
+                         "000000000000f03f" "0000000000000040"
+                         "0000000000000840" "0000000000001040"
+                         "0000000000001440" "0000000000001840"
+                         "0000000000001c40" "000000000000e03f"));
+    mu_assert(encodes_as("[1, 2, 3, 4, 5, 6, 0.5]",
+                         "87010203040506fa3f000000"));
+}
+
+static void test_decoding()
+{
+    // From RFC 8949, Appendix A.
+    mu_assert(decodes_as("0a", "10"));
+    mu_assert(decodes_as("1864", "100"));
+    mu_assert(decodes_as("1bffffffffffffffff", "18446744073709552000"));
+    mu_assert(decodes_as("3bffffffffffffffff", "-18446744073709552000"));
+    mu_assert(decodes_as("3863", "-100"));
+    mu_assert(decodes_as("f90000", "0"));
+    mu_assert(decodes_as("f93c00", "1"));
+    mu_assert(decodes_as("f93e00", "1.5"));
+    mu_assert(decodes_as("f97bff", "65504"));
+    mu_assert(decodes_as("f90001", "5.960464477539063e-8"));
+    mu_assert(decodes_as("f9c400", "-4"));
+    mu_assert(decodes_as("fa47c35000", "100000"));
+    mu_assert(decodes_as("f97c00", "null"));
+    mu_assert(decodes_as("fb7ff8000000000000", "null"));
+    mu_assert(decodes_as("f7", "null"));
+    mu_assert(decodes_as("c11a514b67b0", "1363896240"));
+    mu_assert(decodes_as("62220a", "\"\\\"\\n\""));
+    mu_assert(decodes_as("7f657374726561646d696e67ff", "\"streaming\""));
+    mu_assert(decodes_as("9fff", "[]"));
+    mu_assert(decodes_as("9f018202039f0405ffff", "[1, [2, 3], [4, 5]]"));
+    mu_assert(decodes_as("bf61610161629f0203ffff",
+                         "{\"a\":1, \"b\":[2, 3]}"));
+    mu_assert(decodes_as("826161bf61626163ff", "[\"a\", {\"b\":\"c\"}]"));
+
+    // Typed arrays of doubles, in both byte orders.
+    mu_assert(decodes_as("d8525810" "3ff8000000000000" "c000000000000000",
+                         "[1.5, -2]"));
+    mu_assert(decodes_as("d85640", "[]"));
+
+    // Text strings with nuls end at the first, as values do.
+    mu_assert(decodes_as("63610062", "\"a\""));
+}
+
+static void test_errors()
+{
+    const int depth = json_cbor_max_depth + 1;
+    char hex[2 * (json_cbor_max_depth + 2) + 1];
+    int i;
+
+    mu_assert(fails_with("", json_parse_error_unexpected_end_of_input, 0));
+    mu_assert(fails_with("8201", json_parse_error_unexpected_end_of_input,
+                         2));
+    mu_assert(fails_with("1a0001", json_parse_error_unexpected_end_of_input,
+                         3));
+    mu_assert(fails_with("9f01", json_parse_error_unexpected_end_of_input,
+                         2));
+    mu_assert(fails_with("0101", json_parse_error_extraneous_input, 1));
+    mu_assert(fails_with("814161", json_parse_error_invalid_cbor, 1));
+    mu_assert(fails_with("a10101", json_parse_error_invalid_cbor, 1));
+    mu_assert(fails_with("1c", json_parse_error_invalid_cbor, 0));
+    mu_assert(fails_with("ff", json_parse_error_invalid_cbor, 0));
+    mu_assert(fails_with("f820", json_parse_error_invalid_cbor, 0));
+    mu_assert(fails_with("7f01ff", json_parse_error_invalid_cbor, 1));
+    mu_assert(fails_with("d8565807" "00000000000000",
+                         json_parse_error_invalid_cbor, 2));
+
+    // Memory is not reserved for members that are not there.
+    mu_assert(fails_with("9bffffffffffffffff",
+                         json_parse_error_unexpected_end_of_input, 9));
+    mu_assert(fails_with("7bffffffffffffffff",
+                         json_parse_error_unexpected_end_of_input, 9));
+
+    for (i = 0; i < depth; i++) {
+        strcpy(hex + 2 * i, "81");
+    }
+    strcpy(hex + 2 * depth, "00");
+    mu_assert(fails_with(hex, json_parse_error_nesting_too_deep, depth));
+
+    // One level less is fine.
+    Json_value* v = json_value_from_cbor(buffer + 1, unhex(hex) - 1, NULL,
+                                         NULL);
+    mu_assert(v != NULL);
+    json_value_destroy(v);
+}
+
+static void test_round_trips()
+{
+    mu_assert(round_trips("null"));
+    mu_assert(round_trips("\"a\\tstring\""));
+    mu_assert(round_trips("[0, -0, 1.5, -2.25, 1e300, -1e-300, 4294967296, "
+                          "-4294967297, 9007199254740993, 0.1]"));
+    mu_assert(round_trips("[1, 2, 3, 4, 5, 6, 7, 8.5, 9, 10]"));
+    mu_assert(round_trips("[[0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8], "
+                          "[true, false, null, {}, [], \"\"]]"));
+    mu_assert(round_trips(
+        "{\"id\": 1, \"name\": \"user 1\", \"active\": true, "
+        "\"tags\": [\"a\", \"b\\tc\"], \"address\": {\"city\": "
+        "\"Springfield\", \"zip\": null}, \"a key that is much too long to "
+        "be interned, being longer than sixty-four bytes\": 0}"));
+}
+
+static void test_transcoding_errors()
+{
+    const char* inputs[] = { "", "[1, 2", "{\"a\" 1}", "[1] 2" };
+    int i;
+
+    for (i = 0; i < (int) (sizeof(inputs) / sizeof(inputs[0])); i++) {
+        Json_sink* sink = json_sink_create_buffer(buffer, buffer_size);
+        Json_parse_error expected, actual;
+        mu_assert(json_parse(inputs[i], &expected) == NULL);
+        mu_assert(!json_text_to_cbor(inputs[i], sink, &actual));
+        mu_assert(actual.code == expected.code);
+        mu_assert(actual.line == expected.line);
+        mu_assert(actual.column == expected.column);
+        json_sink_destroy(sink);
+    }
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_encoding);
+    mu_run_test(test_decoding);
+    mu_run_test(test_errors);
+    mu_run_test(test_round_trips);
+    mu_run_test(test_transcoding_errors);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
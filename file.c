@@ -0,0 +1,111 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "parser.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size of the pieces in which files that cannot be mapped are read.
+enum { file_read_size = 64 * 1024 };
+
+// Reports that the input could not be read. Returns null.
+static Json_value* _io_error(Json_parse_error* errorp)
+{
+    if (errorp) {
+        errorp->code = json_parse_error_io;
+        errorp->line = 0;
+        errorp->column = 0;
+        errorp->expected_token_types[0] = json_token_type_error;
+        errorp->actual_token_type = json_token_type_error;
+    }
+    return NULL;
+}
+
+// Parses what remains of `fd`, reading it a piece at a time.
+static Json_value* _parse_stream(int fd,
+                                 Json_arena* arena,
+                                 Json_parse_error* errorp)
+{
+    Json_parser* parser = json_parser_create(arena);
+    char buf[file_read_size];
+    Json_value* v;
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            const int saved = errno;
+            json_parser_destroy(parser);
+            errno = saved;
+            return _io_error(errorp);
+        }
+        if (!json_parser_feed(parser, buf, n)) {
+            break;
+        }
+    }
+    v = json_parser_finish(parser, errorp);
+    json_parser_destroy(parser);
+    return v;
+}
+
+Json_value* json_parse_fd(int fd, Json_arena* arena, Json_parse_error* errorp)
+{
+    struct stat st;
+    off_t offset;
+
+    if (fstat(fd, &st) != 0) {
+        return _io_error(errorp);
+    }
+    if (!S_ISREG(st.st_mode)
+        || (offset = lseek(fd, 0, SEEK_CUR)) < 0
+        || offset >= st.st_size)
+    {
+        return _parse_stream(fd, arena, errorp);
+    }
+
+    // The mapping must begin at the start of a page, so the whole file is
+    // mapped. Some files cannot be mapped at all (those on some file
+    // systems, for one), and are read instead.
+    const size_t size = st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return _parse_stream(fd, arena, errorp);
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    Json_value* v = json_parse_length((const char*) map + offset,
+                                      size - offset, arena, errorp);
+    munmap(map, size);
+    lseek(fd, 0, SEEK_END);
+    return v;
+}
+
+Json_value* json_parse_file(const char* path,
+                            Json_arena* arena,
+                            Json_parse_error* errorp)
+{
+    int fd;
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return _io_error(errorp);
+    }
+
+    Json_value* v = json_parse_fd(fd, arena, errorp);
+    const int saved = errno;
+    close(fd);
+    errno = saved;
+    return v;
+}
@@ -8,34 +8,75 @@
 
 #include "json.h"
 #include "parser.h"
-#include "str.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-int main()
+// Minifies the json code on stdin to stdout (see json_minify).
+static int minify()
 {
-    // Read json code from stdin into `input`.
-    Str* input = str_create(0);
-    char buf[100];
-    while (fgets(buf, sizeof(buf), stdin)) {
-        str_append_cstr(&input, buf);
+    size_t size = 4096;
+    size_t length = 0;
+    char* input = (char*) malloc(size);
+    size_t n;
+
+    while ((n = fread(input + length, 1, size - length - 1, stdin)) > 0) {
+        length += n;
+        if (size - length == 1) {
+            size *= 2;
+            input = (char*) realloc(input, size);
+        }
     }
+    input[length] = '\0';
 
-    // Parse `input` and abort if an error occurs.
     Json_parse_error error;
-    Json_value* value = json_parse(str_cstr(input), &error);
+    Json_sink* sink = json_sink_create_file(stdout);
+    const int ok = json_minify(input, sink, json_minify_strict, &error);
+    const int failed = json_sink_flush(sink);
+    json_sink_destroy(sink);
     free(input);
+    if (!ok && !failed) {
+        printf("\n");
+        json_parse_error_print(stdout, error);
+        printf("\n");
+        return 2;
+    }
+    printf("\n");
+
+    return failed || fflush(stdout) != 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 2 && strcmp(argv[1], "--minify") == 0) {
+        return minify();
+    }
+    if (argc != 1) {
+        fprintf(stderr, "usage: %s [--minify] <input >output\n", argv[0]);
+        return 2;
+    }
+
+    // Parse json code from stdin (mapped, if it is a file, or else as it is
+    // read), and abort if an error occurs.
+    Json_parse_error error;
+    Json_value* value = json_parse_fd(STDIN_FILENO, NULL, &error);
     if (value == NULL) {
+        if (error.code == json_parse_error_io) {
+            perror(argv[0]);
+            return 2;
+        }
         json_parse_error_print(stdout, error);
         fprintf(stdout, "\n");
         return 2;
     }
 
-    // Convert `value` to a string and write to stdout.
-    char* output = json_stringify(value);
+    // Write `value` to stdout.
+    Json_sink* sink = json_sink_create_file(stdout);
+    const int failed = json_write(value, sink);
+    json_sink_destroy(sink);
     json_value_destroy(value);
-    printf("%s\n", output);
-    free(output);
+    printf("\n");
 
-    return 0;
+    return failed || fflush(stdout) != 0;
 }
@@ -0,0 +1,137 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "intern.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The table is kept at most half full, so that probes stay short and always
+// reach an empty slot.
+enum { intern_slots = 2 * intern_max_keys };
+
+// An interned key, which is handed out as a pointer to its `text`.
+typedef struct Entry Entry;
+struct Entry {
+    unsigned hash;
+    unsigned length;
+    char text[intern_max_length + 1];
+};
+
+static int _enabled = 1;
+
+// The entries, handed out in order; `_n_entries` counts those claimed, some
+// of which may have lost a race to intern the same key and been abandoned.
+static Entry _entries[intern_max_keys];
+static unsigned _n_entries;
+
+// The open-addressed table of entries, by hash. A slot is only ever changed
+// from null to an entry, which is complete before it is published.
+static Entry* _slots[intern_slots];
+
+// FNV-1a hash of the `length` bytes at `key`, as table.c computes it.
+static unsigned _hash(const char* key, size_t length)
+{
+    unsigned h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Claims an entry and fills it in with `key`. Returns null if none are left.
+static Entry* _new_entry(const char* key, size_t length, unsigned hash)
+{
+    if (__atomic_load_n(&_n_entries, __ATOMIC_RELAXED) >= intern_max_keys) {
+        return NULL;
+    }
+    const unsigned i = __atomic_fetch_add(&_n_entries, 1, __ATOMIC_RELAXED);
+    if (i >= intern_max_keys) {
+        return NULL;
+    }
+
+    Entry* e = &_entries[i];
+    e->hash = hash;
+    e->length = length;
+    memcpy(e->text, key, length);
+    e->text[length] = '\0';
+    return e;
+}
+
+const char* intern_key(const char* key, size_t length)
+{
+    Entry* mine = NULL;
+    size_t i;
+
+    if (length > intern_max_length || !_enabled
+        || memchr(key, '\0', length) != NULL)
+    {
+        return NULL;
+    }
+    const unsigned hash = _hash(key, length);
+
+    for (i = hash & (intern_slots - 1);; i = (i + 1) & (intern_slots - 1)) {
+        Entry* e = __atomic_load_n(&_slots[i], __ATOMIC_ACQUIRE);
+        if (e == NULL) {
+            if (mine == NULL
+                && (mine = _new_entry(key, length, hash)) == NULL)
+            {
+                return NULL;
+            }
+            if (__atomic_compare_exchange_n(&_slots[i], &e, mine, 0,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_ACQUIRE))
+            {
+                return mine->text;
+            }
+            // Another thread filled the slot first; `e` is its entry. If it
+            // is this key, `mine` is abandoned.
+        }
+        if (e->hash == hash && e->length == length
+            && memcmp(e->text, key, length) == 0)
+        {
+            return e->text;
+        }
+    }
+}
+
+int intern_contains(const char* key)
+{
+    const uintptr_t p = (uintptr_t) key;
+
+    // A pointer into the middle of an entry's text is not an interned key.
+    return p >= (uintptr_t) _entries
+        && p < (uintptr_t) (_entries + intern_max_keys)
+        && (p - (uintptr_t) _entries) % sizeof(Entry)
+               == offsetof(Entry, text);
+}
+
+unsigned intern_hash(const char* key)
+{
+    const Entry* e = (const Entry*) (key - offsetof(Entry, text));
+    return e->hash;
+}
+
+int intern_enabled()
+{
+    return _enabled;
+}
+
+size_t json_interned_key_count()
+{
+    const unsigned n = __atomic_load_n(&_n_entries, __ATOMIC_RELAXED);
+    return n < intern_max_keys ? n : intern_max_keys;
+}
+
+void intern_set_enabled(int enabled)
+{
+    _enabled = enabled;
+}
@@ -0,0 +1,54 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_INTERN__
+#define __INCLUDED_LIBJSON_INTERN__
+
+// Process-wide interning of object keys. Documents repeat the same few keys
+// over and over (an array of a million records may have only a dozen field
+// names), so the parsers keep one copy of each key for all documents and
+// threads, which tables then compare by address rather than by content.
+//
+// Interned keys live as long as the process. To keep that from costing
+// unbounded memory, they are held in a fixed pool: keys longer than
+// intern_max_length are not interned, and once intern_max_keys keys have
+// been interned, no more are (see json_interned_key_count). Callers copy
+// such keys themselves, as before.
+//
+// Lookups and insertions are lock-free. The keys sit in an open-addressed
+// table that never grows or loses entries, so a key, once found, stays
+// valid and in its slot, and a thread that finds a key already interned
+// writes no shared memory at all.
+
+#include "json.h"
+#include <stddef.h>
+
+enum { intern_max_length = json_interned_key_max_length };
+enum { intern_max_keys = json_interned_keys_max };
+
+// Returns the interned copy of the `length` bytes at `key`, which is
+// nul-terminated, or null if the key cannot be interned: because it is too
+// long or contains a nul, because the pool is full, or because interning is
+// disabled.
+const char* intern_key(const char* key, size_t length);
+
+// Returns nonzero if `key` was returned by intern_key. Takes constant time.
+int intern_contains(const char* key);
+
+// Returns the hash of the interned `key`, which is the FNV-1a hash of its
+// bytes, as tables compute it.
+unsigned intern_hash(const char* key);
+
+// Returns nonzero if intern_key interns keys, as it does by default.
+int intern_enabled();
+
+// Makes intern_key intern keys (or not). Keys already interned stay so. This
+// exists for benchmarks and tests and is not thread-safe.
+void intern_set_enabled(int enabled);
+
+#endif
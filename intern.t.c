@@ -0,0 +1,202 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "intern.h"
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void test_intern_key()
+{
+    char buf[] = "name";
+    const char* k = intern_key("name", 4);
+
+    mu_assert(k != NULL && strcmp(k, "name") == 0);
+    mu_assert(intern_key(buf, 4) == k);
+    mu_assert(intern_key("name!", 4) == k);
+    mu_assert(intern_key("names", 5) != k);
+    mu_assert(intern_key("", 0) != NULL);
+    mu_assert(intern_contains(k));
+    mu_assert(!intern_contains(buf));
+}
+
+static void test_not_interned()
+{
+    char long_key[intern_max_length + 2];
+
+    memset(long_key, 'k', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    mu_assert(intern_key(long_key, intern_max_length + 1) == NULL);
+    mu_assert(intern_key(long_key, intern_max_length) != NULL);
+    mu_assert(intern_key("a\0b", 3) == NULL);
+
+    intern_set_enabled(0);
+    mu_assert(intern_key("disabled", 8) == NULL);
+    intern_set_enabled(1);
+}
+
+// Tests that the objects of `input`, parsed in every way that builds a
+// value, share their keys.
+static void test_parsers_share_keys()
+{
+    const char* inputs[] = {
+        "[{\"id\": 1, \"name\": \"a\"}, {\"id\": 2, \"name\": \"b\"}]",
+        "[{\"id\": 1, \"name\": \"a\"}, {\"id\": 2, name: 'b'}]",
+    };
+    const char* expected = intern_key("name", 4);
+    int n, two_stage;
+
+    for (n = 0; n < 2; n++) {
+        const char* input = inputs[n];
+        const size_t length = strlen(input);
+
+        for (two_stage = 0; two_stage < 2; two_stage++) {
+            Json_arena* a = json_arena_create(0);
+            Json_value* v = two_stage
+                ? json_parse_two_stage(input, length, NULL, NULL)
+                : json_parse(input, NULL);
+            Json_value* w = two_stage
+                ? json_parse_two_stage(input, length, a, NULL)
+                : json_parse_arena(input, a, NULL);
+            Json_iterator* i = json_iterator_create(v);
+            Json_iterator* j = json_iterator_create(w);
+
+            for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
+                Json_iterator* k = json_iterator_create(
+                    json_iterator_curr_value(i));
+                json_iterator_advance(k);
+                mu_assert(json_iterator_curr_key(k) == expected);
+                json_iterator_destroy(k);
+
+                k = json_iterator_create(json_iterator_curr_value(j));
+                json_iterator_advance(k);
+                mu_assert(json_iterator_curr_key(k) == expected);
+                json_iterator_destroy(k);
+                json_iterator_advance(j);
+            }
+            json_iterator_destroy(i);
+            json_iterator_destroy(j);
+            json_value_destroy(v);
+            json_arena_destroy(a);
+        }
+    }
+}
+
+static void test_lookup()
+{
+    Json_value* v = json_parse("{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, "
+                               "\"e\": 5, \"f\": 6, \"g\": 7, \"h\": 8, "
+                               "\"i\": 9, \"j\": 10}", NULL);
+    char key[] = "i";
+
+    // Lookups with keys that are interned and with keys that are not.
+    mu_assert(json_value_get_double(json_value_get_key(v, key)) == 9);
+    mu_assert(json_value_get_double(
+        json_value_get_key(v, intern_key(key, 1))) == 9);
+    mu_assert(json_value_get_key(v, "k") == NULL);
+    mu_assert(json_value_get_key(v, intern_key("k", 1)) == NULL);
+    json_value_destroy(v);
+
+    // A pointer into the middle of an interned key is an ordinary key.
+    const char* xbc = intern_key("xbc", 3);
+    v = json_value_new_object(0);
+    json_value_set_key(v, xbc, json_value_from_double(1));
+    json_value_set_key(v, "bc", json_value_from_double(2));
+    mu_assert(!intern_contains(xbc + 1));
+    mu_assert(json_value_get_double(json_value_get_key(v, xbc + 1)) == 2);
+    json_value_set_key(v, xbc + 1, json_value_from_double(3));
+    mu_assert(json_value_count_members(v) == 2);
+    mu_assert(json_value_get_double(json_value_get_key(v, "bc")) == 3);
+    json_value_destroy(v);
+}
+
+enum { n_threads = 8, n_keys = 2000 };
+
+// Interns the same keys as every other thread, in an order of its own, and
+// returns them, indexed by key.
+static void* intern_keys(void* arg)
+{
+    const char** keys = (const char**) calloc(n_keys, sizeof(char*));
+    const int offset = *(int*) arg;
+    char buf[32];
+    int i;
+
+    for (i = 0; i < n_keys; i++) {
+        const int n = (i * 7 + offset) % n_keys;
+        sprintf(buf, "thread key %d", n);
+        keys[n] = intern_key(buf, strlen(buf));
+    }
+    return keys;
+}
+
+static void test_threads()
+{
+    pthread_t threads[n_threads];
+    int offsets[n_threads];
+    const char** keys[n_threads];
+    int i, k;
+
+    for (i = 0; i < n_threads; i++) {
+        offsets[i] = i * 251;
+        pthread_create(&threads[i], NULL, intern_keys, &offsets[i]);
+    }
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], (void**) &keys[i]);
+    }
+    for (k = 0; k < n_keys; k++) {
+        mu_assert(keys[0][k] != NULL);
+        for (i = 1; i < n_threads; i++) {
+            mu_assert(keys[i][k] == keys[0][k]);
+        }
+    }
+    for (i = 0; i < n_threads; i++) {
+        free(keys[i]);
+    }
+}
+
+// Must run last, as it fills the pool.
+static void test_full()
+{
+    char buf[32];
+    int i;
+
+    mu_assert(json_interned_key_count() > 0);
+    mu_assert(json_interned_key_count() < json_interned_keys_max);
+    for (i = 0; i < intern_max_keys; i++) {
+        sprintf(buf, "full %d", i);
+        intern_key(buf, strlen(buf));
+    }
+    mu_assert(json_interned_key_count() == json_interned_keys_max);
+    mu_assert(intern_key("one too many", 12) == NULL);
+    mu_assert(intern_key("name", 4) != NULL);
+
+    // Keys are copied instead.
+    Json_value* v = json_parse("{\"one too many\": true}", NULL);
+    mu_assert(json_value_get_bool(json_value_get_key(v, "one too many")));
+    json_value_destroy(v);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_intern_key);
+    mu_run_test(test_not_interned);
+    mu_run_test(test_parsers_share_keys);
+    mu_run_test(test_lookup);
+    mu_run_test(test_threads);
+    mu_run_test(test_full);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
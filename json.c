@@ -7,26 +7,68 @@
 // DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
 
 #include "json.h"
-#include "str.h"
+#include "borrowed.h"
+#include "intern.h"
+#include "lazy.h"
+#include "number.h"
+#include "parallel.h"
+#include "sink.h"
 #include "table.h"
 #include "utilities.h"
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
+// Strings of up to this many bytes are kept in the value itself, in the
+// space that would otherwise hold a pointer to them and their length, which
+// saves an allocation for each of the many short strings of most documents.
+enum { json_short_string_max = 2 * sizeof(void*) - 1 };
+
+// Json_value flags
+enum {
+    json_flag_arena = 1,    // value was allocated from an arena
+    json_flag_borrowed = 2, // string belongs to someone else; never free it
+    json_flag_lazy = 4,     // array or object not parsed yet; see Json_lazy
+    json_flag_malformed = 8,    // lazy array or object that failed to parse
+    json_flag_short = 16,   // string is kept in the value; see short_chars
+    json_flag_foreign = 32, // refers to memory it does not own; see below
+    json_flag_exposed = 64, // members were handed out to be changed
+};
+
+// Heap values are copied by sharing (arrays and objects share their table)
+// and count their references; a shared table is cloned before it changes.
+// Values marked json_flag_arena or json_flag_foreign are copied in full.
+
+// Where to find the contents of an array or object that have not been parsed
+// yet (see json_parse_lazy).
+typedef struct Json_lazy Json_lazy;
+struct Json_lazy {
+    const char* text;
+    size_t length;
+    Json_arena* arena;      // where the contents go (null: the heap)
+};
+
 struct Json_value {
-    Json_type type;
+    unsigned char type;         // a Json_type, kept small to make room
+    unsigned char flags;        // bitwise-or of json_flag_* values
+    unsigned char short_length; // length of short_chars, if in use
+    unsigned refs;              // references held, if on the heap
     union {
-        char* string;       // json_type_string
+        struct {
+            char* chars;    // nul-terminated
+            size_t length;  // excluding the nul
+        } string;           // json_type_string
+        char short_chars[json_short_string_max + 1];  // the same, inline
         double number;      // json_type_number
         int bool;           // json_type_bool
         Table* table;       // json_type_object or json_type_array
+        Json_lazy* lazy;    // the same, with json_flag_lazy
     } variant;
 };
 
 struct Json_iterator {
     Json_value* value;      // value being iterated over
-    int pos;                // current position in iteration
+    size_t pos;             // current position in iteration
 };
 
 //
@@ -35,13 +77,134 @@ struct Json_iterator {
 // +--------------------+
 //
 
-static Json_value* _json_new_value(Json_type type)
+static Json_value* _json_new_value(Json_arena* arena, Json_type type)
 {
-    Json_value* v = (Json_value*) emalloc(sizeof(Json_value));
+    Json_value* v;
+    if (arena != NULL) {
+        v = (Json_value*) json_arena_alloc(arena, sizeof(Json_value));
+        v->flags = json_flag_arena;
+    } else {
+        v = (Json_value*) emalloc(sizeof(Json_value));
+        v->flags = 0;
+    }
     v->type = type;
+    v->refs = 1;
     return v;
 }
 
+// Returns nonzero if `v` may be shared rather than copied. The members of
+// an exposed array or object are checked too.
+static int _json_is_shareable(const Json_value* v)
+{
+    if (v->flags & (json_flag_arena | json_flag_foreign)) {
+        return 0;
+    }
+    if (v->flags & json_flag_exposed) {
+        const size_t n = table_get_size(v->variant.table);
+        size_t i;
+        for (i = 0; i < n; i++) {
+            const Json_value* m =
+                (const Json_value*) table_get_value_at(v->variant.table, i);
+            if (m != NULL && !_json_is_shareable(m)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Adds a reference to the heap value `v`. Returns `v`.
+static void* _json_share(const void* v)
+{
+    __atomic_add_fetch(&((Json_value*) v)->refs, 1, __ATOMIC_RELAXED);
+    return (void*) v;
+}
+
+// Returns a new array or object that shares the table of the heap array or
+// object `v`.
+static Json_value* _json_new_sharing(const Json_value* v)
+{
+    Json_value* w = _json_new_value(NULL, v->type);
+    w->flags = v->flags
+        & (json_flag_foreign | json_flag_malformed | json_flag_exposed);
+    w->variant.table = table_share(v->variant.table);
+    return w;
+}
+
+// Records that `v` is being added to the array or object `container`.
+static void _json_adopt(Json_value* container, const Json_value* v)
+{
+    if (v != NULL && !_json_is_shareable(v)) {
+        container->flags |= json_flag_foreign;
+    } else if (v != NULL) {
+        container->flags |= v->flags & json_flag_exposed;
+    }
+}
+
+// Parses the contents of the lazy array or object `v` into its table.
+static void _json_expand(Json_value* v)
+{
+    Json_lazy* lazy = v->variant.lazy;
+    Json_value* parsed =
+        lazy_parse_container(lazy->text, lazy->length, lazy->arena);
+
+    v->flags &= ~json_flag_lazy;
+    if (parsed != NULL) {
+        v->variant.table = parsed->variant.table;
+        if (lazy->arena == NULL) {
+            free(parsed);
+        }
+    } else {
+        v->flags |= json_flag_malformed;
+        v->variant.table = table_create_in(lazy->arena, 0);
+    }
+    if (lazy->arena == NULL) {
+        free(lazy);
+    }
+}
+
+// Makes sure that the contents of the array or object `v` have been parsed.
+static void _json_ensure_expanded(const Json_value* v)
+{
+    if (v->flags & json_flag_lazy) {
+        _json_expand((Json_value*) v);
+    }
+}
+
+// Makes the array or object `v` ready to be changed: expanded, and with a
+// table of its own.
+static void _json_prepare_to_change(Json_value* v)
+{
+    assert(__atomic_load_n(&v->refs, __ATOMIC_RELAXED) == 1);
+    _json_ensure_expanded(v);
+    if (table_is_shared(v->variant.table)) {
+        Table* t = table_clone(v->variant.table, _json_share);
+        table_destroy(v->variant.table, (void (*)(void*)) json_value_destroy);
+        v->variant.table = t;
+    }
+}
+
+// Returns the member `v` of `container`, which is being changed, replaced by
+// an unshared array or object if it is a shared one; sets `*replaced` if so.
+static Json_value* _json_own_member(Json_value* container,
+                                    Json_value* v,
+                                    int* replaced)
+{
+    *replaced = 0;
+    if (v == NULL
+        || !(json_value_has_type(v, json_type_array)
+             || json_value_has_type(v, json_type_object)))
+    {
+        return v;
+    }
+    container->flags |= json_flag_exposed;
+    if (__atomic_load_n(&v->refs, __ATOMIC_ACQUIRE) == 1) {
+        return v;
+    }
+    *replaced = 1;
+    return _json_new_sharing(v);
+}
+
 static Json_value* _json_copy_array(const Json_value* v)
 {
     assert(json_value_has_type(v, json_type_array));
@@ -82,9 +245,27 @@ void json_value_destroy(Json_value* v)
 {
     if (!v) return;
 
+    // Arena values are released all at once with their arena.
+    if (v->flags & json_flag_arena) return;
+
+    // The last reference can be dropped without an atomic operation, as no
+    // one else can be adding one.
+    if (__atomic_load_n(&v->refs, __ATOMIC_ACQUIRE) != 1
+        && __atomic_sub_fetch(&v->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    {
+        return;
+    }
+
+    if (v->flags & json_flag_lazy) {
+        free(v->variant.lazy);
+        free(v);
+        return;
+    }
+
     switch (json_value_get_type(v)) {
     case json_type_string:
-        free(v->variant.string);
+        if (!(v->flags & (json_flag_borrowed | json_flag_short)))
+            free(v->variant.string.chars);
         break;
     case json_type_object:
     case json_type_array:
@@ -99,6 +280,15 @@ void json_value_destroy(Json_value* v)
 
 Json_value* json_value_copy(const Json_value* v)
 {
+    if (_json_is_shareable(v)) {
+        if (json_value_has_type(v, json_type_array) ||
+            json_value_has_type(v, json_type_object))
+        {
+            return _json_new_sharing(v);
+        }
+        return (Json_value*) _json_share(v);
+    }
+
     switch (json_value_get_type(v)) {
     case json_type_null:
         return json_value_new_null();
@@ -118,60 +308,206 @@ Json_value* json_value_copy(const Json_value* v)
 
 Json_value* json_value_new_null()
 {
-    return _json_new_value(json_type_null);
+    return json_value_new_null_in(NULL);
 }
 
 Json_value* json_value_from_cstr(const char* s)
 {
-    Json_value* v = _json_new_value(json_type_string);
-    v->variant.string = estrdup(s);
-    return v;
+    return json_value_from_cstr_in(NULL, s);
 }
 
 Json_value* json_value_from_double(double n)
 {
-    Json_value* v = _json_new_value(json_type_number);
+    return json_value_from_double_in(NULL, n);
+}
+
+Json_value* json_value_from_bool(int b)
+{
+    return json_value_from_bool_in(NULL, b);
+}
+
+Json_value* json_value_new_array(size_t size_hint)
+{
+    return json_value_new_array_in(NULL, size_hint);
+}
+
+Json_value* json_value_new_object(size_t size_hint)
+{
+    return json_value_new_object_in(NULL, size_hint);
+}
+
+Json_value* json_value_new_null_in(Json_arena* a)
+{
+    return _json_new_value(a, json_type_null);
+}
+
+Json_value* json_value_from_cstr_in(Json_arena* a, const char* s)
+{
+    Json_value* v = _json_new_value(a, json_type_string);
+    const size_t length = strlen(s);
+
+    if (length <= json_short_string_max) {
+        v->flags |= json_flag_short;
+        v->short_length = length;
+        memcpy(v->variant.short_chars, s, length + 1);
+        return v;
+    }
+    v->variant.string.chars = (char*) (a ? json_arena_alloc(a, length + 1)
+                                         : emalloc(length + 1));
+    memcpy(v->variant.string.chars, s, length + 1);
+    v->variant.string.length = length;
+    return v;
+}
+
+Json_value* json_value_from_cstr_nocopy_in(Json_arena* a,
+                                           const char* s,
+                                           size_t length)
+{
+    Json_value* v = _json_new_value(a, json_type_string);
+    v->flags |= json_flag_borrowed | json_flag_foreign;
+    v->variant.string.chars = (char*) s;
+    v->variant.string.length = length;
+    return v;
+}
+
+Json_value* json_value_from_double_in(Json_arena* a, double n)
+{
+    Json_value* v = _json_new_value(a, json_type_number);
     v->variant.number = n;
     return v;
 }
 
-Json_value* json_value_from_bool(int b)
+Json_value* json_value_from_bool_in(Json_arena* a, int b)
 {
-    Json_value* v = _json_new_value(json_type_bool);
+    Json_value* v = _json_new_value(a, json_type_bool);
     v->variant.bool = b ? 1 : 0;  // coerce to [0,1]
     return v;
 }
 
-Json_value* json_value_new_array(int size_hint)
+Json_value* json_value_new_array_in(Json_arena* a, size_t size_hint)
+{
+    Json_value* v = _json_new_value(a, json_type_array);
+    v->variant.table = table_create_in(a, size_hint);
+    return v;
+}
+
+Json_value* json_value_new_object_in(Json_arena* a, size_t size_hint)
 {
-    Json_value* v = _json_new_value(json_type_array);
-    v->variant.table = table_create(size_hint);
+    Json_value* v = _json_new_value(a, json_type_object);
+    v->variant.table = table_create_in(a, size_hint);
     return v;
 }
 
-Json_value* json_value_new_object(int size_hint)
+Json_value* json_value_new_lazy_in(Json_arena* a,
+                                   Json_type type,
+                                   const char* text,
+                                   size_t length)
 {
-    Json_value* v = _json_new_value(json_type_object);
-    v->variant.table = table_create(size_hint);
+    assert(type == json_type_array || type == json_type_object);
+
+    Json_value* v = _json_new_value(a, type);
+    Json_lazy* lazy = (Json_lazy*) (a ? json_arena_alloc(a, sizeof(Json_lazy))
+                                      : emalloc(sizeof(Json_lazy)));
+    lazy->text = text;
+    lazy->length = length;
+    lazy->arena = a;
+    v->flags |= json_flag_lazy | json_flag_foreign;
+    v->variant.lazy = lazy;
     return v;
 }
 
+void json_value_mark_borrowing(Json_value* v)
+{
+    assert(json_value_has_type(v, json_type_array) ||
+           json_value_has_type(v, json_type_object));
+    v->flags |= json_flag_foreign;
+}
+
 void json_value_append(Json_value* array, Json_value* v)
 {
     assert(json_value_has_type(array, json_type_array));
+    _json_prepare_to_change(array);
+    _json_adopt(array, v);
     table_set_key(&array->variant.table, NULL, v);
 }
 
+void json_value_append_elements(Json_value* array, Json_value* from)
+{
+    assert(json_value_has_type(array, json_type_array));
+    assert(json_value_has_type(from, json_type_array));
+    assert(!(array->flags & json_flag_arena));
+    assert((from->flags & ~json_flag_foreign) == 0 && from->refs == 1);
+
+    _json_prepare_to_change(array);
+    array->flags |= from->flags;
+
+    Table_iterator* i = table_iterator_create(from->variant.table);
+    for (; table_iterator_is_valid(i); table_iterator_advance(i)) {
+        table_set_key(&array->variant.table, NULL,
+                      (void*) table_iterator_curr_value(i));
+    }
+    table_iterator_destroy(i);
+    table_destroy(from->variant.table, NULL);
+    free(from);
+}
+
 void json_value_set_key(Json_value* object, const char* k, Json_value* v)
 {
     assert(json_value_has_type(object, json_type_object));
+    _json_prepare_to_change(object);
+    _json_adopt(object, v);
     json_value_destroy(table_set_key(&object->variant.table, k, v));
 }
 
+void json_value_set_key_nocopy(Json_value* object,
+                               const char* k,
+                               Json_value* v)
+{
+    assert(json_value_has_type(object, json_type_object));
+    _json_prepare_to_change(object);
+    _json_adopt(object, v);
+    if (!intern_contains(k)) {
+        object->flags |= json_flag_foreign;
+    }
+    json_value_destroy(table_set_key_nocopy(&object->variant.table, k, v));
+}
+
+Json_value* json_value_get_key_mutable(Json_value* object, const char* k)
+{
+    int replaced;
+
+    assert(json_value_has_type(object, json_type_object));
+    _json_prepare_to_change(object);
+    Json_value* v = (Json_value*) table_get_key(object->variant.table, k);
+    Json_value* own = _json_own_member(object, v, &replaced);
+    if (replaced) {
+        json_value_destroy(table_set_key(&object->variant.table, k, own));
+    }
+    return own;
+}
+
+Json_value* json_value_get_element_mutable(Json_value* array, size_t i)
+{
+    int replaced;
+
+    assert(json_value_has_type(array, json_type_array));
+    _json_prepare_to_change(array);
+    if (i >= table_get_size(array->variant.table)) {
+        return NULL;
+    }
+    Json_value* v =
+        (Json_value*) table_get_value_at(array->variant.table, i);
+    Json_value* own = _json_own_member(array, v, &replaced);
+    if (replaced) {
+        json_value_destroy(table_set_value_at(array->variant.table, i, own));
+    }
+    return own;
+}
+
 Json_type json_value_get_type(const Json_value* v)
 {
     assert(v);
-    return v->type;
+    return (Json_type) v->type;
 }
 
 int json_value_has_type(const Json_value* v, Json_type type)
@@ -182,7 +518,19 @@ int json_value_has_type(const Json_value* v, Json_type type)
 const char* json_value_get_cstr(const Json_value* v)
 {
     assert(json_value_has_type(v, json_type_string));
-    return v->variant.string;
+    if (v->flags & json_flag_short) {
+        return v->variant.short_chars;
+    }
+    return v->variant.string.chars;
+}
+
+size_t json_value_get_cstr_length(const Json_value* v)
+{
+    assert(json_value_has_type(v, json_type_string));
+    if (v->flags & json_flag_short) {
+        return v->short_length;
+    }
+    return v->variant.string.length;
 }
 
 double json_value_get_double(const Json_value* v)
@@ -197,14 +545,32 @@ int json_value_get_bool(const Json_value* v)
     return v->variant.bool;
 }
 
-int json_value_count_members(const Json_value* v)
+const Json_value* json_value_get_key(const Json_value* object, const char* k)
+{
+    assert(json_value_has_type(object, json_type_object));
+    _json_ensure_expanded(object);
+    return (const Json_value*) table_get_key(object->variant.table, k);
+}
+
+size_t json_value_count_members(const Json_value* v)
 {
     assert(json_value_has_type(v, json_type_array) ||
            json_value_has_type(v, json_type_object));
 
+    _json_ensure_expanded(v);
     return table_get_size(v->variant.table);
 }
 
+int json_value_is_malformed(const Json_value* v)
+{
+    if (json_value_has_type(v, json_type_array) ||
+        json_value_has_type(v, json_type_object))
+    {
+        _json_ensure_expanded(v);
+    }
+    return (v->flags & json_flag_malformed) != 0;
+}
+
 //
 // +---------------+
 // | Json_iterator |
@@ -216,6 +582,7 @@ Json_iterator* json_iterator_create(const Json_value* v)
     assert(json_value_has_type(v, json_type_array) ||
            json_value_has_type(v, json_type_object));
 
+    _json_ensure_expanded(v);
     return (Json_iterator*) table_iterator_create(v->variant.table);
 }
 
@@ -253,152 +620,156 @@ const Json_value* json_iterator_curr_value(const Json_iterator* iter)
 
 // Forward declarations are needed because our stringification routines are
 // mutually recursive.
-static void _json_stringify_array (Str** dst, const Json_value* v);
-static void _json_stringify_object(Str** dst, const Json_value* v);
+static void _write_array (Json_sink* sink, const Json_value* v);
+static void _write_object(Json_sink* sink, const Json_value* v);
 
-// Escape control characters (and various other characters, such as double
-// quotes) in the given string. Returns a newly allocated string.
-static char* _escape_string(const char* s)
+// Writes the `length` bytes at `s` with control characters (and various other
+// characters, such as double quotes) escaped. Runs of ordinary characters
+// are written in one piece.
+static void _write_escaped(Json_sink* sink, const char* s, size_t length)
 {
-    Str* t = str_create(strlen(s));
+    const char* const end = s + length;
+    const char* run = s;
     const char* p;
+    char esc;
 
-#define ESC_SEQ(c) { str_append_char(&t, '\\'); str_append_char(&t, c); }
-
-    for (p = s; *p != '\0'; p++) {
+    for (p = s; p < end; p++) {
         switch (*p) {
-        case '\b':
-            ESC_SEQ('b');
-            break;
-        case '\f':
-            ESC_SEQ('f');
-            break;
-        case '\n':
-            ESC_SEQ('n');
-            break;
-        case '\r':
-            ESC_SEQ('r');
-            break;
-        case '\t':
-            ESC_SEQ('t');
-            break;
-        case '"':
-            ESC_SEQ('"');
-            break;
+        case '\b': esc = 'b'; break;
+        case '\f': esc = 'f'; break;
+        case '\n': esc = 'n'; break;
+        case '\r': esc = 'r'; break;
+        case '\t': esc = 't'; break;
+        case '"': esc = '"'; break;
         default:
-            str_append_char(&t, *p);
-            break;
+            continue;
         }
+        json_sink_write(sink, run, p - run);
+        json_sink_put(sink, '\\');
+        json_sink_put(sink, esc);
+        run = p + 1;
     }
-
-#undef ESC_SEQ
-
-    return str_destroy_and_copy(t);
+    json_sink_write(sink, run, p - run);
 }
 
-// Converts a double to text, returning a newly allocated string.
-static char* _double_to_string(double d)
+void json_write_string(Json_sink* sink, const char* s, size_t length)
 {
-    int size = 30;      // guess at maximum size
-    char* p = (char*) emalloc(size);
-
-    for (;;) {
-        int n = snprintf(p, size, "%g", d);
-
-        if (n >= 0 && n < size) {
-            break;      // success
-        }
-
-        if (n >= 0) {
-            size = n+1; // we know the exact size
-        } else {
-            size *= 2;  // obsolete snprintf, have to guess
-        }
-
-        p = (char*) erealloc(p, size);
-    }
-    return p;
+    json_sink_put(sink, '"');
+    _write_escaped(sink, s, length);
+    json_sink_put(sink, '"');
 }
 
-// Converts a json value to text, appending it to `dst`.
-static void _json_stringify(Str** dst, const Json_value* v)
+// Converts a json value to text, writing it to `sink`.
+static void _write_value(Json_sink* sink, const Json_value* v)
 {
-    char* s;
-
     switch (json_value_get_type(v)) {
     case json_type_null:
-        str_append_cstr(dst, "null");
+        json_sink_write(sink, "null", 4);
         break;
     case json_type_string:
-        str_append_char(dst, '"');
-        s = _escape_string(json_value_get_cstr(v));
-        str_append_cstr(dst, s);
-        free(s);
-        str_append_char(dst, '"');
+        json_write_string(sink, json_value_get_cstr(v),
+                          json_value_get_cstr_length(v));
         break;
     case json_type_number: {
-        char* s = _double_to_string(json_value_get_double(v));
-        str_append_cstr(dst, s);
-        free(s);
+        char buf[number_max_format_length];
+        const int n = number_format(json_value_get_double(v), buf);
+        json_sink_write(sink, buf, n);
         break;
     }
     case json_type_bool:
-        str_append_cstr(dst, json_value_get_bool(v) ? "true" : "false");
+        if (json_value_get_bool(v)) {
+            json_sink_write(sink, "true", 4);
+        } else {
+            json_sink_write(sink, "false", 5);
+        }
         break;
     case json_type_object:
-        _json_stringify_object(dst, v);
+        _write_object(sink, v);
         break;
     case json_type_array:
-        _json_stringify_array(dst, v);
+        _write_array(sink, v);
         break;
     }
 }
 
-// Converts a json array to text, appending it to `dst`.
-static void _json_stringify_array(Str** dst, const Json_value* v)
+// Converts a json array to text, writing it to `sink`.
+static void _write_array(Json_sink* sink, const Json_value* v)
 {
-    str_append_char(dst, '[');
+    json_sink_put(sink, '[');
     int first = 1;
     Json_iterator* i = json_iterator_create(v);
     for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
         if (first) {
             first = 0;
         } else {
-            str_append_cstr(dst, ", ");
+            json_sink_write(sink, ", ", 2);
         }
-        _json_stringify(dst, json_iterator_curr_value(i));
+        _write_value(sink, json_iterator_curr_value(i));
     }
     json_iterator_destroy(i);
-    str_append_char(dst, ']');
+    json_sink_put(sink, ']');
 }
 
-// Converts a json object to text, appending it to `dst`.
-static void _json_stringify_object(Str** dst, const Json_value* v)
+// Converts a json object to text, writing it to `sink`.
+static void _write_object(Json_sink* sink, const Json_value* v)
 {
-    str_append_char(dst, '{');
+    json_sink_put(sink, '{');
     Json_iterator* i = json_iterator_create(v);
     int first = 1;
     for (; json_iterator_is_valid(i); json_iterator_advance(i)) {
         if (first) {
             first = 0;
         } else {
-            str_append_cstr(dst, ", ");
+            json_sink_write(sink, ", ", 2);
         }
-        str_append_char(dst, '"');
-        str_append_cstr(dst, json_iterator_curr_key(i));
-        str_append_char(dst, '"');
-        str_append_char(dst, ':');
-        _json_stringify(dst, json_iterator_curr_value(i));
+        const char* key = json_iterator_curr_key(i);
+        json_sink_put(sink, '"');
+        json_sink_write(sink, key, strlen(key));
+        json_sink_write(sink, "\":", 2);
+        _write_value(sink, json_iterator_curr_value(i));
     }
     json_iterator_destroy(i);
-    str_append_char(dst, '}');
+    json_sink_put(sink, '}');
+}
+
+int json_write(const Json_value* v, Json_sink* sink)
+{
+    _write_value(sink, v);
+    return json_sink_flush(sink);
+}
+
+// Growable buffer behind json_stringify. Output is appended in sink-sized
+// pieces directly into the string that is returned to the caller.
+typedef struct Growable Growable;
+struct Growable {
+    char* data;
+    size_t length;
+    size_t size;
+};
+
+static int _append_growable(void* context, const char* data, size_t length)
+{
+    Growable* g = (Growable*) context;
+    if (g->length + length + 1 > g->size) {
+        g->size = egrow(g->size, g->length + length + 1);
+        g->data = (char*) erealloc(g->data, g->size);
+    }
+    memcpy(g->data + g->length, data, length);
+    g->length += length;
+    return 0;
 }
 
 char* json_stringify(const Json_value* v)
 {
-    Str* s = str_create(100);
-    _json_stringify(&s, v);
-    char* answer = estrdup(str_cstr(s));
-    str_destroy(s);
-    return answer;
+    Growable g;
+    g.size = 128;
+    g.length = 0;
+    g.data = (char*) emalloc(g.size);
+
+    Json_sink* sink = json_sink_create(_append_growable, &g, 0);
+    json_write(v, sink);
+    json_sink_destroy(sink);
+
+    g.data[g.length] = '\0';
+    return g.data;
 }
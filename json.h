@@ -9,6 +9,9 @@
 #ifndef __INCLUDED_LIBJSON_JSON__
 #define __INCLUDED_LIBJSON_JSON__
 
+#include "arena.h"
+#include "sink.h"
+
 // JSON data types
 typedef enum Json_type Json_type;
 enum Json_type {
@@ -30,16 +33,70 @@ Json_value* json_value_from_cstr(const char* s);
 Json_value* json_value_from_double(double n);
 Json_value* json_value_from_bool(int b);
 Json_value* json_value_new_null();
-Json_value* json_value_new_array(int size_hint);
-Json_value* json_value_new_object(int size_hint);
+Json_value* json_value_new_array(size_t size_hint);
+Json_value* json_value_new_object(size_t size_hint);
 void json_value_append(Json_value* array, Json_value* v);
 void json_value_set_key(Json_value* object, const char* k, Json_value* v);
+void json_value_set_key_nocopy(Json_value* object,
+                               const char* k,
+                               Json_value* v);
 Json_type json_value_get_type(const Json_value* v);
 int json_value_has_type(const Json_value* v, Json_type type);
 const char* json_value_get_cstr(const Json_value* v);
+size_t json_value_get_cstr_length(const Json_value* v);
 double json_value_get_double(const Json_value* v);
 int json_value_get_bool(const Json_value* v);
-int json_value_count_members(const Json_value* v);
+const Json_value* json_value_get_key(const Json_value* object, const char* k);
+size_t json_value_count_members(const Json_value* v);
+
+// json_value_copy shares the contents of heap values in constant time.
+// Values that refer to memory they do not own (arena, in-situ, _nocopy and
+// lazy values, and arrays and objects holding them) are copied in full.
+//
+// Values reached through another value may be shared and must not be
+// changed; get them with the _mutable accessors below instead, which return
+// null if there is no such member. A value added to an array or object
+// belongs to it, and is changed only that way.
+//
+// Values that are not being changed may be used by many threads at once,
+// except values from json_parse_lazy.
+Json_value* json_value_get_key_mutable(Json_value* object, const char* k);
+Json_value* json_value_get_element_mutable(Json_value* array, size_t i);
+
+// Returns nonzero if `v` is an array or object from json_parse_lazy (see
+// parser.h) whose text turned out to be malformed when it was parsed, which
+// leaves it empty. Parses the text first if that has not happened yet.
+int json_value_is_malformed(const Json_value* v);
+
+// Json_value construction in an arena (see arena.h). A null arena means the
+// heap, exactly as above. Arena values are released with their arena, and
+// json_value_destroy ignores them; containers in an arena should only be
+// given values from the same arena.
+Json_value* json_value_new_null_in(Json_arena* a);
+Json_value* json_value_from_cstr_in(Json_arena* a, const char* s);
+Json_value* json_value_from_double_in(Json_arena* a, double n);
+Json_value* json_value_from_bool_in(Json_arena* a, int b);
+Json_value* json_value_new_array_in(Json_arena* a, size_t size_hint);
+Json_value* json_value_new_object_in(Json_arena* a, size_t size_hint);
+
+// Zero-copy strings. The value refers to the nul-terminated string `s`, of
+// `length` bytes, which must outlive it (and keys set with
+// json_value_set_key_nocopy must outlive the object).
+Json_value* json_value_from_cstr_nocopy_in(Json_arena* a,
+                                           const char* s,
+                                           size_t length);
+
+// Object keys of up to json_interned_key_max_length bytes, from the parsers
+// and from json_value_set_key, are interned: one copy of each is kept for
+// the whole process and every thread, and is never freed. The pool holds
+// json_interned_keys_max keys, first come, first served; once it is full,
+// new keys are copied into each object that uses them, as if not interned,
+// which costs memory and time but is otherwise the same. A process that
+// sees many distinct keys (say, IDs used as keys) may fill the pool early.
+// Returns the number of places in the pool used up so far.
+enum { json_interned_key_max_length = 64 };
+enum { json_interned_keys_max = 1 << 15 };
+size_t json_interned_key_count();
 
 // Json_iterator
 Json_iterator* json_iterator_create(const Json_value* v);
@@ -52,4 +109,13 @@ const Json_value* json_iterator_curr_value(const Json_iterator* iter);
 // stringification
 char* json_stringify(const Json_value* v);
 
+// Writes `v` as text to `sink` (see sink.h) and flushes it. Returns zero on
+// success and nonzero if the sink failed.
+int json_write(const Json_value* v, Json_sink* sink);
+
+// Writes the `length` bytes at `s` to `sink` as a quoted string, escaped as
+// json_write escapes strings, for writers that produce text a piece at a
+// time. Does not flush the sink.
+void json_write_string(Json_sink* sink, const char* s, size_t length);
+
 #endif
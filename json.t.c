@@ -0,0 +1,270 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "arena.h"
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tests that `v` is the string `s`, and destroys it.
+static int is_string(Json_value* v, const char* s)
+{
+    const int ok = json_value_has_type(v, json_type_string)
+        && strcmp(json_value_get_cstr(v), s) == 0
+        && json_value_get_cstr_length(v) == strlen(s);
+    json_value_destroy(v);
+    return ok;
+}
+
+static void test_strings()
+{
+    Json_arena* a = json_arena_create(0);
+    char s[64];
+    int n;
+
+    // Around the longest string that fits in a value.
+    for (n = 0; n < (int) sizeof(s) - 1; n++) {
+        memset(s, 'a' + n % 26, n);
+        s[n] = '\0';
+        mu_assert(is_string(json_value_from_cstr(s), s));
+        mu_assert(is_string(json_value_from_cstr_in(a, s), s));
+
+        Json_value* v = json_value_from_cstr(s);
+        mu_assert(is_string(json_value_copy(v), s));
+        json_value_destroy(v);
+    }
+    json_arena_destroy(a);
+}
+
+static void test_short_strings_take_no_memory()
+{
+    Json_arena* a = json_arena_create(0);
+    size_t number, string;
+
+    json_value_from_double_in(a, 1);
+    number = json_arena_bytes_used(a);
+    json_arena_reset(a);
+    json_value_from_cstr_in(a, "US");
+    string = json_arena_bytes_used(a);
+    mu_assert(string == number);
+
+    json_arena_reset(a);
+    json_value_from_cstr_in(a, "a string too long to fit in a value");
+    mu_assert(json_arena_bytes_used(a) > number);
+    json_arena_destroy(a);
+}
+
+static void test_parsed_strings()
+{
+    const char* input = "[\"\", \"GB\", \"a\\tb\", "
+        "\"a string too long to fit in a value\"]";
+    char* s;
+
+    Json_value* v = json_parse(input, NULL);
+    mu_assert(v != NULL);
+    s = json_stringify(v);
+    mu_assert(strcmp(s, input) == 0);
+    free(s);
+    json_value_destroy(v);
+}
+
+// Tests that `v` is written as `text`.
+static int is_text(const Json_value* v, const char* text)
+{
+    char* s = json_stringify(v);
+    const int ok = strcmp(s, text) == 0;
+    free(s);
+    return ok;
+}
+
+// A document, as json_stringify writes it.
+static const char* document =
+    "{\"id\":7, \"user\":{\"name\":\"ann\", \"tags\":[\"a\", \"b\"]}, "
+    "\"items\":[{\"n\":1}, {\"n\":2}]}";
+
+static void test_copies_share()
+{
+    Json_value* v = json_parse(document, NULL);
+    Json_value* w = json_value_copy(v);
+
+    mu_assert(w != v && is_text(w, document));
+    mu_assert(json_value_get_key(w, "user") == json_value_get_key(v, "user"));
+
+    // Changing either one leaves the other as it was.
+    json_value_set_key(w, "id", json_value_from_double(8));
+    json_value_set_key(v, "extra", json_value_new_null());
+    mu_assert(json_value_get_double(json_value_get_key(v, "id")) == 7);
+    mu_assert(json_value_get_double(json_value_get_key(w, "id")) == 8);
+    mu_assert(json_value_get_key(w, "extra") == NULL);
+    mu_assert(json_value_get_key(w, "user") == json_value_get_key(v, "user"));
+
+    // Copies of copies, destroyed in any order.
+    Json_value* x = json_value_copy(w);
+    json_value_destroy(w);
+    json_value_destroy(v);
+    mu_assert(json_value_get_double(json_value_get_key(x, "id")) == 8);
+    json_value_destroy(x);
+}
+
+static void test_changes_copy_the_path()
+{
+    Json_value* v = json_parse(document, NULL);
+    Json_value* w = json_value_copy(v);
+
+    Json_value* user = json_value_get_key_mutable(w, "user");
+    json_value_append(json_value_get_key_mutable(user, "tags"),
+                      json_value_from_cstr("c"));
+    json_value_set_key(json_value_get_element_mutable(
+                           json_value_get_key_mutable(w, "items"), 1),
+                       "n", json_value_from_double(3));
+
+    mu_assert(is_text(v, document));
+    mu_assert(is_text(w, "{\"id\":7, \"user\":{\"name\":\"ann\", "
+                         "\"tags\":[\"a\", \"b\", \"c\"]}, "
+                         "\"items\":[{\"n\":1}, {\"n\":3}]}"));
+
+    // What is off the path is still shared.
+    const Json_value* vu = json_value_get_key(v, "user");
+    mu_assert(user != vu);
+    mu_assert(json_value_get_key(user, "name")
+              == json_value_get_key(vu, "name"));
+    Json_iterator* i = json_iterator_create(json_value_get_key(v, "items"));
+    Json_iterator* j = json_iterator_create(json_value_get_key(w, "items"));
+    mu_assert(json_iterator_curr_value(i) == json_iterator_curr_value(j));
+    json_iterator_advance(i);
+    json_iterator_advance(j);
+    mu_assert(json_iterator_curr_value(i) != json_iterator_curr_value(j));
+    json_iterator_destroy(i);
+    json_iterator_destroy(j);
+
+    // Values of their own are changed in place.
+    mu_assert(json_value_get_key_mutable(w, "user") == user);
+    mu_assert(json_value_get_key_mutable(w, "none") == NULL);
+    mu_assert(json_value_get_element_mutable(
+                  json_value_get_key_mutable(w, "items"), 2) == NULL);
+    json_value_destroy(v);
+    json_value_destroy(w);
+}
+
+static void test_borrowed_values_are_copied()
+{
+    Json_arena* a = json_arena_create(0);
+    char buf[] = "[[\"in situ\"], {\"k\": 1}]";
+    char s[] = "borrowed";
+    Json_value* v = json_parse_insitu(buf, NULL, NULL);
+    Json_value* arena_value = json_parse_arena(document, a, NULL);
+    Json_value* nested = json_value_new_array(0);
+    Json_value* inner = json_value_new_array(0);
+
+    json_value_append(inner, json_value_from_cstr_nocopy_in(NULL, s, 8));
+    json_value_append(nested, inner);
+
+    Json_value* copies[] = {
+        json_value_copy(v),
+        json_value_copy(arena_value),
+        json_value_copy(nested),
+    };
+    json_value_destroy(v);
+    json_value_destroy(nested);
+    json_arena_destroy(a);
+    memset(buf, 'x', sizeof(buf) - 1);
+    memset(s, 'x', sizeof(s) - 1);
+
+    mu_assert(is_text(copies[0], "[[\"in situ\"], {\"k\":1}]"));
+    mu_assert(is_text(copies[1], document));
+    mu_assert(is_text(copies[2], "[[\"borrowed\"]]"));
+    json_value_destroy(copies[0]);
+    json_value_destroy(copies[1]);
+    json_value_destroy(copies[2]);
+}
+
+// Values that come to borrow memory once they are in an array or object,
+// through the _mutable accessors, are copied all the same.
+static void test_values_borrowed_later_are_copied()
+{
+    char s[] = "borrowed";
+    Json_value* v = json_parse("{\"list\": [1], \"items\": [[2], {}]}",
+                               NULL);
+
+    json_value_append(json_value_get_key_mutable(v, "list"),
+                      json_value_from_cstr_nocopy_in(NULL, s, 8));
+    Json_value* w = json_value_copy(v);
+    json_value_append(json_value_get_element_mutable(
+                          json_value_get_key_mutable(w, "items"), 0),
+                      json_value_from_cstr_nocopy_in(NULL, s, 8));
+    Json_value* x = json_value_copy(w);
+    json_value_destroy(v);
+    json_value_destroy(w);
+    memset(s, 'x', sizeof(s) - 1);
+
+    mu_assert(is_text(x, "{\"list\":[1, \"borrowed\"], "
+                         "\"items\":[[2, \"borrowed\"], {}]}"));
+    json_value_destroy(x);
+}
+
+enum { n_threads = 8, n_rounds = 2000 };
+
+// Copies and changes `arg`, a value whose contents are shared with the
+// other threads, checking that it is unchanged, and destroys it.
+static void* use_shared(void* arg)
+{
+    Json_value* v = (Json_value*) arg;
+    long ok = 1;
+    int i;
+
+    for (i = 0; i < n_rounds; i++) {
+        Json_value* w = json_value_copy(v);
+        Json_value* item = json_value_get_element_mutable(
+            json_value_get_key_mutable(w, "items"), i % 2);
+        json_value_set_key(item, "n", json_value_from_double(i));
+        ok &= json_value_get_double(json_value_get_key(item, "n")) == i
+            && is_text(v, document);
+        json_value_destroy(w);
+    }
+    ok &= is_text(v, document);
+    json_value_destroy(v);
+    return (void*) ok;
+}
+
+static void test_threads()
+{
+    Json_value* v = json_parse(document, NULL);
+    pthread_t threads[n_threads];
+    void* ok;
+    int i;
+
+    for (i = 0; i < n_threads; i++) {
+        pthread_create(&threads[i], NULL, use_shared, json_value_copy(v));
+    }
+    json_value_destroy(v);
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], &ok);
+        mu_assert(ok != NULL);
+    }
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_strings);
+    mu_run_test(test_short_strings_take_no_memory);
+    mu_run_test(test_parsed_strings);
+    mu_run_test(test_copies_share);
+    mu_run_test(test_changes_copy_the_path);
+    mu_run_test(test_borrowed_values_are_copied);
+    mu_run_test(test_values_borrowed_later_are_copied);
+    mu_run_test(test_threads);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
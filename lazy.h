@@ -0,0 +1,33 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_LAZY__
+#define __INCLUDED_LIBJSON_LAZY__
+
+// Internal interface between the parser and Json_value for lazily parsed
+// arrays and objects (see json_parse_lazy).
+
+#include "json.h"
+
+// Creates an array or object, allocated from `a` (or the heap if `a` is
+// null), whose contents are the `length` bytes of text at `text` (including
+// its brackets). The text must outlive the value; it is parsed when the
+// contents are first needed.
+Json_value* json_value_new_lazy_in(Json_arena* a,
+                                   Json_type type,
+                                   const char* text,
+                                   size_t length);
+
+// Parses the array or object that is the `length` bytes at `text`, making its
+// own arrays and objects lazy in turn. The result is allocated from `arena`
+// (or the heap if `arena` is null). Returns null if the text is malformed.
+Json_value* lazy_parse_container(const char* text,
+                                 size_t length,
+                                 Json_arena* arena);
+
+#endif
@@ -7,61 +7,56 @@
 // DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
 
 #include "lexer.h"
-#include "str.h"
+#include "number.h"
+#include "scan.h"
 #include "utilities.h"
 #include <assert.h>
 #include <ctype.h>
-#include <errno.h>
 #include <string.h>
 
-struct Lexer {
-    const char* start;              // start of input
-    const char* curr;               // current position in input
-    const char* end;                // one past last character in input
-    int line;                       // current line number
-    const char* curr_line_start;    // for computing column# within line
-    char* tok_str;                  // storage for string tokens
-    int tok_str_size;               // capacity of token_string
-    Token token;                    // current token in stream
-    Lexer_error error;              // stores the error state
-};
-
 //
 // +--------------------+
 // | internal functions |
 // +--------------------+
 //
 
-// Copies the first `n` bytes starting at `p` into `lex->tok_str`.
-static const char* _copy_cstr_into_lexer(Lexer* lex, const char* p, int n)
+// Makes room for at least `size` bytes in `lex->tok_str`, preserving its
+// contents.
+static void _reserve_tok_str(Lexer* lex, size_t size)
 {
-    const int size = n + 1;
     if (lex->tok_str_size < size) {
-        lex->tok_str = (char*) erealloc(lex->tok_str, size);
-        lex->tok_str_size = size;
+        const size_t new_size = egrow(lex->tok_str_size, size);
+        lex->tok_str = (char*) erealloc(lex->tok_str, new_size);
+        lex->tok_str_size = new_size;
     }
-    memcpy(lex->tok_str, p, n);
-    lex->tok_str[n] = '\0';
-    return lex->tok_str;
 }
 
-// Copies contents `s` into `lex->tok_str`.
-static const char* _copy_str_into_lexer(Lexer* lex, const Str* s)
+// Copies the first `n` bytes starting at `p` into `lex->tok_str`.
+static const char* _copy_cstr_into_lexer(Lexer* lex, const char* p, size_t n)
 {
-    return _copy_cstr_into_lexer(lex, str_cstr(s), str_length(s));
+    _reserve_tok_str(lex, n + 1);
+    memcpy(lex->tok_str, p, n);
+    lex->tok_str[n] = '\0';
+    lex->token.length = n;
+    return lex->tok_str;
 }
 
-// Stores the current token and advances the lexer `length` characters.
-static void _store_token(Lexer* lex, Json_token_type type, int length)
+// Stores the current token and advances the lexer `length` characters. The
+// token may be a keyword that was suspended as an identifier while only a
+// part of it had been seen, so whatever was recorded for resuming it goes.
+static void _store_token(Lexer* lex, Json_token_type type, size_t length)
 {
     lex->token.type = type;
     lex->curr += length;
+    lex->resume_offset = 0;
 }
 
 // Case-insentive keyword match.
 static int _match_keyword(const Lexer* lex, const char* keyword)
 {
-    return strncasecmp(lex->curr, keyword, strlen(keyword)) == 0;
+    const int n = strlen(keyword);
+    return lex->end - lex->curr >= n
+        && strncasecmp(lex->curr, keyword, n) == 0;
 }
 
 // Tests whether an identifier begins at current position.
@@ -71,6 +66,53 @@ static int _match_identifier(const Lexer* lex)
     return isalpha(c) || c == '_';
 }
 
+// Rewinds the lexer to the start of the current token, which may continue in
+// input not seen yet. Returns 0.
+static int _need_more_input(Lexer* lex)
+{
+    lex->curr = lex->tok_start;
+    lex->line = lex->tok_line;
+    lex->curr_line_start = lex->tok_line_start;
+    lex->error = lexer_error_need_more_input;
+    return 0;
+}
+
+// Abandons the current token, as _need_more_input does, but first records
+// that it has been lexed as far as `p`, with `written` bytes of its string
+// in `lex->tok_str`, so that it can be resumed there. Returns 0.
+static int _suspend(Lexer* lex, const char* p, size_t written)
+{
+    lex->resume_offset = p - lex->tok_start;
+    lex->resume_written = written;
+    lex->resume_lines = lex->line - lex->tok_line;
+    lex->resume_line_start = lex->curr_line_start - lex->tok_start;
+    return _need_more_input(lex);
+}
+
+// Returns how many bytes of the token at the current position were lexed
+// before it was suspended, if it was (see _suspend), restoring the line count
+// as of there.
+static size_t _resume(Lexer* lex)
+{
+    const size_t offset = lex->resume_offset;
+
+    if (offset > 0) {
+        if (lex->resume_lines > 0) {
+            lex->line += lex->resume_lines;
+            lex->curr_line_start = lex->curr + lex->resume_line_start;
+        }
+        lex->resume_offset = 0;
+    }
+    return offset;
+}
+
+// Tests whether the input seen so far ends within `n` characters of `p`, in
+// an incremental lexer that expects more.
+static int _window_ends(const Lexer* lex, const char* p, int n)
+{
+    return !lex->final && lex->end - p <= n;
+}
+
 // Increments the lexer line number.
 static void _next_line(Lexer* lex)
 {
@@ -85,7 +127,7 @@ static int _skip_newline(Lexer* lex)
     char c = lex->curr[0];
 
     if (c == '\n' || c == '\r') {   // deal with line endings
-        if (c == '\r' && lex->curr[1] == '\n') {
+        if (c == '\r' && lex->curr + 1 < lex->end && lex->curr[1] == '\n') {
             lex->curr++;            // special handling for CRLFs
         }
         lex->curr++;
@@ -98,12 +140,8 @@ static int _skip_newline(Lexer* lex)
 // Advances lexer past whitespace; returns non-zero if input remains.
 static int _skip_ws(Lexer* lex)
 {
-    char c;
-    while (isspace(c = lex->curr[0])) {
-        if (!_skip_newline(lex)) {
-            lex->curr++;
-        }
-    }
+    lex->curr = scan_whitespace(lex->curr, lex->end,
+                                &lex->line, &lex->curr_line_start);
     return lex->curr < lex->end;
 }
 
@@ -111,9 +149,12 @@ static int _skip_ws(Lexer* lex)
 static void _skip_slash_slash_comment(Lexer* lex)
 {
     assert(lex->curr[0] == '/' && lex->curr[1] == '/');
-    lex->curr += 2;
-    while (lex->curr < lex->end && !_skip_newline(lex)) {
-        lex->curr++;
+    const size_t resumed = _resume(lex);
+    lex->curr = scan_line_end(lex->curr + (resumed ? resumed : 2), lex->end);
+    if (lex->curr < lex->end) {
+        _skip_newline(lex);
+    } else if (_window_ends(lex, lex->curr, 0)) {
+        _suspend(lex, lex->curr, 0);
     }
 }
 
@@ -121,16 +162,24 @@ static void _skip_slash_slash_comment(Lexer* lex)
 static void _skip_slash_star_comment(Lexer* lex)
 {
     assert(lex->curr[0] == '/' && lex->curr[1] == '*');
-    lex->curr += 2;
-    while (lex->curr < lex->end) {
-        if (lex->curr[0] == '*' && lex->curr[1] == '/') {
+    const size_t resumed = _resume(lex);
+    lex->curr += resumed ? resumed : 2;
+    while ((lex->curr = scan_block_comment(lex->curr, lex->end)) < lex->end) {
+        if (lex->curr[0] != '*') {
+            _skip_newline(lex);
+        } else if (lex->curr + 1 < lex->end && lex->curr[1] == '/') {
             lex->curr += 2;
             return;
-        }
-        if (!_skip_newline(lex)) {
+        } else {
             lex->curr++;
         }
     }
+    if (_window_ends(lex, lex->curr, 0)) {
+        // A '*' at the end may be the start of the "*/".
+        _suspend(lex, lex->curr - (lex->curr[-1] == '*'
+                                   && lex->curr - lex->tok_start > 2), 0);
+        return;
+    }
     lex->error = lexer_error_runaway_comment;
 }
 
@@ -138,7 +187,7 @@ static void _skip_slash_star_comment(Lexer* lex)
 // returns 1. Otherwise, returns 0.
 static int _skip_comment(Lexer* lex)
 {
-    if (lex->curr[0] == '/') {
+    if (lex->curr[0] == '/' && lex->curr + 1 < lex->end) {
         if (lex->curr[1] == '/') {
             _skip_slash_slash_comment(lex);
             return 1;
@@ -151,7 +200,11 @@ static int _skip_comment(Lexer* lex)
     return 0;
 }
 
-// Parses a double-quoted string token.
+// Parses a quoted string token. The unescaped string is written to
+// `lex->tok_str`, or over the input itself if the lexer is in-situ; the
+// unescaped text is never longer than the quoted text, so in the latter case
+// writes never overtake the bytes still to be read. Runs of ordinary
+// characters are found with scan_string and copied in bulk.
 static int _parse_string(Lexer* lex)
 {
     // FIXME: convert unicode character sequences
@@ -160,40 +213,90 @@ static int _parse_string(Lexer* lex)
         JSON_PANIC(("Current token must begin with \" or '."));
     }
 
-    Str* answer = str_create(16);
-    const char* p = lex->curr + 1;
+    const size_t resumed = _resume(lex);
+    const char* p = lex->curr + (resumed ? resumed : 1);
     const char terminator = lex->curr[0];
+    char* answer;
+    char* w;        // where the next unescaped character goes
+    char* w_end;    // end of the space available at `w`
+
+    if (lex->insitu) {
+        answer = w = (char*) p;
+        w_end = (char*) lex->end;
+    } else {
+        answer = lex->tok_str;
+        w = lex->tok_str + (resumed ? lex->resume_written : 0);
+        w_end = lex->tok_str + lex->tok_str_size - 1;
+    }
+
+// Makes room for `n` more characters, growing the token buffer if necessary.
+#define RESERVE(n) do {                                                 \
+        if ((size_t) (w_end - w) < (n)) {                               \
+            const size_t used = w - lex->tok_str;                       \
+            _reserve_tok_str(lex, used + (n) + 1);                      \
+            answer = lex->tok_str;                                      \
+            w = lex->tok_str + used;                                    \
+            w_end = lex->tok_str + lex->tok_str_size - 1;               \
+        }                                                               \
+    } while (0)
+
+// Appends `c` to the string.
+#define PUT(c) do { RESERVE(1); *w++ = (c); } while (0)
+
+    for (;;) {
+        // Copy the run of characters that need no special treatment. In situ,
+        // there is nothing to copy until the first escape sequence.
+        const char* q = scan_string(p, lex->end, terminator);
+        const size_t n = q - p;
+        if (w != p) {
+            RESERVE(n);
+            memmove(w, p, n);
+        }
+        w += n;
+        p = q;
+
+        if (p >= lex->end) {
+            break;
+        }
 
-    for (; p < lex->end; p++) {
         if (*p == terminator) {
+            *w = '\0';
             lex->token.type = json_token_type_string;
-            lex->token.value.string = _copy_str_into_lexer(lex, answer);
-            str_destroy(answer);
+            lex->token.value.string = answer;
+            lex->token.length = w - answer;
             lex->curr = p + 1;
             return 1;
         } else if (*p == '\\') {
+            if (_window_ends(lex, p, 1)) {
+                break;
+            }
+            if (p + 1 == lex->end) {    // as if followed by a nul
+                lex->error = lexer_error_illegal_escape_sequence;
+                return 0;
+            }
             if (p[1] == terminator) {
-                str_append_char(&answer, *++p);
+                PUT(*++p);
+                p++;
                 continue;
             }
             switch (p[1]) {
             case '\\': case '/':
-                str_append_char(&answer, p[1]);
+                PUT(p[1]);
                 break;
             case 'b':
-                str_append_char(&answer, '\b');
+                PUT('\b');
                 break;
             case 'f':
-                str_append_char(&answer, '\f');
+                PUT('\f');
                 break;
             case 'n':
-                str_append_char(&answer, '\n');
+                PUT('\n');
                 break;
             case 'r':
-                str_append_char(&answer, '\r');
+                PUT('\r');
                 break;
             case 't':
-                str_append_char(&answer, '\t');
+                PUT('\t');
                 break;
             case 'u':
                 JSON_PANIC(("unicode not supported yet"));
@@ -203,39 +306,94 @@ static int _parse_string(Lexer* lex)
                 lex->error = lexer_error_illegal_escape_sequence;
                 return 0;
             }
-            p++;
-        } else if (*p == '\n' || *p == '\r') {
-            if (*p == '\r' && *(p+1) == '\n') {
-                str_append_char(&answer, *p++);
+            p += 2;
+        } else {    // '\n' or '\r'
+            if (*p == '\r' && p + 1 < lex->end && p[1] == '\n') {
+                PUT(*p++);
             }
-            str_append_char(&answer, *p);
+            PUT(*p++);
             _next_line(lex);
-        } else {
-            str_append_char(&answer, *p);
         }
     }
 
+#undef PUT
+#undef RESERVE
+
+    if (_window_ends(lex, p, 1)) {
+        return _suspend(lex, p, w - answer);
+    }
+
     // runaway string
     lex->error = lexer_error_runaway_string;
-    str_destroy(answer);
     return 0;
 }
 
+// Checks the quoted string token at the current position, as _parse_string
+// would parse it, but without copying it (see lexer_init_validating).
+static int _check_string(Lexer* lex)
+{
+    const char* p = lex->curr + 1;
+    const char terminator = lex->curr[0];
+
+    for (;;) {
+        p = scan_string(p, lex->end, terminator);
+        if (p >= lex->end) {
+            lex->error = lexer_error_runaway_string;
+            return 0;
+        }
+
+        if (*p == terminator) {
+            lex->token.type = json_token_type_string;
+            lex->token.value.string = lex->curr + 1;
+            lex->token.length = p - (lex->curr + 1);
+            lex->curr = p + 1;
+            return 1;
+        } else if (*p == '\\') {
+            if (p + 1 == lex->end
+                || (p[1] != terminator && (p[1] == '\0' || p[1] == 'u'
+                                           || !strchr("\\/bfnrt", p[1]))))
+            {
+                lex->error = lexer_error_illegal_escape_sequence;
+                return 0;
+            }
+            p += 2;
+        } else {    // '\n' or '\r'
+            if (*p == '\r' && p + 1 < lex->end && p[1] == '\n') {
+                p++;
+            }
+            p++;
+            _next_line(lex);
+        }
+    }
+}
+
 // Parses a numeric token.
 static int _parse_number(Lexer* lex)
 {
-    errno = 0;
+    const char* endptr;
+    double d;
+    const size_t resumed = _resume(lex);
 
-    char* endptr;
-    const double d = strtod(lex->curr, &endptr);
+    if (!lex->final) {  // the number may go on in the next window
+        const char* p = lex->curr + resumed;
+        while (p < lex->end && *p != '\0' && strchr("+-.0123456789eE", *p)) {
+            p++;
+        }
+        if (p == lex->end) {
+            return _suspend(lex, p, 0);
+        }
+    }
 
-    if (errno == ERANGE) {      // underflow if d is zero, else overflow
-        lex->error = (d == 0.0)
-            ? lexer_error_numeric_underflow
-            : lexer_error_numeric_overflow;
+    switch (number_parse(lex->curr, lex->end, &d, &endptr)) {
+    case number_status_success:
+        break;
+    case number_status_overflow:
+        lex->error = lexer_error_numeric_overflow;
         return 0;
-    }
-    if (lex->curr == endptr) {  // no conversion was performed
+    case number_status_underflow:
+        lex->error = lexer_error_numeric_underflow;
+        return 0;
+    case number_status_invalid:
         lex->error = lexer_error_invalid_number;
         return 0;
     }
@@ -250,20 +408,30 @@ static int _parse_number(Lexer* lex)
 static int _parse_identifier(Lexer* lex)
 {
     const char* p;
-    int len;
+    size_t len;
 
     if (!_match_identifier(lex)) {
         JSON_PANIC(("Expected an identifier at current position."));
     }
 
-    for (p = lex->curr + 1; p != lex->end; p++) {
+    const size_t resumed = _resume(lex);
+    for (p = lex->curr + (resumed ? resumed : 1); p != lex->end; p++) {
         if (!isalnum(*p) && *p != '_') {
             break;
         }
     }
 
+    if (_window_ends(lex, p, 0)) {
+        return _suspend(lex, p, 0);
+    }
+
     len = p - lex->curr;
-    lex->token.value.string = _copy_cstr_into_lexer(lex, lex->curr, len);
+    if (lex->validate) {
+        lex->token.value.string = lex->curr;
+        lex->token.length = len;
+    } else {
+        lex->token.value.string = _copy_cstr_into_lexer(lex, lex->curr, len);
+    }
     _store_token(lex, json_token_type_identifier, len);
     return 1;
 }
@@ -277,12 +445,174 @@ static int _parse_identifier(Lexer* lex)
 Lexer* lexer_create(const char* input)
 {
     Lexer* lex = (Lexer*) emalloc(sizeof(Lexer));
+    lex->insitu = 0;
+    lex->validate = 0;
     lex->curr = lex->curr_line_start = lex->start = input;
     lex->end = lex->start + strlen(lex->start);
     lex->line = 0;
     lex->tok_str_size = 50;
     lex->tok_str = (char*) emalloc(lex->tok_str_size);
     lex->error = lexer_error_success;
+    lex->final = 1;
+    lex->column_carry = 0;
+    lex->carry_line = 0;
+    lex->resume_offset = 0;
+    return lex;
+}
+
+Lexer* lexer_create_span(const char* input, size_t length)
+{
+    Lexer* lex = lexer_create("");
+    lex->curr = lex->curr_line_start = lex->start = input;
+    lex->end = input + length;
+    return lex;
+}
+
+void lexer_init_validating(Lexer* lex, const char* input, size_t length)
+{
+    lex->insitu = 0;
+    lex->validate = 1;
+    lex->curr = lex->curr_line_start = lex->start = input;
+    lex->end = input + length;
+    lex->line = 0;
+    lex->tok_str = NULL;
+    lex->tok_str_size = 0;
+    lex->token.type = json_token_type_error;
+    lex->error = lexer_error_success;
+    lex->final = 1;
+    lex->column_carry = 0;
+    lex->carry_line = 0;
+    lex->resume_offset = 0;
+}
+
+Lexer* lexer_create_incremental()
+{
+    Lexer* lex = lexer_create("");
+    lex->final = 0;
+    return lex;
+}
+
+void lexer_set_window(Lexer* lex,
+                      const char* input,
+                      size_t length,
+                      int final)
+{
+    lex->column_carry = lexer_column(lex);
+    lex->carry_line = lex->line;
+    lex->curr = lex->curr_line_start = lex->start = input;
+    lex->end = input + length;
+    lex->final = final;
+    if (lex->error == lexer_error_need_more_input) {
+        lex->error = lexer_error_success;
+    }
+}
+
+const char* lexer_position(const Lexer* lex)
+{
+    return lex->curr;
+}
+
+const char* lexer_token_start(const Lexer* lex)
+{
+    return lex->tok_start;
+}
+
+// The bytes that lexer_skip_container must look at.
+static const char _skip_special[256] = {
+    ['['] = 1, [']'] = 1, ['{'] = 1, ['}'] = 1, ['"'] = 1, ['\''] = 1,
+    ['/'] = 1, ['\n'] = 1, ['\r'] = 1,
+};
+
+int lexer_skip_container(Lexer* lex)
+{
+    const char* p = lex->curr;
+    const char* end = lex->end;
+    int depth = 1;
+    char c;
+
+    assert(lex->final);
+
+// Counts the line ending `c` (the byte before `p`).
+#define NEXT_LINE() do {                                                \
+        if (c == '\r' && p < end && *p == '\n') {                       \
+            p++;                                                        \
+        }                                                               \
+        lex->line++;                                                    \
+        lex->curr_line_start = p;                                       \
+    } while (0)
+
+    for (;;) {
+        while (p < end && !_skip_special[(unsigned char) *p]) {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+        switch (c = *p++) {
+        case '[': case '{':
+            depth++;
+            break;
+        case ']': case '}':
+            if (--depth == 0) {
+                lex->curr = p;
+                return 1;
+            }
+            break;
+        case '"': case '\'': {
+            const char quote = c;
+            const char* start = p - 1;
+            for (;;) {
+                p = scan_string(p, end, quote);
+                if (p == end) {
+                    lex->error = lexer_error_runaway_string;
+                    return 0;
+                }
+                if ((c = *p++) == quote) {
+                    break;
+                } else if (c == '\\') {
+                    p += p < end;
+                } else {
+                    NEXT_LINE();
+                    lex->curr_line_start = start;   // as in _parse_string
+                }
+            }
+            break;
+        }
+        case '/':
+            if (p < end && *p == '/') {
+                p = scan_line_end(p + 1, end);
+            } else if (p < end && *p == '*') {
+                for (p++; (p = scan_block_comment(p, end)) < end; ) {
+                    if ((c = *p++) != '*') {
+                        NEXT_LINE();
+                    } else if (p < end && *p == '/') {
+                        break;
+                    }
+                }
+                if (p == end) {
+                    lex->error = lexer_error_runaway_comment;
+                    return 0;
+                }
+                p++;
+            }
+            break;
+        case '\n': case '\r':
+            NEXT_LINE();
+            break;
+        }
+    }
+
+#undef NEXT_LINE
+
+    lex->curr = p;
+    lex->error = lexer_error_input_exhausted;
+    return 0;
+}
+
+Lexer* lexer_create_insitu(char* input)
+{
+    Lexer* lex = lexer_create(input);
+    lex->insitu = 1;
     return lex;
 }
 
@@ -314,6 +644,10 @@ int lexer_advance(Lexer* lex)
         return 0;
 
     while (_skip_ws(lex)) {
+        lex->tok_start = lex->curr;
+        lex->tok_line = lex->line;
+        lex->tok_line_start = lex->curr_line_start;
+
         switch (lex->curr[0]) {
         case '[':
             _store_token(lex, json_token_type_left_bracket, 1);
@@ -335,7 +669,7 @@ int lexer_advance(Lexer* lex)
             return 1;
 
         case '"': case '\'':
-            return _parse_string(lex);
+            return lex->validate ? _check_string(lex) : _parse_string(lex);
 
         case '+': case '-': case '0': case '1': case '2': case '3':
         case '4': case '5': case '6': case '7': case '8': case '9':
@@ -368,6 +702,9 @@ int lexer_advance(Lexer* lex)
                     return 0;
                 continue;
             }
+            if (_window_ends(lex, lex->curr, 1)) {
+                return _need_more_input(lex);
+            }
         }
 
         if (_match_identifier(lex)) {
@@ -378,18 +715,20 @@ int lexer_advance(Lexer* lex)
         return 0;
     }
 
-    lex->error = lexer_error_input_exhausted;
+    lex->error = lex->final ? lexer_error_input_exhausted
+                            : lexer_error_need_more_input;
     return 0;
 }
 
-int lexer_line(const Lexer* lex)
+size_t lexer_line(const Lexer* lex)
 {
     return lex->line;
 }
 
-int lexer_column(const Lexer* lex)
+size_t lexer_column(const Lexer* lex)
 {
-    return lex->curr - lex->curr_line_start;
+    const size_t carry = lex->line == lex->carry_line ? lex->column_carry : 0;
+    return lex->curr - lex->curr_line_start + carry;
 }
 
 const char* token_type_to_string(Json_token_type type)
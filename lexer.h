@@ -12,6 +12,7 @@
 // Zero-lookahead lexical analyzer for JSON syntax.
 
 #include "tokens.h"
+#include <stddef.h>
 #include <stdio.h>
 
 typedef enum Lexer_error Lexer_error;
@@ -25,6 +26,7 @@ enum Lexer_error {
     lexer_error_numeric_underflow,
     lexer_error_invalid_number,
     lexer_error_unexpected_input,
+    lexer_error_need_more_input,    // only in incremental lexers
 };
 
 typedef struct Token Token;
@@ -34,18 +36,102 @@ struct Token {
         const char* string;
         double number;
     } value;        // set only when the value isn't implied by type
+    size_t length;  // length of value.string, for strings and identifiers
 };
 
+// The fields are private to lexer.c. The structure is defined here only so
+// that a validating lexer can live on the stack (see lexer_init_validating).
 typedef struct Lexer Lexer;
+struct Lexer {
+    int insitu;                     // unescape strings over the input?
+    int validate;                   // check strings without copying them?
+    const char* start;              // start of input
+    const char* curr;               // current position in input
+    const char* end;                // one past last character in input
+    size_t line;                    // current line number
+    const char* curr_line_start;    // for computing column# within line
+    char* tok_str;                  // storage for string tokens
+    size_t tok_str_size;            // capacity of token_string
+    Token token;                    // current token in stream
+    Lexer_error error;              // stores the error state
+
+    // Incremental lexing. Unless `final`, the input may continue past `end`;
+    // a token that reaches it is abandoned and the lexer rewound to the
+    // saved `tok_*` state. The first `column_carry` columns of line
+    // `carry_line` lie in earlier windows.
+    int final;
+    const char* tok_start;
+    size_t tok_line;
+    const char* tok_line_start;
+    size_t column_carry;
+    size_t carry_line;
+
+    // How far lexing an abandoned token got, so that lexing it again in the
+    // next window carries on from there: `resume_offset` bytes of it were
+    // scanned (none if zero), the first `resume_written` bytes of its string
+    // were unescaped into `tok_str`, and `resume_lines` line breaks were
+    // crossed, the line after the last starting `resume_line_start` bytes
+    // into it.
+    size_t resume_offset;
+    size_t resume_written;
+    size_t resume_lines;
+    size_t resume_line_start;
+};
 
 Lexer* lexer_create(const char* input);
+
+// Creates a lexer for the `length` bytes at `input`, which need not be
+// followed by a nul. A nul among them does not end the input.
+Lexer* lexer_create_span(const char* input, size_t length);
+
+// Creates a lexer that unescapes string tokens in place, overwriting `input`.
+// The strings of such tokens point into `input` and remain valid (and
+// nul-terminated) for as long as it does. Identifiers are still copied.
+Lexer* lexer_create_insitu(char* input);
+
+// Initializes `lex` to check the `length` bytes at `input`, which need not be
+// followed by a nul, without allocating any memory. Such a lexer copies
+// nothing: the string of a string token is its raw text between the quotes,
+// escape sequences and all, and that of an identifier is its text; neither
+// is nul-terminated. `\u` escapes, which the lexer does not support yet, are
+// reported as illegal. The lexer needs no destroying.
+void lexer_init_validating(Lexer* lex, const char* input, size_t length);
+
+// Creates a lexer for input that arrives in pieces, with no input yet (see
+// lexer_set_window).
+Lexer* lexer_create_incremental();
+
+// Gives the lexer the `length` bytes at `input`, which must be followed by a
+// nul. The bytes must start with those from lexer_position onwards, as that
+// is where lexing resumes; line and column numbers carry on accordingly.
+// Unless `final` is set, more input is assumed to follow, and a token that
+// might continue past the end of the window yields
+// lexer_error_need_more_input, leaving the lexer at the token's start. Also
+// clears that error.
+void lexer_set_window(Lexer* lex,
+                      const char* input,
+                      size_t length,
+                      int final);
+
+// Returns the current position in the input.
+const char* lexer_position(const Lexer* lex);
+
+// Returns the position in the input at which the current token begins.
+const char* lexer_token_start(const Lexer* lex);
+
+// Advances past the array or object whose opening bracket is the current
+// token by matching brackets, without lexing what lies between them: only
+// strings and comments are recognized, so that brackets within them are
+// ignored. Returns 0 if the input ends first. Not for incremental lexers.
+int lexer_skip_container(Lexer* lex);
+
 void lexer_destroy(Lexer* lex);
 Lexer_error lexer_error(const Lexer* lex);
 int lexer_has_error(const Lexer* lex);
 Token lexer_token(Lexer* lex);
 int lexer_advance(Lexer* lex);
-int lexer_line(const Lexer* lex);
-int lexer_column(const Lexer* lex);
+size_t lexer_line(const Lexer* lex);
+size_t lexer_column(const Lexer* lex);
 const char* token_type_to_string(Json_token_type type);
 void fprintf_token(FILE* out, Token tok);
 
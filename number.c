@@ -0,0 +1,767 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+// Decimal to binary conversion follows Clinger's fast path for short, exact
+// inputs and the Eisel-Lemire algorithm (as in Lemire, "Number Parsing at a
+// Gigabyte per Second") for everything else. The rare inputs with more than
+// 19 significant digits that Eisel-Lemire cannot round unambiguously are
+// settled by comparing their digits, exactly, with the point halfway between
+// the two candidate doubles, as big integers; this never consults the locale.
+//
+// Binary to decimal conversion is Ryu (Adams, "Ryu: Fast Float-to-String
+// Conversion"), which finds the shortest digit string that round-trips.
+
+#include "number.h"
+#include "number_tables.h"
+#include "utilities.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// IEEE 754 binary64 parameters.
+enum {
+    double_mantissa_bits = 52,      // explicitly stored mantissa bits
+    double_minimum_exponent = -1023,
+    double_infinite_power = 0x7ff,  // biased exponent of infinity
+};
+
+// Mantissas of up to this many decimal digits fit in a uint64_t.
+enum { max_exact_digits = 19 };
+
+typedef struct U128 U128;
+struct U128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+// A binary floating-point value: `mantissa` (without the implicit bit) and
+// the biased exponent `power2`.
+typedef struct Adjusted_mantissa Adjusted_mantissa;
+struct Adjusted_mantissa {
+    uint64_t mantissa;
+    int power2;
+};
+
+static U128 _multiply(uint64_t a, uint64_t b)
+{
+    U128 r;
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 p = (unsigned __int128) a * b;
+    r.low = (uint64_t) p;
+    r.high = (uint64_t) (p >> 64);
+#else
+    const uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+    const uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo;
+    const uint64_t hi_lo = a_hi * b_lo;
+    const uint64_t lo_hi = a_lo * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t) hi_lo + lo_hi;
+    r.low = (cross << 32) | (uint32_t) lo_lo;
+    r.high = a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+    return r;
+}
+
+static int _leading_zeros(uint64_t x)
+{
+    return __builtin_clzll(x);
+}
+
+// floor(log2(10^q)) + 63, for q in the range of the powers-of-five table.
+static int _power(int q)
+{
+    return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+// Computes w * 5^q to at least 55 bits of precision (enough to round to 52).
+static U128 _product_approximation(int q, uint64_t w)
+{
+    const unsigned long long* pow5 =
+        number_powers_of_five[q - number_smallest_power_of_five];
+    const uint64_t precision_mask = UINT64_C(0xffffffffffffffff) >> 55;
+
+    U128 first = _multiply(w, pow5[0]);
+    if ((first.high & precision_mask) == precision_mask) {
+        const U128 second = _multiply(w, pow5[1]);
+        first.low += second.high;
+        if (second.high > first.low) {
+            first.high++;
+        }
+    }
+    return first;
+}
+
+// Eisel-Lemire: rounds w * 10^q to the nearest double, for nonzero w.
+static Adjusted_mantissa _compute_float(int64_t q, uint64_t w)
+{
+    Adjusted_mantissa answer;
+
+    if (q < number_smallest_power_of_five) {
+        answer.power2 = 0;
+        answer.mantissa = 0;
+        return answer;
+    }
+    if (q > number_largest_power_of_five) {
+        answer.power2 = double_infinite_power;
+        answer.mantissa = 0;
+        return answer;
+    }
+
+    const int lz = _leading_zeros(w);
+    w <<= lz;
+    const U128 product = _product_approximation((int) q, w);
+    const int upperbit = (int) (product.high >> 63);
+    const int shift = upperbit + 64 - double_mantissa_bits - 3;
+
+    answer.mantissa = product.high >> shift;
+    answer.power2 =
+        _power((int) q) + upperbit - lz - double_minimum_exponent;
+
+    if (answer.power2 <= 0) {   // subnormal (or zero)
+        if (-answer.power2 + 1 >= 64) {
+            answer.power2 = 0;
+            answer.mantissa = 0;
+            return answer;
+        }
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        answer.power2 =
+            answer.mantissa < (UINT64_C(1) << double_mantissa_bits) ? 0 : 1;
+        return answer;
+    }
+
+    // Values exactly halfway between two doubles must round to even; only
+    // small powers of ten can produce them.
+    if (product.low <= 1 && q >= -4 && q <= 23 && (answer.mantissa & 3) == 1) {
+        if ((answer.mantissa << shift) == product.high) {
+            answer.mantissa &= ~UINT64_C(1);
+        }
+    }
+
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    if (answer.mantissa >= (UINT64_C(2) << double_mantissa_bits)) {
+        answer.mantissa = UINT64_C(1) << double_mantissa_bits;
+        answer.power2++;
+    }
+    answer.mantissa &= ~(UINT64_C(1) << double_mantissa_bits);
+    if (answer.power2 >= double_infinite_power) {
+        answer.power2 = double_infinite_power;
+        answer.mantissa = 0;
+    }
+    return answer;
+}
+
+static double _to_double(Adjusted_mantissa am, int negative)
+{
+    const uint64_t bits = am.mantissa
+        | ((uint64_t) am.power2 << double_mantissa_bits)
+        | ((uint64_t) (negative != 0) << 63);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// Exact powers of ten for Clinger's fast path.
+static const double _exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Significant digits beyond this many cannot change how a number rounds:
+// a point halfway between two doubles has at most 767 of them, so the rest
+// need only be known to be zero or not.
+enum { max_decimal_digits = 768 };
+
+// Unsigned big integers, big enough for any of the products compared below
+// (about 4,700 bits at most).
+enum { big_limbs = 192 };
+
+typedef struct Big Big;
+struct Big {
+    uint32_t limbs[big_limbs];  // least significant first
+    int n;                      // number in use
+};
+
+static void _big_mul_small(Big* b, uint32_t m)
+{
+    uint64_t carry = 0;
+    int i;
+
+    for (i = 0; i < b->n; i++) {
+        carry += (uint64_t) b->limbs[i] * m;
+        b->limbs[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    if (carry != 0) {
+        assert(b->n < big_limbs);
+        b->limbs[b->n++] = (uint32_t) carry;
+    }
+}
+
+static void _big_add_small(Big* b, uint32_t a)
+{
+    uint64_t carry = a;
+    int i;
+
+    for (i = 0; carry != 0 && i < b->n; i++) {
+        carry += b->limbs[i];
+        b->limbs[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    if (carry != 0) {
+        assert(b->n < big_limbs);
+        b->limbs[b->n++] = (uint32_t) carry;
+    }
+}
+
+static void _big_mul_pow5(Big* b, int64_t e)
+{
+    for (; e >= 13; e -= 13) {
+        _big_mul_small(b, 1220703125);  // 5^13
+    }
+    for (; e > 0; e--) {
+        _big_mul_small(b, 5);
+    }
+}
+
+static void _big_shift_left(Big* b, int64_t bits)
+{
+    const int words = (int) (bits / 32), shift = (int) (bits % 32);
+    int i;
+
+    if (b->n == 0) {
+        return;
+    }
+    assert(b->n + words + 1 <= big_limbs);
+    b->limbs[b->n] = 0;
+    for (i = b->n; i >= 0; i--) {
+        uint32_t limb = b->limbs[i] << shift;
+        if (shift != 0 && i > 0) {
+            limb |= b->limbs[i - 1] >> (32 - shift);
+        }
+        b->limbs[i + words] = limb;
+    }
+    for (i = 0; i < words; i++) {
+        b->limbs[i] = 0;
+    }
+    b->n += words + 1;
+    while (b->n > 0 && b->limbs[b->n - 1] == 0) {
+        b->n--;
+    }
+}
+
+static int _big_compare(const Big* a, const Big* b)
+{
+    int i;
+
+    if (a->n != b->n) {
+        return a->n < b->n ? -1 : 1;
+    }
+    for (i = a->n - 1; i >= 0; i--) {
+        if (a->limbs[i] != b->limbs[i]) {
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Rounds the `n`-byte number at `p`, which is well-formed and lies between
+// `lower` and the next double up, to one of the two: the one it is nearer,
+// or the even one if it is halfway.
+static Adjusted_mantissa _round_exactly(const char* p,
+                                        int n,
+                                        Adjusted_mantissa lower)
+{
+    const char* const end = p + n;
+    Big digits, halfway;
+    int64_t exponent = 0;   // the number is digits * 10^exponent
+    int count = 0, chunk = 0, chunk_digits = 0, dropped_nonzero = 0;
+    int seen_point = 0;
+
+    // Gather the significant digits, nine at a time.
+    digits.n = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    for (; p < end && *p != 'e' && *p != 'E'; p++) {
+        if (*p == '.') {
+            seen_point = 1;
+            continue;
+        }
+        if (count == 0 && *p == '0') {
+            exponent -= seen_point;
+            continue;
+        }
+        if (count == max_decimal_digits) {
+            dropped_nonzero |= *p != '0';
+            exponent += !seen_point;
+            continue;
+        }
+        chunk = 10*chunk + (*p - '0');
+        count++;
+        exponent -= seen_point;
+        if (++chunk_digits == 9) {
+            _big_mul_small(&digits, 1000000000);
+            _big_add_small(&digits, chunk);
+            chunk = chunk_digits = 0;
+        }
+    }
+    if (chunk_digits > 0) {
+        uint32_t scale = 10;
+        while (--chunk_digits > 0) {
+            scale *= 10;
+        }
+        _big_mul_small(&digits, scale);
+        _big_add_small(&digits, chunk);
+    }
+    if (p < end) {
+        int64_t e = 0;
+        int negative = 0;
+        if (++p < end && (*p == '-' || *p == '+')) {
+            negative = *p++ == '-';
+        }
+        for (; p < end; p++) {
+            if (e < 100000) {   // as number_parse limits it
+                e = 10*e + (*p - '0');
+            }
+        }
+        exponent += negative ? -e : e;
+    }
+
+    // The halfway point is (2m + 1) * 2^(power - 1), for the significand m
+    // of `lower` and its binary exponent `power`.
+    uint64_t m = lower.mantissa;
+    const int64_t power = (lower.power2 != 0 ? lower.power2 : 1)
+        + double_minimum_exponent - double_mantissa_bits;
+    if (lower.power2 != 0) {
+        m |= UINT64_C(1) << double_mantissa_bits;
+    }
+    halfway.n = 0;
+    _big_add_small(&halfway, (uint32_t) ((2*m + 1) >> 32));
+    _big_shift_left(&halfway, 32);
+    _big_add_small(&halfway, (uint32_t) (2*m + 1));
+
+    // Compare digits * 5^exponent * 2^exponent with halfway * 2^(power - 1),
+    // moving each factor to whichever side keeps it an integer.
+    const int64_t twos = exponent - (power - 1);
+    if (exponent >= 0) {
+        _big_mul_pow5(&digits, exponent);
+    } else {
+        _big_mul_pow5(&halfway, -exponent);
+    }
+    if (twos >= 0) {
+        _big_shift_left(&digits, twos);
+    } else {
+        _big_shift_left(&halfway, -twos);
+    }
+
+    int order = _big_compare(&digits, &halfway);
+    if (order == 0 && dropped_nonzero) {
+        order = 1;
+    }
+    if (order > 0 || (order == 0 && (m & 1))) {
+        if (++lower.mantissa == UINT64_C(1) << double_mantissa_bits) {
+            lower.mantissa = 0;
+            lower.power2++;
+        }
+    }
+    return lower;
+}
+
+static int _is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+Number_status number_parse(const char* p,
+                           const char* end,
+                           double* value,
+                           const char** endp)
+{
+    const char* s = p;
+    int negative = 0;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        s++;
+    }
+
+    // Accumulate up to 19 significant digits; digits beyond those only
+    // affect the result through `exponent` and `truncated`.
+    uint64_t w = 0;
+    int digits = 0;         // significant digits in `w`
+    int64_t exponent = 0;   // value is w * 10^exponent (if not truncated)
+    int truncated = 0;      // were nonzero digits dropped?
+    int any_digits = 0;
+
+    for (; s < end && _is_digit(*s); s++) {
+        any_digits = 1;
+        if (digits < max_exact_digits) {
+            w = 10*w + (*s - '0');
+            digits += w != 0;
+        } else {
+            exponent++;
+            truncated |= *s != '0';
+        }
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && _is_digit(*s); s++) {
+            any_digits = 1;
+            if (digits < max_exact_digits) {
+                w = 10*w + (*s - '0');
+                digits += w != 0;
+                exponent--;
+            } else {
+                truncated |= *s != '0';
+            }
+        }
+    }
+    if (!any_digits) {
+        return number_status_invalid;
+    }
+
+    // The exponent is only consumed if at least one digit follows the 'e'.
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* t = s + 1;
+        int exp_negative = 0;
+        if (t < end && (*t == '-' || *t == '+')) {
+            exp_negative = *t == '-';
+            t++;
+        }
+        if (t < end && _is_digit(*t)) {
+            int64_t e = 0;
+            for (; t < end && _is_digit(*t); t++) {
+                if (e < 100000) {   // anything larger is just as infinite
+                    e = 10*e + (*t - '0');
+                }
+            }
+            exponent += exp_negative ? -e : e;
+            s = t;
+        }
+    }
+    *endp = s;
+
+    if (w == 0) {
+        *value = negative ? -0.0 : 0.0;
+        return number_status_success;
+    }
+
+    // Clinger's fast path: both operands are exact, so one IEEE operation
+    // gives the correctly rounded result.
+    if (!truncated && exponent >= -22 && exponent <= 22
+        && w <= (UINT64_C(1) << 53))
+    {
+        double d = (double) w;
+        if (exponent < 0) {
+            d /= _exact_powers_of_ten[-exponent];
+        } else {
+            d *= _exact_powers_of_ten[exponent];
+        }
+        *value = negative ? -d : d;
+        return number_status_success;
+    }
+
+    Adjusted_mantissa am = _compute_float(exponent, w);
+
+    // With dropped digits the true value lies between w and w+1 (times
+    // 10^exponent); if those round differently, only the full text can decide.
+    if (truncated) {
+        const Adjusted_mantissa am_up = _compute_float(exponent, w + 1);
+        if (am.mantissa != am_up.mantissa || am.power2 != am_up.power2) {
+            am = _round_exactly(p, s - p, am);
+        }
+    }
+
+    if (am.power2 == double_infinite_power) {
+        return number_status_overflow;
+    }
+    if (am.power2 == 0 && am.mantissa == 0) {
+        return number_status_underflow;
+    }
+    *value = _to_double(am, negative);
+    return number_status_success;
+}
+
+//
+// +-----------------------------+
+// | binary to decimal (Ryu)     |
+// +-----------------------------+
+//
+
+enum { double_bias = 1023 };
+
+// Returns floor(log2(5^e)) + 1 (and 1 for e == 0), for 0 <= e <= 3528.
+static int _pow5_bits(int e)
+{
+    return (int) (((uint32_t) e * 1217359) >> 19) + 1;
+}
+
+// Returns floor(log10(2^e)), for 0 <= e <= 1650.
+static int _log10_pow2(int e)
+{
+    return (int) (((uint32_t) e * 78913) >> 18);
+}
+
+// Returns floor(log10(5^e)), for 0 <= e <= 2620.
+static int _log10_pow5(int e)
+{
+    return (int) (((uint32_t) e * 732923) >> 20);
+}
+
+static int _pow5_factor(uint64_t value)
+{
+    int count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count;
+}
+
+static int _multiple_of_power_of_5(uint64_t value, int p)
+{
+    return _pow5_factor(value) >= p;
+}
+
+static int _multiple_of_power_of_2(uint64_t value, int p)
+{
+    return (value & ((UINT64_C(1) << p) - 1)) == 0;
+}
+
+// Returns (m * mul) >> j, where `mul` is a 128-bit { low, high } pair and
+// 64 < j < 128.
+static uint64_t _mul_shift(uint64_t m, const unsigned long long* mul, int j)
+{
+    const U128 b0 = _multiply(m, mul[0]);
+    const U128 b2 = _multiply(m, mul[1]);
+    const uint64_t low = b0.high + b2.low;
+    const uint64_t high = b2.high + (low < b0.high);
+    const int shift = j - 64;
+    return (high << (64 - shift)) | (low >> shift);
+}
+
+static int _decimal_length(uint64_t v)
+{
+    int n = 1;
+    while (v >= 10) {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+// Computes the shortest `*digits` * 10^`*exponent` that rounds to the finite,
+// positive double with the given IEEE fields.
+static void _shortest(uint64_t ieee_mantissa,
+                      int ieee_exponent,
+                      uint64_t* digits,
+                      int* exponent)
+{
+    int e2;
+    uint64_t m2;
+
+    if (ieee_exponent == 0) {
+        e2 = 1 - double_bias - double_mantissa_bits - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = ieee_exponent - double_bias - double_mantissa_bits - 2;
+        m2 = (UINT64_C(1) << double_mantissa_bits) | ieee_mantissa;
+    }
+    const int accept_bounds = (m2 & 1) == 0;
+
+    // The interval of decimals that round to this double is (mm, mp), or
+    // [mm, mp] when `accept_bounds`; all three are scaled by 4.
+    const uint64_t mv = 4 * m2;
+    const int mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int e10;
+    int vm_is_trailing_zeros = 0;
+    int vr_is_trailing_zeros = 0;
+
+    if (e2 >= 0) {
+        const int q = _log10_pow2(e2) - (e2 > 3);
+        const int k = number_pow5_inv_bitcount + _pow5_bits(q) - 1;
+        const int i = -e2 + q + k;
+        e10 = q;
+        vr = _mul_shift(4*m2, number_pow5_inv_split[q], i);
+        vp = _mul_shift(4*m2 + 2, number_pow5_inv_split[q], i);
+        vm = _mul_shift(4*m2 - 1 - mm_shift, number_pow5_inv_split[q], i);
+        if (q <= 21) {
+            if (mv % 5 == 0) {
+                vr_is_trailing_zeros = _multiple_of_power_of_5(mv, q);
+            } else if (accept_bounds) {
+                vm_is_trailing_zeros =
+                    _multiple_of_power_of_5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= _multiple_of_power_of_5(mv + 2, q);
+            }
+        }
+    } else {
+        const int q = _log10_pow5(-e2) - (-e2 > 1);
+        const int i = -e2 - q;
+        const int k = _pow5_bits(i) - number_pow5_bitcount;
+        const int j = q - k;
+        e10 = q + e2;
+        vr = _mul_shift(4*m2, number_pow5_split[i], j);
+        vp = _mul_shift(4*m2 + 2, number_pow5_split[i], j);
+        vm = _mul_shift(4*m2 - 1 - mm_shift, number_pow5_split[i], j);
+        if (q <= 1) {
+            // mv = 4*m2 always has at least two trailing zero bits.
+            vr_is_trailing_zeros = 1;
+            if (accept_bounds) {
+                vm_is_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_is_trailing_zeros = _multiple_of_power_of_2(mv, q);
+        }
+    }
+
+    // Remove digits while the interval still contains more than one
+    // candidate, remembering enough to round the last one correctly.
+    int removed = 0;
+    int last_removed_digit = 0;
+    uint64_t output;
+
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_is_trailing_zeros &= vm % 10 == 0;
+            vr_is_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = (int) (vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_is_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_is_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = (int) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+            last_removed_digit = 4;     // exactly halfway: round to even
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros))
+                       || last_removed_digit >= 5);
+    } else {
+        int round_up = 0;
+        if (vp / 100 > vm / 100) {      // two digits at a time, usually
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+// Writes the decimal digits of `v` (which has `n` of them) to `buf`.
+static void _write_digits(uint64_t v, int n, char* buf)
+{
+    while (n > 0) {
+        buf[--n] = '0' + (char) (v % 10);
+        v /= 10;
+    }
+}
+
+int number_format(double d, char* buf)
+{
+    uint64_t bits;
+    char* w = buf;
+
+    memcpy(&bits, &d, sizeof(d));
+    const int ieee_exponent = (int) ((bits >> double_mantissa_bits) & 0x7ff);
+    const uint64_t ieee_mantissa =
+        bits & ((UINT64_C(1) << double_mantissa_bits) - 1);
+
+    if (ieee_exponent == double_infinite_power) {
+        strcpy(buf, "null");
+        return 4;
+    }
+    if (bits >> 63) {
+        *w++ = '-';
+        d = -d;
+    }
+
+    // Integers of up to 53 bits are printed exactly, without Ryu.
+    if (d < 9007199254740992.0 && d == (double) (uint64_t) d) {
+        const uint64_t v = (uint64_t) d;
+        const int n = _decimal_length(v);
+        _write_digits(v, n, w);
+        w[n] = '\0';
+        return (int) (w + n - buf);
+    }
+
+    uint64_t digits;
+    int exponent;
+    _shortest(ieee_mantissa, ieee_exponent, &digits, &exponent);
+
+    // Lay the digits out as JavaScript does: `point` is the position of the
+    // decimal point relative to the first digit.
+    const int k = _decimal_length(digits);
+    const int point = exponent + k;
+
+    if (k <= point && point <= 21) {            // 1234500
+        _write_digits(digits, k, w);
+        memset(w + k, '0', point - k);
+        w += point;
+    } else if (0 < point && point <= 21) {      // 123.45
+        _write_digits(digits, k, w + 1);
+        memmove(w, w + 1, point);
+        w[point] = '.';
+        w += k + 1;
+    } else if (-6 < point && point <= 0) {      // 0.0012345
+        w[0] = '0';
+        w[1] = '.';
+        memset(w + 2, '0', -point);
+        _write_digits(digits, k, w + 2 - point);
+        w += 2 - point + k;
+    } else {                                    // 1.2345e+67
+        int e = point - 1;
+        _write_digits(digits, k, w + 1);
+        w[0] = w[1];
+        if (k > 1) {
+            w[1] = '.';
+            w += k + 1;
+        } else {
+            w++;
+        }
+        *w++ = 'e';
+        *w++ = e < 0 ? '-' : '+';
+        if (e < 0) {
+            e = -e;
+        }
+        const int n = _decimal_length((uint64_t) e);
+        _write_digits((uint64_t) e, n, w);
+        w += n;
+    }
+
+    *w = '\0';
+    return (int) (w - buf);
+}
@@ -0,0 +1,45 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_NUMBER__
+#define __INCLUDED_LIBJSON_NUMBER__
+
+// Conversions between decimal text and doubles. Unlike strtod and printf,
+// these never depend on the current locale.
+
+typedef enum Number_status Number_status;
+enum Number_status {
+    number_status_success = 0,
+    number_status_invalid,      // no number at the given position
+    number_status_overflow,     // magnitude too large for a double
+    number_status_underflow,    // nonzero, but too small for a double
+};
+
+// Converts the number at the start of [p, end) to the nearest double (ties
+// to even). The syntax is that of a C decimal floating constant with an
+// optional sign: [+-]?digits[.digits]?([eE][+-]?digits)?, where either the
+// integer or the fraction digits may be empty, but not both. On success,
+// stores the value in `*value` and a pointer just past the number in `*endp`.
+Number_status number_parse(const char* p,
+                           const char* end,
+                           double* value,
+                           const char** endp);
+
+// Size of a buffer large enough for any result of number_format, including
+// the terminating nul.
+enum { number_max_format_length = 32 };
+
+// Writes the shortest decimal representation of `d` that reads back as
+// exactly `d` (with ties broken towards the closest digits) to `buf`,
+// followed by a nul. Numbers use exponential notation only outside the range
+// [1e-6, 1e21), as JavaScript does; integers of up to 53 bits take a fast
+// path. Infinities and NaN, which JSON cannot represent, are written as
+// "null". Returns the length of the result.
+int number_format(double d, char* buf);
+
+#endif
@@ -0,0 +1,294 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "number.h"
+#include "munit.h"
+#include <float.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parses all of `s`, which must be a valid number, and returns its value.
+static int parses_to(const char* s, double expected)
+{
+    const char* end = s + strlen(s);
+    const char* endp;
+    double d;
+    return number_parse(s, end, &d, &endp) == number_status_success
+        && endp == end
+        && memcmp(&d, &expected, sizeof(d)) == 0;
+}
+
+static Number_status status_of(const char* s)
+{
+    const char* endp;
+    double d;
+    return number_parse(s, s + strlen(s), &d, &endp);
+}
+
+static void test_simple_numbers()
+{
+    mu_assert(parses_to("0", 0.0));
+    mu_assert(parses_to("-0", -0.0));
+    mu_assert(parses_to("+12", 12.0));
+    mu_assert(parses_to("-3.14E100", -3.14e100));
+    mu_assert(parses_to("1.", 1.0));
+    mu_assert(parses_to("-.5", -0.5));
+    mu_assert(parses_to("0.000001", 1e-6));
+    mu_assert(parses_to("9007199254740993", 9007199254740992.0));
+    mu_assert(parses_to("18446744073709551615", 18446744073709551615.0));
+    mu_assert(parses_to("1e-400000000000", 0.0) == 0);
+}
+
+static void test_boundaries()
+{
+    mu_assert(parses_to("1.7976931348623157e308", 1.7976931348623157e308));
+    mu_assert(parses_to("2.2250738585072014e-308", 2.2250738585072014e-308));
+    mu_assert(parses_to("4.9406564584124654e-324", 4.9406564584124654e-324));
+    mu_assert(parses_to("2.4703282292062328e-324", 4.9406564584124654e-324));
+    mu_assert(status_of("2.4703282292062327e-324") == number_status_underflow);
+    mu_assert(status_of("1.7976931348623159e308") == number_status_overflow);
+    mu_assert(status_of("1e400") == number_status_overflow);
+    mu_assert(status_of("-1e-400") == number_status_underflow);
+    mu_assert(parses_to("0e999999", 0.0));
+}
+
+static void test_long_mantissas()
+{
+    // Halfway between 1 and the next double, plus a tiny bit more.
+    mu_assert(parses_to("1.00000000000000011102230246251565404236316680908203125",
+                        1.0));
+    mu_assert(parses_to("1.00000000000000011102230246251565404236316680908203126",
+                        1.0000000000000002));
+    mu_assert(parses_to("3.141592653589793238462643383279502884197169399375105",
+                        3.141592653589793));
+    mu_assert(parses_to("100000000000000000000000000000000000000000000000000.0",
+                        1e50));
+}
+
+static void test_partial_input()
+{
+    const char s[] = "12e, 1e+x 7.5.3";
+    const char* endp;
+    double d;
+
+    mu_assert(number_parse(s, s + strlen(s), &d, &endp) == 0);
+    mu_assert(d == 12.0 && endp == s + 2);
+    mu_assert(number_parse(s + 5, s + strlen(s), &d, &endp) == 0);
+    mu_assert(d == 1.0 && endp == s + 6);
+    mu_assert(number_parse(s + 10, s + strlen(s), &d, &endp) == 0);
+    mu_assert(d == 7.5 && endp == s + 13);
+
+    // `end` bounds the number even without a terminator.
+    mu_assert(number_parse(s, s + 1, &d, &endp) == 0);
+    mu_assert(d == 1.0 && endp == s + 1);
+
+    mu_assert(status_of("-") == number_status_invalid);
+    mu_assert(status_of("+.") == number_status_invalid);
+    mu_assert(status_of("-Infinity") == number_status_invalid);
+    mu_assert(status_of("e5") == number_status_invalid);
+}
+
+// Compares against strtod on random numbers of every shape.
+static void test_against_strtod()
+{
+    char buf[64];
+    int i, j;
+
+    srand(1);
+    for (i = 0; i < 200000; i++) {
+        char* w = buf;
+        const int digits = 1 + rand() % (i % 3 ? 17 : 30);
+        const int point = rand() % (digits + 1);
+        for (j = 0; j < digits; j++) {
+            if (j == point)
+                *w++ = '.';
+            *w++ = '0' + rand() % 10;
+        }
+        if (rand() % 2)
+            w += sprintf(w, "e%d", rand() % 700 - 350);
+        *w = '\0';
+
+        const double expected = strtod(buf, NULL);
+        if (expected == 0.0 || expected > 1.7976931348623157e308)
+            continue;   // underflow/overflow, checked separately
+        mu_assert(parses_to(buf, expected));
+    }
+}
+
+// Like parses_to, but expects the statuses for zero and infinity.
+static int rounds_to(const char* s, double expected)
+{
+    if (expected == 0.0)
+        return status_of(s) == number_status_underflow;
+    if (expected > 1.7976931348623157e308)
+        return status_of(s) == number_status_overflow;
+    return parses_to(s, expected);
+}
+
+static double from_bits(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// Tests that the exact point halfway between the double with bits `bits`
+// and the next one up rounds to the even one of the two, and that it rounds
+// to the nearer one if a digit far down is changed, as only an exact
+// comparison can tell. The halfway point is written out in full as a long
+// double, where that has the bits to hold it.
+static int rounds_halfway_point(uint64_t bits)
+{
+#if LDBL_MANT_DIG >= 64
+    static char buf[1200];
+    const double d = from_bits(bits);
+    const double next = from_bits(bits + 1);
+    const int e = (bits >> 52 ? (int) (bits >> 52) : 1) - 1023 - 52;
+    const double ulp = from_bits(e >= -1022 ? (uint64_t) (e + 1023) << 52
+                                            : UINT64_C(1) << (e + 1074));
+    const long double halfway = (long double) d + (long double) ulp / 2;
+    const double even = bits & 1 ? next : d;
+    char* last;
+
+    sprintf(buf, "%.1100Le", halfway);
+    if (!rounds_to(buf, even))
+        return 0;
+
+    // The last digit written is a zero past the end of the exact value.
+    last = strchr(buf, 'e') - 1;
+    *last = '1';
+    if (!rounds_to(buf, next))
+        return 0;
+    *last = '0';
+
+    // Subtracting one from the last digit leaves a number just below.
+    for (; *last == '0'; last--)
+        *last = '9';
+    --*(*last == '.' ? last - 1 : last);
+    return rounds_to(buf, d);
+#else
+    (void) bits;
+    return 1;
+#endif
+}
+
+static void test_halfway_points()
+{
+    int i;
+
+    mu_assert(rounds_halfway_point(0));                      // to 2^-1074
+    mu_assert(rounds_halfway_point(1));
+    mu_assert(rounds_halfway_point(UINT64_C(0x000fffffffffffff)));
+    mu_assert(rounds_halfway_point(UINT64_C(0x3ff0000000000000)));  // 1.0
+    mu_assert(rounds_halfway_point(UINT64_C(0x4340000000000000)));  // 2^53
+    mu_assert(rounds_halfway_point(UINT64_C(0x7fefffffffffffff)));  // max
+    srand(1);
+    for (i = 0; i < 2000; i++) {
+        const uint64_t bits = ((uint64_t) rand() << 33 ^ (uint64_t) rand()
+                               << 11 ^ rand()) % UINT64_C(0x7fefffffffffffff);
+        mu_assert(rounds_halfway_point(bits));
+    }
+}
+
+static void test_locale_independence()
+{
+    // Not every system has a locale with a decimal comma; skip if not.
+    if (setlocale(LC_NUMERIC, "de_DE.UTF-8") == NULL
+        && setlocale(LC_NUMERIC, "fr_FR.UTF-8") == NULL)
+        return;
+    mu_assert(parses_to("1.5", 1.5));
+    mu_assert(parses_to("1.000000000000000111022302462515654042363166809082031251",
+                        1.0000000000000002));
+    setlocale(LC_NUMERIC, "C");
+}
+
+// Formats `d` and compares the result with `expected`.
+static int formats_as(double d, const char* expected)
+{
+    char buf[number_max_format_length];
+    const int n = number_format(d, buf);
+    return n == (int) strlen(expected) && strcmp(buf, expected) == 0;
+}
+
+static void test_format_examples()
+{
+    mu_assert(formats_as(0.0, "0"));
+    mu_assert(formats_as(-0.0, "-0"));
+    mu_assert(formats_as(100.0, "100"));
+    mu_assert(formats_as(-12.5, "-12.5"));
+    mu_assert(formats_as(0.1, "0.1"));
+    mu_assert(formats_as(0.3, "0.3"));
+    mu_assert(formats_as(2.0/3.0, "0.6666666666666666"));
+    mu_assert(formats_as(1e-6, "0.000001"));
+    mu_assert(formats_as(1.5e-7, "1.5e-7"));
+    mu_assert(formats_as(1e20, "100000000000000000000"));
+    mu_assert(formats_as(1e21, "1e+21"));
+    mu_assert(formats_as(9007199254740993.0, "9007199254740992"));
+    mu_assert(formats_as(123456789012345678.0, "123456789012345680"));
+    mu_assert(formats_as(5e-324, "5e-324"));
+    mu_assert(formats_as(2.2250738585072014e-308, "2.2250738585072014e-308"));
+    mu_assert(formats_as(1.7976931348623157e308, "1.7976931348623157e+308"));
+    mu_assert(formats_as(1.0/0.0, "null"));
+    mu_assert(formats_as(0.0/0.0, "null"));
+}
+
+// Checks that formatting random doubles yields text which parses back to the
+// same double, with no more significant digits than necessary.
+static void test_format_round_trip()
+{
+    srand(2003);
+    for (int i = 0; i < 100000; i++) {
+        unsigned long long bits = 0;
+        for (int j = 0; j < 4; j++)
+            bits = (bits << 16) ^ (rand() & 0xffff);
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (d != d || d - d != 0.0)
+            continue;   // NaN or infinity
+
+        char buf[number_max_format_length];
+        number_format(d, buf);
+        mu_assert(parses_to(buf, d));
+
+        // Most random bit patterns come out in exponential notation, where
+        // every digit before the 'e' is significant.
+        const char* e = strchr(buf, 'e');
+        if (e == NULL)
+            continue;
+        int digits = 0;
+        for (const char* p = buf; p < e; p++)
+            digits += *p >= '0' && *p <= '9';
+        if (digits > 1) {
+            char shorter[64];
+            sprintf(shorter, "%.*e", digits - 2, d);
+            mu_assert(strtod(shorter, NULL) != d);
+        }
+    }
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_simple_numbers);
+    mu_run_test(test_boundaries);
+    mu_run_test(test_long_mantissas);
+    mu_run_test(test_partial_input);
+    mu_run_test(test_against_strtod);
+    mu_run_test(test_halfway_points);
+    mu_run_test(test_locale_independence);
+    mu_run_test(test_format_examples);
+    mu_run_test(test_format_round_trip);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
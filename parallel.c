@@ -0,0 +1,357 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "parallel.h"
+#include "lexer.h"
+#include "parser.h"
+#include "structural.h"
+#include "utilities.h"
+#include <pthread.h>
+#include <string.h>
+
+// Size of the spans the input is cut into, give or take; there are at least
+// as many spans as threads.
+enum { parallel_span_bytes = 1 << 20 };
+
+// How far past a possible cut brackets are matched to test it.
+enum { parallel_check_bytes = 4096 };
+
+// A run of elements of the top-level array, as far as anyone knows before it
+// has been parsed.
+typedef struct Span Span;
+struct Span {
+    const char* start;      // where the first element seems to begin
+    const char* stop;       // the comma after the last, or the end of input
+    Json_value* elements;   // null if the span did not parse
+};
+
+// The spans, and the threads parsing them.
+typedef struct Job Job;
+struct Job {
+    Span* spans;
+    int n_spans;
+    const char* end;        // of the input
+    int taken;              // number of spans given to threads
+    pthread_mutex_t lock;   // guards `taken`
+};
+
+//
+// +---------+
+// | cutting |
+// +---------+
+//
+
+static int _is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Returns a pointer past the string whose opening quote is at `p`, or `end`
+// if it does not end before `end`.
+static const char* _skip_string(const char* p, const char* end)
+{
+    for (p++; p < end && *p != '"'; p++) {
+        if (*p == '\\') {
+            p++;
+        }
+    }
+    return p < end ? p + 1 : end;
+}
+
+// Tests whether the array or object whose opening bracket is at `p` could be
+// an element of the top-level array, on the assumption that `p` is not
+// within a string. An object must begin as one does, with a key and a colon
+// (which catches most cuts that do lie within strings). Then brackets are
+// matched for a while: within an element nested more deeply, a bracket soon
+// closes what it did not open; only the top-level array itself may be
+// closed, and nothing but space may follow it.
+static int _plausible(const char* p, const char* end)
+{
+    const char* stop = end - p > parallel_check_bytes
+        ? p + parallel_check_bytes : end;
+    const char* q;
+    int depth = 0;
+
+    if (*p == '{') {
+        for (q = p + 1; q < stop && _is_space(*q); q++)
+            ;
+        if (q < stop && *q == '"') {
+            for (q = _skip_string(q, stop); q < stop && _is_space(*q); q++)
+                ;
+            if (q == stop || *q != ':') {
+                return 0;
+            }
+        } else if (q < stop && *q != '}') {
+            return 0;
+        }
+    }
+
+    for (; p < stop; p++) {
+        switch (*p) {
+        case '"':
+            p = _skip_string(p, stop) - 1;
+            break;
+        case '[': case '{':
+            depth++;
+            break;
+        case ']': case '}':
+            if (--depth < 0) {
+                if (*p == '}') {
+                    return 0;
+                }
+                for (p++; p < end && _is_space(*p); p++)
+                    ;
+                return p == end;
+            }
+            break;
+        }
+    }
+    return 1;
+}
+
+// Returns the first position in [from, to) at which an element of the
+// top-level array seems to begin: an `open` bracket preceded by a comma and,
+// before that, by a `close` bracket, with only space between them, that
+// passes _plausible. Sets `*comma`. Returns null if there is none.
+static const char* _find_cut(const char* from,
+                             const char* to,
+                             const char* end,
+                             char open,
+                             char close,
+                             const char** comma)
+{
+    const char* p;
+
+    for (p = from; p < to && (p = memchr(p, ',', to - p)) != NULL; p++) {
+        const char* before = p;
+        const char* after = p + 1;
+
+        while (before > from && _is_space(before[-1])) {
+            before--;
+        }
+        while (after < end && _is_space(*after)) {
+            after++;
+        }
+        if (before > from && before[-1] == close
+            && after < end && *after == open && _plausible(after, end))
+        {
+            *comma = p;
+            return after;
+        }
+    }
+    return NULL;
+}
+
+// Cuts the `length` bytes at `input`, in which the first element of the
+// top-level array begins at `first`, into about `n` spans, filling in their
+// bounds. Returns the number of spans, which is at least one.
+static int _cut(Span* spans,
+                int n,
+                const char* input,
+                size_t length,
+                const char* first,
+                char open,
+                char close)
+{
+    const char* end = input + length;
+    const size_t step = length / n;
+    int count = 1;
+    int i;
+
+    spans[0].start = first;
+    for (i = 1; i < n; i++) {
+        const char* from = input + i * step;
+        const char* to = i == n - 1 ? end : from + step;
+        const char* comma;
+
+        if (from <= spans[count - 1].start) {
+            from = spans[count - 1].start + 1;
+        }
+        if (from >= to) {
+            continue;
+        }
+        const char* cut = _find_cut(from, to, end, open, close, &comma);
+        if (cut != NULL) {
+            spans[count - 1].stop = comma;
+            spans[count++].start = cut;
+        }
+    }
+    spans[count - 1].stop = end;
+    return count;
+}
+
+//
+// +---------+
+// | parsing |
+// +---------+
+//
+
+// Parses span number `k` on the assumption that it begins at an element. The
+// span has parsed if the two-stage parser finds it to be exactly a run of
+// elements, or if the general parser finds the next span to begin where its
+// own elements end.
+static void _parse_span(Job* job, int k)
+{
+    Span* span = &job->spans[k];
+    const int last = k == job->n_spans - 1;
+    const char* limit = last ? NULL : job->spans[k + 1].start;
+    Json_value* elements = NULL;
+    const char* next;
+
+    if (structural_enabled()) {
+        elements = structural_parse_elements(span->start,
+                                             span->stop - span->start,
+                                             !last);
+    }
+    if (elements == NULL) {
+        elements = parallel_parse_elements(
+            span->start, job->end - span->start, limit, &next);
+        if (elements != NULL && next != limit) {
+            json_value_destroy(elements);
+            elements = NULL;
+        }
+    }
+    span->elements = elements;
+}
+
+static void* _work(void* arg)
+{
+    Job* job = (Job*) arg;
+    int k;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        k = job->taken < job->n_spans ? job->taken++ : -1;
+        pthread_mutex_unlock(&job->lock);
+        if (k < 0) {
+            return NULL;
+        }
+        _parse_span(job, k);
+    }
+}
+
+// Joins the elements of the spans into one array, checking that each span
+// really began where the one before it ended, and parsing the input again
+// from there where it did not. Returns null if the input is malformed.
+static Json_value* _join(Job* job)
+{
+    const char* pos = job->spans[0].start;  // where the next element begins
+    Json_value* result;
+    size_t size = 0;
+    int k;
+
+    for (k = 0; k < job->n_spans; k++) {
+        if (job->spans[k].elements) {
+            size += json_value_count_members(job->spans[k].elements);
+        }
+    }
+    result = json_value_new_array(size);
+
+    for (k = 0; k < job->n_spans && pos != NULL; k++) {
+        Span* span = &job->spans[k];
+        const char* limit = k + 1 < job->n_spans ? span[1].start : NULL;
+        Json_value* elements = span->elements;
+
+        span->elements = NULL;
+        if (elements == NULL || span->start != pos) {
+            if (elements != NULL) {
+                json_value_destroy(elements);
+            }
+            elements = parallel_parse_elements(
+                pos, job->end - pos, limit, &pos);
+            if (elements == NULL) {
+                json_value_destroy(result);
+                return NULL;
+            }
+        } else {
+            pos = limit;
+        }
+        json_value_append_elements(result, elements);
+    }
+    return result;
+}
+
+//
+// +------------+
+// | public API |
+// +------------+
+//
+
+Json_value* json_parse_parallel(const char* input,
+                                int n_threads,
+                                Json_parse_error* errorp)
+{
+    const size_t length = strlen(input);
+    Lexer lexer;
+    char open, close;
+    Job job;
+    pthread_t* threads;
+    Json_value* result;
+    int n;
+    int i;
+
+    // The first element shows what the elements look like.
+    lexer_init_validating(&lexer, input, length);
+    if (n_threads < 2 || !lexer_advance(&lexer)
+        || lexer_token(&lexer).type != json_token_type_left_bracket
+        || !lexer_advance(&lexer))
+    {
+        return json_parse_arena(input, NULL, errorp);
+    }
+    switch (lexer_token(&lexer).type) {
+    case json_token_type_left_bracket:
+        open = '[';
+        close = ']';
+        break;
+    case json_token_type_left_curly:
+        open = '{';
+        close = '}';
+        break;
+    default:
+        return json_parse_arena(input, NULL, errorp);
+    }
+
+    n = length / parallel_span_bytes;
+    if (n < n_threads) {
+        n = n_threads;
+    }
+    job.spans = (Span*) emalloc(n * sizeof(Span));
+    job.n_spans = _cut(job.spans, n, input, length,
+                       lexer_token_start(&lexer), open, close);
+    job.end = input + length;
+    job.taken = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    threads = (pthread_t*) emalloc((n_threads - 1) * sizeof(pthread_t));
+    for (i = 0; i < n_threads - 1; i++) {
+        if (pthread_create(&threads[i], NULL, _work, &job) != 0) {
+            JSON_PANIC(("cannot create parser thread"));
+        }
+    }
+    _work(&job);
+    for (i = 0; i < n_threads - 1; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&job.lock);
+
+    result = _join(&job);
+    for (i = 0; i < job.n_spans; i++) {
+        if (job.spans[i].elements) {
+            json_value_destroy(job.spans[i].elements);
+        }
+    }
+    free(job.spans);
+
+    // Errors are found again by the general parser, which reports them
+    // properly.
+    if (result == NULL) {
+        result = json_parse_arena(input, NULL, errorp);
+    }
+    return result;
+}
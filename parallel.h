@@ -0,0 +1,33 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_PARALLEL__
+#define __INCLUDED_LIBJSON_PARALLEL__
+
+// Internal interface between the parser, Json_value and the parallel parser
+// (see json_parse_parallel).
+
+#include "json.h"
+
+// Parses the elements of an array from `text`, which lies within the array
+// (after its opening bracket or after an element), and returns them as an
+// array on the heap. The parse stops before the first element that begins
+// at or after `limit`, setting `*next` to its start; if the array ends
+// first, or `limit` is null, the rest of the `length` bytes must hold its
+// closing bracket and nothing more, and `*next` is set to null. Returns null
+// if the input is malformed.
+Json_value* parallel_parse_elements(const char* text,
+                                    size_t length,
+                                    const char* limit,
+                                    const char** next);
+
+// Moves the elements of the array `from` to the end of `array`, and destroys
+// `from`. Both must be on the heap.
+void json_value_append_elements(Json_value* array, Json_value* from);
+
+#endif
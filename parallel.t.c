@@ -0,0 +1,129 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "str.h"
+#include "structural.h"
+#include "munit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int thread_counts[] = { 1, 2, 3, 8, 32 };
+enum { n_thread_counts = sizeof(thread_counts)/sizeof(thread_counts[0]) };
+
+// Tests that json_parse_parallel gives the same result as json_parse for
+// `input`, or the same error, with each number of threads and with and
+// without the two-stage parser.
+static int parses_like_json_parse(const char* input)
+{
+    Json_parse_error expected_error, error;
+    Json_value* v = json_parse(input, &expected_error);
+    char* expected = v ? json_stringify(v) : NULL;
+    int ok = 1;
+    int i, structural;
+
+    json_value_destroy(v);
+    for (structural = 0; structural < 2; structural++) {
+        structural_set_enabled(structural);
+        for (i = 0; i < n_thread_counts; i++) {
+            v = json_parse_parallel(input, thread_counts[i], &error);
+            if (expected) {
+                char* s = v ? json_stringify(v) : NULL;
+                ok = ok && s && strcmp(s, expected) == 0;
+                free(s);
+            } else {
+                ok = ok && v == NULL && error.code == expected_error.code
+                    && error.line == expected_error.line
+                    && error.column == expected_error.column;
+            }
+            json_value_destroy(v);
+        }
+    }
+    structural_set_enabled(1);
+    free(expected);
+    return ok;
+}
+
+static void test_small()
+{
+    mu_assert(parses_like_json_parse("[]"));
+    mu_assert(parses_like_json_parse("[{}]"));
+    mu_assert(parses_like_json_parse("[{}, {}, {}, {}, {}, {}, {}, {}]"));
+    mu_assert(parses_like_json_parse("[[1], [2, [3]], [], [4]]"));
+    mu_assert(parses_like_json_parse("[1, 2, 3, 4, 5, 6]"));
+    mu_assert(parses_like_json_parse("{\"a\": [{}, {}, {}]}"));
+    mu_assert(parses_like_json_parse("\"x\""));
+
+    // Cuts that look right but lie within strings or nested arrays.
+    mu_assert(parses_like_json_parse(
+        "[{\"a\": \"},{\"}, {\"b\": \"}, {\\\"\"}, {\"c\": [{}, {}, {}]},"
+        " {\"d\": [{\"e\": [{}, {}]}, {}]}, {}, {\"f\": \"]\"}, {}]"));
+
+    // What only the general parser accepts.
+    mu_assert(parses_like_json_parse(
+        "/* c */ [{a: 1}, {'b': 2} // c\n, {\"c\": +3}, {}, {},]"));
+}
+
+static void test_errors()
+{
+    mu_assert(parses_like_json_parse("[{}, {}, {]"));
+    mu_assert(parses_like_json_parse("[{}, {}, {}"));
+    mu_assert(parses_like_json_parse("[{}, {\"a\" 1}, {}, {}]"));
+    mu_assert(parses_like_json_parse("[{}, {}, {}, {}] x"));
+    mu_assert(parses_like_json_parse("[{}, {}, {}, {}]]"));
+    mu_assert(parses_like_json_parse("[{}, {}, \"open, {}, {}]"));
+    mu_assert(parses_like_json_parse("["));
+    mu_assert(parses_like_json_parse(""));
+}
+
+// Appends a record like those of an export, compact or indented.
+static void append_record(Str** s, int i, int indented)
+{
+    char buf[512];
+
+    sprintf(buf, indented
+            ? "%s\n  {\n    \"id\": %d,\n    \"name\": \"user, {%d}\",\n"
+              "    \"items\": [\n      {\"n\": 1},\n      {\"n\": [%d]}\n"
+              "    ]\n  }"
+            : "%s{\"id\": %d, \"name\": \"user }, {%d\", "
+              "\"items\": [{\"n\": 1}, {\"n\": [%d]}], \"t\": \"\\\"\"}",
+            i ? "," : "", i, i, i);
+    str_append_cstr(s, buf);
+}
+
+static void test_records()
+{
+    int indented, i;
+
+    for (indented = 0; indented < 2; indented++) {
+        Str* s = str_create(1 << 16);
+        str_append_cstr(&s, "[");
+        for (i = 0; i < 3000; i++) {
+            append_record(&s, i, indented);
+        }
+        str_append_cstr(&s, "\n]\n");
+        char* input = str_destroy_and_copy(s);
+        mu_assert(parses_like_json_parse(input));
+        free(input);
+    }
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_small);
+    mu_run_test(test_errors);
+    mu_run_test(test_records);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -8,7 +8,12 @@
 
 #include "parser.h"
 #include "json.h"
+#include "borrowed.h"
+#include "intern.h"
+#include "lazy.h"
 #include "lexer.h"
+#include "parallel.h"
+#include "structural.h"
 #include "utilities.h"
 #include <assert.h>
 #include <stdarg.h>
@@ -23,10 +28,59 @@
 //     array    : '[' elements ']'
 //     elements : value | elements ',' value
 
+// The grammar is run by an explicit state machine rather than by recursive
+// descent, so that parsing can stop wherever the input runs out and resume
+// when more arrives (see json_parser_feed). Each state corresponds to a point
+// in the recursive formulation at which the parser inspects the current token.
+typedef enum Parse_state Parse_state;
+enum Parse_state {
+    parse_state_value,          // expecting a value
+    parse_state_array_next,     // expecting ']' or an element
+    parse_state_array_after,    // after an element: an optional ','
+    parse_state_object_next,    // expecting '}' or a key
+    parse_state_object_colon,   // after a key
+    parse_state_object_after,   // after a member: ',' or '}'
+    parse_state_done,           // after the top-level value
+};
+
+// An array or object under construction (or, when reporting events, just
+// being parsed).
+typedef struct Frame Frame;
+struct Frame {
+    Json_value* container;
+    int is_array;
+};
+
+// Nesting depth up to which the parser needs no memory for its stack.
+enum { parser_inline_depth = 32 };
+
 typedef struct Parser Parser;
 struct Parser {
     Lexer* lexer;
+    Json_arena* arena;      // where values are allocated (null: the heap)
+    int insitu;             // do string tokens point into the input?
+    int lazy;               // skip the contents of nested arrays and objects?
     Json_parse_error error;
+    const Json_handler* handler;    // reports events instead, if not null
+    void* context;                  // passed to handler callbacks
+
+    Parse_state state;
+    int advance;            // must the lexer advance before the next step?
+    Json_value* root;       // the result; the bottom of `stack`, if any
+    Frame* stack;           // unfinished arrays and objects, innermost last
+    int depth;
+    int stack_size;
+    char* key;              // key of the member being parsed
+    int key_on_heap;
+    Frame inline_stack[parser_inline_depth];
+};
+
+// Outcome of running the parser over the input it has.
+typedef enum Parse_status Parse_status;
+enum Parse_status {
+    parse_status_success,
+    parse_status_error,
+    parse_status_need_more_input,
 };
 
 // Constructs a new parser error.
@@ -46,6 +100,7 @@ static Json_parse_error_code _translate_lexer_error(Lexer_error le)
 {
     switch (le) {
     case lexer_error_success:
+    case lexer_error_need_more_input:
         return json_parse_error_internal;
     case lexer_error_input_exhausted:
         return json_parse_error_unexpected_end_of_input;
@@ -112,230 +167,1024 @@ static int _expect(Parser* parser, int n, ...)
     return 1;
 }
 
-// Discard next token in sequence; panic if not of the expected type.
-static Token _consume(Parser* parser, Json_token_type expected)
+// Returns the key in `token` in a form that survives advancing the lexer. In
+// situ string keys already do; other keys are interned (see intern.h) or,
+// failing that, copied into the arena or, if there is none, the heap, in
+// which case `*on_heap` is set.
+static char* _take_key(Parser* parser, Token token, int* on_heap)
 {
-    Token token = lexer_token(parser->lexer);
-    lexer_advance(parser->lexer);
-    if (token.type != expected) {
-        JSON_PANIC(("Expected token type %s; got %s.",
-                    token_type_to_string(expected),
-                    token_type_to_string(token.type)));
+    const char* interned;
+
+    *on_heap = 0;
+    if (parser->insitu && token.type == json_token_type_string) {
+        return (char*) token.value.string;
     }
-    return token;
+    if ((interned = intern_key(token.value.string, token.length)) != NULL) {
+        return (char*) interned;
+    }
+    if (parser->arena) {
+        return json_arena_strdup(parser->arena, token.value.string);
+    }
+    *on_heap = 1;
+    return estrdup(token.value.string);
 }
 
-// Similar to _consume, but returns 1 if expected token was eaten, else 0.
-static int _consume_if_match(Parser* parser, Json_token_type expected)
+// Stops the parse at the request of a handler callback. Returns 0.
+static int _cancel(Parser* parser)
 {
-    if (lexer_token(parser->lexer).type == expected) {
-        lexer_advance(parser->lexer);  // discard token
-        return 1;
-    }
+    _set_parse_error(parser, json_parse_error_cancelled);
     return 0;
 }
 
-// This forward declaration is necessary because the parse functions may be
-// mutually recursive.
-static Json_value* _parse_value(Parser* parser);
+// Records the state that follows a complete value, which depends on what
+// (if anything) contains it.
+static void _after_value(Parser* parser)
+{
+    if (parser->depth == 0) {
+        parser->state = parse_state_done;
+    } else if (parser->stack[parser->depth - 1].is_array) {
+        parser->state = parse_state_array_after;
+    } else {
+        parser->state = parse_state_object_after;
+    }
+}
 
-static Json_value* _parse_null(Parser* parser)
+// Adds the new value `v` to the innermost array or object, or makes it the
+// result if there is none. Arrays and objects are added before their
+// contents are parsed, so that a partial result can be destroyed as a whole.
+static void _add_value(Parser* parser, Json_value* v)
 {
-    _consume(parser, json_token_type_null);
-    return json_value_new_null();
+    if (parser->depth == 0) {
+        parser->root = v;
+        return;
+    }
+
+    const Frame* top = &parser->stack[parser->depth - 1];
+    if (top->is_array) {
+        json_value_append(top->container, v);
+    } else if (parser->key_on_heap) {
+        json_value_set_key(top->container, parser->key, v);
+        free(parser->key);
+    } else {
+        json_value_set_key_nocopy(top->container, parser->key, v);
+    }
+    parser->key = NULL;
+    parser->key_on_heap = 0;
 }
 
-static Json_value* _parse_string(Parser* parser)
+// Begins the array or object `v` (null when reporting events), whose
+// contents are parsed next.
+static void _open_container(Parser* parser, Json_value* v, int is_array)
 {
-    return json_value_from_cstr(
-        _consume(parser, json_token_type_string).value.string);
+    if (v) {
+        _add_value(parser, v);
+    }
+    if (parser->depth == parser->stack_size) {
+        const int size = 2 * parser->stack_size;
+        if (parser->stack == parser->inline_stack) {
+            parser->stack = (Frame*) emalloc(size * sizeof(Frame));
+            memcpy(parser->stack, parser->inline_stack,
+                   parser->stack_size * sizeof(Frame));
+        } else {
+            parser->stack = (Frame*) erealloc(parser->stack,
+                                              size * sizeof(Frame));
+        }
+        parser->stack_size = size;
+    }
+    parser->stack[parser->depth].container = v;
+    parser->stack[parser->depth].is_array = is_array;
+    parser->depth++;
+    parser->state = is_array ? parse_state_array_next
+                             : parse_state_object_next;
 }
 
-static Json_value* _parse_number(Parser* parser)
+// Ends the innermost array or object. Returns 0 if a handler cancels the
+// parse.
+static int _close_container(Parser* parser)
 {
-    return json_value_from_double(
-        _consume(parser, json_token_type_number).value.number);
+    const Json_handler* h = parser->handler;
+
+    parser->depth--;
+    _after_value(parser);
+    if (h == NULL) {
+        return 1;
+    }
+    if (parser->stack[parser->depth].is_array) {
+        if (h->end_array && !h->end_array(parser->context)) {
+            return _cancel(parser);
+        }
+    } else if (h->end_object && !h->end_object(parser->context)) {
+        return _cancel(parser);
+    }
+    return 1;
 }
 
-static Json_value* _parse_true(Parser* parser)
+// Reports the value that starts with `token` to the parser's handler.
+// Returns 1 if it did, 0 if the handler cancelled the parse, and -1 if
+// `token` cannot start a value.
+static int _report_value(Parser* parser, Token token)
 {
-    _consume(parser, json_token_type_true);
-    return json_value_from_bool(1);
+    const Json_handler* h = parser->handler;
+    void* c = parser->context;
+    int ok = 1;
+
+    switch (token.type) {
+    case json_token_type_null:
+        ok = h->null == NULL || h->null(c);
+        break;
+    case json_token_type_string:
+        ok = h->string == NULL
+            || h->string(c, token.value.string, token.length);
+        break;
+    case json_token_type_number:
+        ok = h->number == NULL || h->number(c, token.value.number);
+        break;
+    case json_token_type_true:
+    case json_token_type_false:
+        ok = h->boolean == NULL
+            || h->boolean(c, token.type == json_token_type_true);
+        break;
+    case json_token_type_left_bracket:
+        _open_container(parser, NULL, 1);
+        ok = h->start_array == NULL || h->start_array(c);
+        return ok ? 1 : _cancel(parser);
+    case json_token_type_left_curly:
+        _open_container(parser, NULL, 0);
+        ok = h->start_object == NULL || h->start_object(c);
+        return ok ? 1 : _cancel(parser);
+    default:
+        return -1;
+    }
+
+    _after_value(parser);
+    return ok ? 1 : _cancel(parser);
 }
 
-static Json_value* _parse_false(Parser* parser)
+// Adds the array or object of type `type` that begins with the current token
+// as a lazy value, skipping its contents (see json_parse_lazy).
+static int _add_lazy_value(Parser* parser, Json_type type)
 {
-    _consume(parser, json_token_type_false);
-    return json_value_from_bool(0);
+    Lexer* lexer = parser->lexer;
+    const char* text = lexer_position(lexer) - 1;   // at the bracket
+
+    if (!lexer_skip_container(lexer)) {
+        _set_parse_error(parser, _translate_lexer_error(lexer_error(lexer)));
+        return 0;
+    }
+    _add_value(parser, json_value_new_lazy_in(parser->arena, type, text,
+                                              lexer_position(lexer) - text));
+    _after_value(parser);
+    return 1;
 }
 
-static Json_value* _parse_object(Parser* parser)
+static int _unexpected_value(Parser* parser, Json_token_type type);
+
+// Handles the current token at the start of a value.
+static int _parse_value(Parser* parser)
 {
-    lexer_advance(parser->lexer);  // advance past left curly
+    Json_token_type token_type;
+    Token token;
+    Json_value* v;
 
-    Json_value* answer = json_value_new_object(0);
-    char* key = NULL;
+    if (lexer_error(parser->lexer) != lexer_error_success) {
+        _set_parse_error(parser,
+                         _translate_lexer_error(lexer_error(parser->lexer)));
+        return 0;
+    }
 
-    for (;;) {
-        // If the next token is a "}", we're done with this object.
-        if (_consume_if_match(parser, json_token_type_right_curly)) {
-            goto success;
+    parser->advance = 1;
+    token = lexer_token(parser->lexer);
+    token_type = token.type;
+    if (parser->handler) {
+        const int reported = _report_value(parser, token);
+        if (reported >= 0) {
+            return reported;
         }
+        goto error;
+    }
 
+    switch (token_type) {
+    case json_token_type_null:
+        v = json_value_new_null_in(parser->arena);
+        break;
+    case json_token_type_string:
+        if (parser->insitu) {
+            v = json_value_from_cstr_nocopy_in(
+                parser->arena, token.value.string, token.length);
+        } else {
+            v = json_value_from_cstr_in(parser->arena, token.value.string);
+        }
+        break;
+    case json_token_type_number:
+        v = json_value_from_double_in(parser->arena, token.value.number);
+        break;
+    case json_token_type_true:
+        v = json_value_from_bool_in(parser->arena, 1);
+        break;
+    case json_token_type_false:
+        v = json_value_from_bool_in(parser->arena, 0);
+        break;
+    case json_token_type_left_bracket:
+        if (parser->lazy && parser->depth > 0) {
+            return _add_lazy_value(parser, json_type_array);
+        }
+        v = json_value_new_array_in(parser->arena, 0);
+        if (parser->insitu) {
+            json_value_mark_borrowing(v);
+        }
+        _open_container(parser, v, 1);
+        return 1;
+    case json_token_type_left_curly:
+        if (parser->lazy && parser->depth > 0) {
+            return _add_lazy_value(parser, json_type_object);
+        }
+        v = json_value_new_object_in(parser->arena, 0);
+        if (parser->insitu) {
+            json_value_mark_borrowing(v);
+        }
+        _open_container(parser, v, 0);
+        return 1;
+    default:
+        goto error;
+    }
+
+    _add_value(parser, v);
+    _after_value(parser);
+    return 1;
+
+error:
+    return _unexpected_value(parser, token_type);
+}
+
+// Records that a token of type `type` appeared where a value was expected.
+// Returns 0.
+static int _unexpected_value(Parser* parser, Json_token_type type)
+{
+    int i;
+
+    _set_parse_error(parser, json_parse_error_unexpected_input);
+
+    parser->error.expected_token_types[i=0] = json_token_type_null;
+    parser->error.expected_token_types[i++] = json_token_type_string;
+    parser->error.expected_token_types[i++] = json_token_type_number;
+    parser->error.expected_token_types[i++] = json_token_type_true;
+    parser->error.expected_token_types[i++] = json_token_type_false;
+    parser->error.expected_token_types[i++] = json_token_type_left_bracket;
+    parser->error.expected_token_types[i++] = json_token_type_left_curly;
+    parser->error.expected_token_types[i++] = json_token_type_error;
+
+    parser->error.actual_token_type = type;
+    return 0;
+}
+
+// Handles the current token in the given parser state. Returns 0 on error.
+// Note that tokens are matched by type alone, so after a lexical error the
+// previous token is seen again.
+static int _step(Parser* parser)
+{
+    Json_token_type type = lexer_token(parser->lexer).type;
+
+    parser->advance = 0;
+    switch (parser->state) {
+    case parse_state_value:
+        return _parse_value(parser);
+
+    case parse_state_array_next:
+        if (type == json_token_type_right_bracket) {
+            parser->advance = 1;
+            return _close_container(parser);
+        } else {
+            parser->state = parse_state_value;
+        }
+        return 1;
+
+    case parse_state_array_after:
+        // If the next token is a comma, discard it.
+        parser->advance = type == json_token_type_comma;
+        parser->state = parse_state_array_next;
+        return 1;
+
+    case parse_state_object_next:
+        // If the next token is a "}", we're done with this object.
+        if (type == json_token_type_right_curly) {
+            parser->advance = 1;
+            return _close_container(parser);
+        }
         if (!_expect(parser,
                      2,
                      json_token_type_identifier,
                      json_token_type_string))
         {
-            goto error;
+            return 0;
         }
-
-        key = estrdup(lexer_token(parser->lexer).value.string);
-        lexer_advance(parser->lexer);
-
-        if (!_expect(parser, 1, json_token_type_colon)) {
-            goto error;
+        parser->advance = 1;
+        parser->state = parse_state_object_colon;
+        if (parser->handler) {
+            const Json_handler* h = parser->handler;
+            const Token token = lexer_token(parser->lexer);
+            if (h->key && !h->key(parser->context,
+                                  token.value.string,
+                                  token.length))
+            {
+                return _cancel(parser);
+            }
+            return 1;
         }
-        lexer_advance(parser->lexer);
+        parser->key = _take_key(parser,
+                                lexer_token(parser->lexer),
+                                &parser->key_on_heap);
+        return 1;
 
-        Json_value* value = _parse_value(parser);
-        if (value == NULL) {
-            goto error;
+    case parse_state_object_colon:
+        if (!_expect(parser, 1, json_token_type_colon)) {
+            return 0;
         }
-        json_value_set_key(answer, key, value);
-        free(key);
-        key = NULL;
+        parser->advance = 1;
+        parser->state = parse_state_value;
+        return 1;
 
+    case parse_state_object_after:
         // Make sure the next token is either a "," or a "}".
         if (!_expect(parser,
                      2,
                      json_token_type_comma,
                      json_token_type_right_curly))
         {
-            goto error;
+            return 0;
         }
+        parser->advance = type == json_token_type_comma;
+        parser->state = parse_state_object_next;
+        return 1;
 
-        // If the next token is a ",", discard it.
-        _consume_if_match(parser, json_token_type_comma);
+    case parse_state_done:
+        // It's an error for there to be more input.
+        if (lexer_error(parser->lexer) != lexer_error_input_exhausted) {
+            _set_parse_error(parser, json_parse_error_extraneous_input);
+            return 0;
+        }
+        return 1;
     }
+    assert(0);  // not reached
+    return 0;
+}
 
-error:
-    json_value_destroy(answer);
-    answer = NULL;
+// Runs the parser over the lexer's input.
+static Parse_status _run(Parser* parser)
+{
+    for (;;) {
+        if (parser->advance && !lexer_advance(parser->lexer)
+            && lexer_error(parser->lexer) == lexer_error_need_more_input)
+        {
+            return parse_status_need_more_input;
+        }
+        if (!_step(parser)) {
+            return parse_status_error;
+        }
+        if (parser->state == parse_state_done && !parser->advance) {
+            return parse_status_success;
+        }
+    }
+}
 
-success:
-    free(key);
+// Prepares `parser` to parse the input of `lexer`.
+static void _init_parser(Parser* parser,
+                         Lexer* lexer,
+                         Json_arena* arena,
+                         int insitu)
+{
+    parser->lexer = lexer;
+    parser->arena = arena;
+    parser->insitu = insitu;
+    parser->lazy = 0;
+    parser->error = _create_parse_error();
+    parser->handler = NULL;
+    parser->context = NULL;
+    parser->state = parse_state_value;
+    parser->advance = 1;
+    parser->root = NULL;
+    parser->stack = parser->inline_stack;
+    parser->depth = 0;
+    parser->stack_size = parser_inline_depth;
+    parser->key = NULL;
+    parser->key_on_heap = 0;
+}
+
+// Releases the resources held by `parser`, including its lexer and any
+// partial result.
+static void _free_parser(Parser* parser)
+{
+    if (parser->root) {
+        json_value_destroy(parser->root);
+    }
+    if (parser->key_on_heap) {
+        free(parser->key);
+    }
+    if (parser->stack != parser->inline_stack) {
+        free(parser->stack);
+    }
+    lexer_destroy(parser->lexer);
+}
+
+//
+// +------------+
+// | public API |
+// +------------+
+//
 
-    return answer;
+Json_value* json_parse(const char* input, Json_parse_error* errorp)
+{
+    return json_parse_arena(input, NULL, errorp);
 }
 
-static Json_value* _parse_array(Parser* parser)
+// Parses the input of `lexer`, which this function destroys.
+static Json_value* _parse(Lexer* lexer,
+                          Json_arena* arena,
+                          int insitu,
+                          int lazy,
+                          Json_parse_error* errorp)
 {
-    Json_value* answer;
+    Parser parser;
+    Json_value* v = NULL;
 
-    lexer_advance(parser->lexer);  // advance past left bracket
-    answer = json_value_new_array(0);
+    _init_parser(&parser, lexer, arena, insitu);
+    parser.lazy = lazy;
+    if (_run(&parser) == parse_status_success) {
+        v = parser.root;
+        parser.root = NULL;
+    }
+    _free_parser(&parser);
 
-    for (;;) {
-        // If the next token is a "]", we're done with this object.
-        if (_consume_if_match(parser, json_token_type_right_bracket)) {
-            goto success;
-        }
+    // If an error occurred and the caller wants it to be returned via errorp,
+    // set errorp; otherwise, destroy the error object we created.
+
+    if (errorp && v == NULL)
+        *errorp = parser.error;
 
-        Json_value* value = _parse_value(parser);
-        if (value == NULL) {
-            goto error;
+    return v;
+}
+
+Json_value* json_parse_arena(const char* input,
+                             Json_arena* arena,
+                             Json_parse_error* errorp)
+{
+    return json_parse_length(input, strlen(input), arena, errorp);
+}
+
+Json_value* json_parse_length(const char* input,
+                              size_t length,
+                              Json_arena* arena,
+                              Json_parse_error* errorp)
+{
+    return _parse(lexer_create_span(input, length), arena, 0, 0, errorp);
+}
+
+Json_value* json_parse_two_stage(const char* input,
+                                 size_t length,
+                                 Json_arena* arena,
+                                 Json_parse_error* errorp)
+{
+    // Anything but strict input (and every error) is left to the general
+    // parser.
+    if (structural_enabled()) {
+        Json_value* v = structural_parse(input, length, arena);
+        if (v) {
+            return v;
         }
-        json_value_append(answer, value);
+    }
+    return json_parse_length(input, length, arena, errorp);
+}
 
-        // If the next token is a comma, discard it.
-        _consume_if_match(parser, json_token_type_comma);
+Json_value* json_parse_insitu(char* buffer,
+                              Json_arena* arena,
+                              Json_parse_error* errorp)
+{
+    return _parse(lexer_create_insitu(buffer), arena, 1, 0, errorp);
+}
+
+Json_value* json_parse_lazy(const char* input,
+                            Json_arena* arena,
+                            Json_parse_error* errorp)
+{
+    return _parse(lexer_create(input), arena, 0, 1, errorp);
+}
+
+Json_value* lazy_parse_container(const char* text,
+                                 size_t length,
+                                 Json_arena* arena)
+{
+    return _parse(lexer_create_span(text, length), arena, 0, 1, NULL);
+}
+
+Json_value* parallel_parse_elements(const char* text,
+                                    size_t length,
+                                    const char* limit,
+                                    const char** next)
+{
+    Parser parser;
+    Json_value* v = NULL;
+    int ok;
+
+    _init_parser(&parser, lexer_create_span(text, length), NULL, 0);
+    _open_container(&parser, json_value_new_array(0), 1);
+    *next = NULL;
+    for (;;) {
+        if (parser.advance) {
+            lexer_advance(parser.lexer);
+        }
+        if (limit && parser.depth == 1
+            && parser.state == parse_state_array_next
+            && lexer_error(parser.lexer) == lexer_error_success
+            && lexer_token_start(parser.lexer) >= limit)
+        {
+            *next = lexer_token_start(parser.lexer);
+            ok = 1;
+            break;
+        }
+        if (!_step(&parser)) {
+            ok = 0;
+            break;
+        }
+        if (parser.state == parse_state_done && !parser.advance) {
+            ok = 1;
+            break;
+        }
+    }
+    if (ok) {
+        v = parser.root;
+        parser.root = NULL;
     }
+    _free_parser(&parser);
+    return v;
+}
 
-error:
-    json_value_destroy(answer);
-    answer = NULL;
+int json_parse_events(const char* input,
+                      const Json_handler* handler,
+                      void* context,
+                      Json_parse_error* errorp)
+{
+    Parser parser;
+    int ok;
+
+    _init_parser(&parser, lexer_create(input), NULL, 0);
+    parser.handler = handler;
+    parser.context = context;
+    ok = _run(&parser) == parse_status_success;
+    _free_parser(&parser);
 
-success:
-    return answer;
+    if (errorp && !ok)
+        *errorp = parser.error;
+
+    return ok;
 }
 
-static Json_value* _parse_value(Parser* parser)
+//
+// +-------------------+
+// | push parser       |
+// +-------------------+
+//
+
+struct Json_parser {
+    Parser parser;
+    Parse_status status;
+    char* buffer;           // input not yet consumed by the lexer
+    size_t length;
+    size_t size;
+    int held_cr;            // was the last chunk's trailing '\r' held back?
+};
+
+Json_parser* json_parser_create(Json_arena* arena)
 {
-    Json_token_type token_type;
-    int i;
+    Json_parser* p = (Json_parser*) emalloc(sizeof(Json_parser));
+    _init_parser(&p->parser, lexer_create_incremental(), arena, 0);
+    p->status = parse_status_need_more_input;
+    p->size = 256;
+    p->buffer = (char*) emalloc(p->size);
+    p->length = 0;
+    p->held_cr = 0;
+    p->buffer[0] = '\0';
+    lexer_set_window(p->parser.lexer, p->buffer, 0, 0);
+    return p;
+}
 
-    if (lexer_error(parser->lexer) != lexer_error_success) {
-        _set_parse_error(parser,
-                         _translate_lexer_error(lexer_error(parser->lexer)));
-        return NULL;
+void json_parser_destroy(Json_parser* p)
+{
+    if (!p) return;
+
+    _free_parser(&p->parser);
+    free(p->buffer);
+    free(p);
+}
+
+// Replaces the consumed part of the buffer with `len` bytes of new input and
+// lets the parser run over the result.
+static void _resume(Json_parser* p, const char* buf, size_t len, int final)
+{
+    Lexer* lexer = p->parser.lexer;
+
+    if (p->status != parse_status_need_more_input) {
+        return;
     }
 
-    token_type = lexer_token(parser->lexer).type;
-    switch (token_type) {
-    case json_token_type_null:          return _parse_null(parser);
-    case json_token_type_string:        return _parse_string(parser);
-    case json_token_type_number:        return _parse_number(parser);
-    case json_token_type_true:          return _parse_true(parser);
-    case json_token_type_false:         return _parse_false(parser);
-    case json_token_type_left_bracket:  return _parse_array(parser);
-    case json_token_type_left_curly:    return _parse_object(parser);
-    default:                            break; // error
+    // Keep the unconsumed input, then append the new. A token that spans
+    // many chunks is moved only once, as it is left at the start.
+    const size_t consumed = lexer_position(lexer) - p->buffer;
+    if (consumed > 0) {
+        memmove(p->buffer, p->buffer + consumed, p->length - consumed);
+        p->length -= consumed;
+    }
+    const size_t needed = p->length + p->held_cr + len + 1;
+    if (needed > p->size) {
+        p->size = egrow(p->size, needed);
+        p->buffer = (char*) erealloc(p->buffer, p->size);
     }
+    if (p->held_cr) {
+        p->buffer[p->length++] = '\r';
+        p->held_cr = 0;
+    }
+    memcpy(p->buffer + p->length, buf, len);
+    p->length += len;
 
-    _set_parse_error(parser, json_parse_error_unexpected_input);
+    // A CR might be the first half of a CRLF, so hold it back until the
+    // next chunk shows whether it is.
+    if (!final && p->length > 0 && p->buffer[p->length - 1] == '\r') {
+        p->length--;
+        p->held_cr = 1;
+    }
+    p->buffer[p->length] = '\0';
 
-    parser->error.expected_token_types[i=0] = json_token_type_null;
-    parser->error.expected_token_types[i++] = json_token_type_string;
-    parser->error.expected_token_types[i++] = json_token_type_number;
-    parser->error.expected_token_types[i++] = json_token_type_true;
-    parser->error.expected_token_types[i++] = json_token_type_false;
-    parser->error.expected_token_types[i++] = json_token_type_left_bracket;
-    parser->error.expected_token_types[i++] = json_token_type_left_curly;
-    parser->error.expected_token_types[i++] = json_token_type_error;
+    lexer_set_window(lexer, p->buffer, p->length, final);
+    p->status = _run(&p->parser);
+}
+
+int json_parser_feed(Json_parser* p, const char* buf, size_t len)
+{
+    _resume(p, buf, len, 0);
+    return p->status != parse_status_error;
+}
 
-    parser->error.actual_token_type = token_type;
-    return NULL;
+Json_value* json_parser_finish(Json_parser* p, Json_parse_error* errorp)
+{
+    Json_value* v = NULL;
+
+    _resume(p, "", 0, 1);
+    if (p->status == parse_status_success) {
+        v = p->parser.root;
+        p->parser.root = NULL;
+    } else if (errorp) {
+        *errorp = p->parser.error;
+    }
+    return v;
 }
 
 //
-// +------------+
-// | public API |
-// +------------+
+// +--------------------------+
+// | validation and minifying |
+// +--------------------------+
 //
 
-Json_value* json_parse(const char* input, Json_parse_error* errorp)
+// Writes the `length` bytes at `s`, the text between the quotes of a string
+// token, as a strict JSON string. Escape sequences are kept, except for \',
+// which JSON lacks, and control characters are escaped.
+static void _write_strict_string(Json_sink* sink,
+                                 const char* s,
+                                 size_t length)
 {
-    Parser parser;
-    Json_value* v;
+    static const char hex[] = "0123456789abcdef";
+    const char* end = s + length;
+    const char* run = s;
+    const char* p;
+    const char* esc;
+    char u[6] = { '\\', 'u', '0', '0' };
 
-    parser.lexer = lexer_create(input);
-    parser.error = _create_parse_error();
+    json_sink_put(sink, '"');
+    for (p = s; p < end; p++) {
+        switch (*p) {
+        case '\\':
+            if (p[1] == '\'') {
+                json_sink_write(sink, run, p - run);
+                run = ++p;
+            } else {
+                p++;
+            }
+            continue;
+        case '"':  esc = "\\\""; break;     // only within single quotes
+        case '\b': esc = "\\b"; break;
+        case '\f': esc = "\\f"; break;
+        case '\n': esc = "\\n"; break;
+        case '\r': esc = "\\r"; break;
+        case '\t': esc = "\\t"; break;
+        default:
+            if ((unsigned char) *p < 0x20) {
+                u[4] = hex[*p >> 4];
+                u[5] = hex[*p & 0xf];
+                json_sink_write(sink, run, p - run);
+                json_sink_write(sink, u, 6);
+                run = p + 1;
+            }
+            continue;
+        }
+        json_sink_write(sink, run, p - run);
+        json_sink_write(sink, esc, 2);
+        run = p + 1;
+    }
+    json_sink_write(sink, run, p - run);
+    json_sink_put(sink, '"');
+}
 
-    lexer_advance(parser.lexer);
-    v = _parse_value(&parser);
+// Writes the number text from `p` to `end` as a strict JSON number, without
+// the leading plus sign, extra leading zeros and bare decimal point that the
+// lexer accepts, and with a zero before a decimal point that lacks one. The
+// digits, and so the value, are unchanged.
+static void _write_strict_number(Json_sink* sink,
+                                 const char* p,
+                                 const char* end)
+{
+    if (*p == '+') {
+        p++;
+    } else if (*p == '-') {
+        json_sink_put(sink, *p++);
+    }
+    while (p + 1 < end && p[0] == '0' && p[1] >= '0' && p[1] <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        json_sink_put(sink, '0');
+    }
+    const char* q = (const char*) memchr(p, '.', end - p);
+    if (q && (q + 1 == end || q[1] < '0' || q[1] > '9')) {
+        json_sink_write(sink, p, q - p);        // drop the bare '.'
+        p = q + 1;
+    }
+    json_sink_write(sink, p, end - p);
+}
+
+// Writes the current token of `lexer`, a scalar or a key, to `sink` (see
+// json_minify).
+static void _write_token(Json_sink* sink, Lexer* lexer, int strict)
+{
+    const Token token = lexer_token(lexer);
+    const char* start = lexer_token_start(lexer);
 
-    // If the parse succeeded, it's an error for there to be more input.
-    if (v && lexer_error(parser.lexer) != lexer_error_input_exhausted) {
-        _set_parse_error(&parser, json_parse_error_extraneous_input);
-        json_value_destroy(v);
-        v = NULL;
+    switch (token.type) {
+    case json_token_type_null:
+        json_sink_write(sink, "null", 4);
+        break;
+    case json_token_type_true:
+        json_sink_write(sink, "true", 4);
+        break;
+    case json_token_type_false:
+        json_sink_write(sink, "false", 5);
+        break;
+    case json_token_type_string:
+        if (strict) {
+            _write_strict_string(sink, token.value.string, token.length);
+            break;
+        }
+        json_sink_write(sink, start, lexer_position(lexer) - start);
+        break;
+    case json_token_type_identifier:
+        if (strict) {
+            json_sink_put(sink, '"');
+            json_sink_write(sink, token.value.string, token.length);
+            json_sink_put(sink, '"');
+            break;
+        }
+        json_sink_write(sink, start, lexer_position(lexer) - start);
+        break;
+    default:    // numbers
+        if (strict) {
+            _write_strict_number(sink, start, lexer_position(lexer));
+            break;
+        }
+        json_sink_write(sink, start, lexer_position(lexer) - start);
+        break;
     }
+}
 
-    lexer_destroy(parser.lexer);
+// Runs the grammar as _step does, but over a validating lexer and with a
+// stack of just one bit per array or object, in `is_array`. Tokens that are
+// expected are matched directly, with _expect only reporting errors; since
+// _expect leaves behind the types it tried even when it succeeds, which a
+// later error reports, so does EXPECTED. If `sink` is not null, the input is
+// minified to it as it is checked (see json_minify).
+static int _validate(Parser* parser,
+                     unsigned char* is_array,
+                     Json_sink* sink,
+                     int flags)
+{
+    Json_token_type* expected = parser->error.expected_token_types;
+    const int strict = flags & json_minify_strict;
+    Lexer* lexer = parser->lexer;
+    Parse_state state = parse_state_value;
+    Json_token_type type;
+    int depth = 0;
+    int comma = 0;      // must a comma be written before the next value?
 
-    // If an error occurred and the caller wants it to be returned via errorp,
-    // set errorp; otherwise, destroy the error object we created.
+// Sets `state` to follow a complete value, as _after_value does.
+#define AFTER_VALUE() do {                                              \
+        comma = 1;                                                      \
+        if (depth == 0) {                                               \
+            state = parse_state_done;                                   \
+        } else if (is_array[(depth - 1) / 8] & (1 << (depth - 1) % 8)) { \
+            state = parse_state_array_after;                            \
+        } else {                                                        \
+            state = parse_state_object_after;                           \
+        }                                                               \
+    } while (0)
 
-    if (errorp && v == NULL)
+// Leaves `type` as the only expected token type, or none if it is the error
+// type.
+#define EXPECTED(type) do {                                             \
+        expected[0] = (type);                                           \
+        expected[1] = json_token_type_error;                            \
+    } while (0)
+
+    lexer_advance(lexer);
+    for (;;) {
+        type = lexer_token(lexer).type;
+        switch (state) {
+        case parse_state_value:
+            if (lexer_error(lexer) != lexer_error_success) {
+                _set_parse_error(parser,
+                                 _translate_lexer_error(lexer_error(lexer)));
+                return 0;
+            }
+            switch (type) {
+            case json_token_type_null:
+            case json_token_type_string:
+            case json_token_type_number:
+            case json_token_type_true:
+            case json_token_type_false:
+                if (sink) {
+                    _write_token(sink, lexer, strict);
+                }
+                AFTER_VALUE();
+                break;
+            case json_token_type_left_bracket:
+            case json_token_type_left_curly:
+                if (depth == json_validate_max_depth) {
+                    _set_parse_error(parser,
+                                     json_parse_error_nesting_too_deep);
+                    return 0;
+                }
+                if (sink) {
+                    json_sink_put(sink, type == json_token_type_left_bracket
+                                            ? '[' : '{');
+                }
+                comma = 0;
+                if (type == json_token_type_left_bracket) {
+                    is_array[depth / 8] |= 1 << depth % 8;
+                    state = parse_state_array_next;
+                } else {
+                    is_array[depth / 8] &= ~(1 << depth % 8);
+                    state = parse_state_object_next;
+                }
+                depth++;
+                break;
+            default:
+                return _unexpected_value(parser, type);
+            }
+            lexer_advance(lexer);
+            break;
+
+        case parse_state_array_next:
+            if (type == json_token_type_right_bracket) {
+                if (sink) {
+                    json_sink_put(sink, ']');
+                }
+                depth--;
+                AFTER_VALUE();
+                lexer_advance(lexer);
+            } else {
+                if (sink && comma) {
+                    json_sink_put(sink, ',');
+                }
+                state = parse_state_value;
+            }
+            break;
+
+        case parse_state_array_after:
+            state = parse_state_array_next;
+            if (type == json_token_type_comma) {
+                lexer_advance(lexer);
+            }
+            break;
+
+        case parse_state_object_next:
+            if (type == json_token_type_right_curly) {
+                if (sink) {
+                    json_sink_put(sink, '}');
+                }
+                depth--;
+                AFTER_VALUE();
+                lexer_advance(lexer);
+                break;
+            }
+            if (type == json_token_type_identifier) {
+                EXPECTED(json_token_type_error);
+            } else if (type == json_token_type_string) {
+                EXPECTED(json_token_type_identifier);
+            } else if (!_expect(parser,
+                                2,
+                                json_token_type_identifier,
+                                json_token_type_string))
+            {
+                return 0;
+            }
+            if (sink) {
+                if (comma) {
+                    json_sink_put(sink, ',');
+                }
+                _write_token(sink, lexer, strict);
+            }
+            state = parse_state_object_colon;
+            lexer_advance(lexer);
+            break;
+
+        case parse_state_object_colon:
+            if (type == json_token_type_colon) {
+                EXPECTED(json_token_type_error);
+            } else if (!_expect(parser, 1, json_token_type_colon)) {
+                return 0;
+            }
+            if (sink) {
+                json_sink_put(sink, ':');
+            }
+            state = parse_state_value;
+            lexer_advance(lexer);
+            break;
+
+        case parse_state_object_after:
+            if (type == json_token_type_comma) {
+                EXPECTED(json_token_type_error);
+                state = parse_state_object_next;
+                lexer_advance(lexer);
+            } else if (type == json_token_type_right_curly) {
+                EXPECTED(json_token_type_comma);
+                state = parse_state_object_next;
+            } else if (!_expect(parser,
+                                2,
+                                json_token_type_comma,
+                                json_token_type_right_curly))
+            {
+                return 0;
+            }
+            break;
+
+        case parse_state_done:
+            // It's an error for there to be more input.
+            if (lexer_error(lexer) != lexer_error_input_exhausted) {
+                _set_parse_error(parser, json_parse_error_extraneous_input);
+                return 0;
+            }
+            return 1;
+        }
+    }
+
+#undef AFTER_VALUE
+#undef EXPECTED
+}
+
+int json_validate(const char* input, size_t length, Json_parse_error* errorp)
+{
+    unsigned char is_array[json_validate_max_depth / 8];
+    Lexer lexer;
+    Parser parser;
+    int ok;
+
+    lexer_init_validating(&lexer, input, length);
+    _init_parser(&parser, &lexer, NULL, 0);
+    ok = _validate(&parser, is_array, NULL, 0);
+
+    if (errorp && !ok)
         *errorp = parser.error;
 
-    return v;
+    return ok;
+}
+
+int json_minify(const char* input,
+                Json_sink* sink,
+                int flags,
+                Json_parse_error* errorp)
+{
+    unsigned char is_array[json_validate_max_depth / 8];
+    Lexer lexer;
+    Parser parser;
+    int ok;
+
+    lexer_init_validating(&lexer, input, strlen(input));
+    _init_parser(&parser, &lexer, NULL, 0);
+    ok = _validate(&parser, is_array, sink, flags);
+
+    if (errorp && !ok)
+        *errorp = parser.error;
+
+    return json_sink_flush(sink) == 0 && ok;
 }
 
 void json_parse_error_print(FILE* fp, const Json_parse_error e)
 {
-    fprintf(fp, "%s at line %d, column %d",
+    fprintf(fp, "%s at line %zu, column %zu",
             json_parse_error_code_to_string(e.code),
             e.line + 1, e.column);
 
@@ -375,6 +1224,16 @@ const char* json_parse_error_code_to_string(Json_parse_error_code e)
         return "invalid number";
     case json_parse_error_extraneous_input:
         return "extraneous input";
+    case json_parse_error_cancelled:
+        return "cancelled";
+    case json_parse_error_nesting_too_deep:
+        return "nesting too deep";
+    case json_parse_error_io:
+        return "cannot read input";
+    case json_parse_error_invalid_cbor:
+        return "invalid or unsupported CBOR";
+    case json_parse_error_invalid_image:
+        return "invalid tape image";
     }
     JSON_PANIC(("invalid parse error code: %d", e));
     return 0;
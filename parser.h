@@ -24,6 +24,11 @@ enum Json_parse_error_code {
     json_parse_error_runaway_comment,
     json_parse_error_invalid_number,
     json_parse_error_extraneous_input,
+    json_parse_error_cancelled,     // by a Json_handler callback
+    json_parse_error_nesting_too_deep,  // only from json_validate
+    json_parse_error_io,    // only from json_parse_file and _fd; see errno
+    json_parse_error_invalid_cbor,  // only from the CBOR decoders (cbor.h)
+    json_parse_error_invalid_image, // only from json_tape_map and _from_image
 };
 
 enum { json_max_expected_tokens = 10 };
@@ -31,8 +36,8 @@ enum { json_max_expected_tokens = 10 };
 typedef struct Json_parse_error Json_parse_error;
 struct Json_parse_error {
     Json_parse_error_code code; // describes the error
-    int line;                   // line on which error was encountered
-    int column;                 // column within the line of the error
+    size_t line;                // line on which error was encountered
+    size_t column;              // column within the line of the error
 
     // Array of tokens we were expecting to see, but didn't. Terminated by an
     // instance of json_token_type_error (see lexer.h).
@@ -46,6 +51,170 @@ struct Json_parse_error {
 // Parses a JSON input string, returning a Json_value or NULL on error.
 Json_value* json_parse(const char* input, Json_parse_error* errorp);
 
+// Like json_parse, but every value, string, key and table of the result is
+// allocated from `arena` (or the heap, if `arena` is null). The result is
+// released by resetting or destroying the arena, not by json_value_destroy.
+// Memory used by a failed parse is likewise reclaimed with the arena.
+Json_value* json_parse_arena(const char* input,
+                             Json_arena* arena,
+                             Json_parse_error* errorp);
+
+// Like json_parse_arena, but parses the `length` bytes at `input`, which need
+// not be followed by a nul. A nul among them does not end the input, so
+// between tokens it is an error, as it is for json_parser_feed.
+Json_value* json_parse_length(const char* input,
+                              size_t length,
+                              Json_arena* arena,
+                              Json_parse_error* errorp);
+
+// Like json_parse_length, but tries a faster parser for strict JSON first
+// (see structural.h), for callers whose input is strict. Other input gives
+// the same result, but costs more: it is parsed again from the start once
+// the first byte that is not strict JSON is reached, which can take up to
+// twice as long as json_parse_length.
+Json_value* json_parse_two_stage(const char* input,
+                                 size_t length,
+                                 Json_arena* arena,
+                                 Json_parse_error* errorp);
+
+// Parses the file at `path`, or what remains of the open file `fd` from its
+// current offset, as json_parse_length would. A regular file is mapped into
+// memory read-only rather than read, so that even one of several gigabytes
+// is never copied onto the heap, and unmapped before returning (the result
+// holds copies of its strings); anything else, such as a pipe, is read and
+// parsed a piece at a time (see json_parser_feed). Values are allocated from
+// `arena`, or the heap if `arena` is null. If the file cannot be opened or
+// read, the error is json_parse_error_io, and errno says why. `fd` is not
+// closed, but is left at the end of the file.
+Json_value* json_parse_file(const char* path,
+                            Json_arena* arena,
+                            Json_parse_error* errorp);
+Json_value* json_parse_fd(int fd, Json_arena* arena, Json_parse_error* errorp);
+
+// Parses `buffer` destructively: strings are unescaped in place, and string
+// values and quoted keys of the result point into `buffer` instead of being
+// copied, so `buffer` must outlive the result. Values are allocated from
+// `arena`, or the heap if `arena` is null. `buffer` is modified even if the
+// parse fails.
+Json_value* json_parse_insitu(char* buffer,
+                              Json_arena* arena,
+                              Json_parse_error* errorp);
+
+// Parses `input` lazily, for callers that need only a few parts of a large
+// document. The top-level array or object is parsed at once, but the
+// arrays and objects within it are only delimited, by matching brackets, and
+// keep their text until their contents are first needed by an accessor or
+// iterator; each is then parsed the same way, one level at a time. `input`
+// must therefore outlive the result. Values are allocated from `arena`, or
+// the heap if `arena` is null.
+//
+// Syntax errors are reported only for the top level and for unbalanced
+// brackets, strings and comments; an array or object whose text turns out
+// to be malformed is left empty (see json_value_is_malformed). Because
+// reading a lazy value modifies it, the result must not be read by several
+// threads at once.
+Json_value* json_parse_lazy(const char* input,
+                            Json_arena* arena,
+                            Json_parse_error* errorp);
+
+// Parses `input`, typically one huge array of records, on `n_threads` threads
+// (counting the calling one). The top-level array is cut where elements
+// seem to begin, judging by the first, and the spans between the cuts are
+// parsed at the same time, each into an array of its own; the arrays are
+// then joined into the result, which is on the heap. A cut may turn out not
+// to lie between two elements after all (say, within a string or a nested
+// array), in which case the spans around it are parsed again, one after
+// another, on the calling thread; either way the result is the same as
+// json_parse's. Input whose top level is not an array of arrays or objects
+// is simply parsed by json_parse, and so, once the parallel parse fails, is
+// input that is malformed, so that its error is reported as usual.
+Json_value* json_parse_parallel(const char* input,
+                                int n_threads,
+                                Json_parse_error* errorp);
+
+// Event-driven parsing. Instead of building a Json_value, the parser calls
+// the handler's callbacks as it meets each part of the input, in document
+// order; null callbacks are skipped. Strings (and keys) are passed as a
+// nul-terminated pointer and length that are valid only during the call.
+// Each callback returns nonzero to continue or zero to stop the parse, which
+// then fails with json_parse_error_cancelled. Events are reported as soon as
+// their tokens are read, so a document that turns out to be invalid may have
+// produced events before the error is found.
+typedef struct Json_handler Json_handler;
+struct Json_handler {
+    int (*start_object)(void* context);
+    int (*end_object)(void* context);
+    int (*start_array)(void* context);
+    int (*end_array)(void* context);
+    int (*key)(void* context, const char* key, size_t length);
+    int (*string)(void* context, const char* s, size_t length);
+    int (*number)(void* context, double n);
+    int (*boolean)(void* context, int b);
+    int (*null)(void* context);
+};
+
+// Parses `input`, reporting its contents to `handler` with `context`.
+// Nothing is allocated beyond the lexer and its token buffer, unless arrays
+// and objects nest more than a few dozen deep. Returns 1 on success and 0 on
+// error.
+int json_parse_events(const char* input,
+                      const Json_handler* handler,
+                      void* context,
+                      Json_parse_error* errorp);
+
+// Checks that the `length` bytes at `input`, which need not be followed by a
+// nul, are a document that json_parse would accept, reporting the same error
+// if not. Nothing is copied or built, and no memory is allocated: arrays and
+// objects may therefore nest at most json_validate_max_depth deep, beyond
+// which the error is json_parse_error_nesting_too_deep. As the parser does
+// not support `\u` escapes yet, they are reported as illegal. Returns 1 if
+// the document is valid and 0 if not.
+enum { json_validate_max_depth = 4096 };
+int json_validate(const char* input, size_t length, Json_parse_error* errorp);
+
+// Writes `input` to `sink` without its whitespace and comments, copying each
+// token as it is read, so that no memory is needed beyond the sink's buffer.
+// Keywords are written in lowercase, and commas that the parser allows to be
+// left out are put in and trailing ones dropped. Numbers, strings and keys
+// are copied byte for byte, unless `flags` includes json_minify_strict,
+// which rewrites the forms that strict JSON lacks: single-quoted strings,
+// line breaks and other control characters within strings (the rest as
+// \u00XX), identifier keys, and numbers with a leading plus sign or zeros
+// or a bare decimal point (keeping their digits). The input is checked as by
+// json_validate, so the same limits apply, but what was written before an
+// error is found is left in the sink. Flushes the sink. Returns 1 on success
+// and 0 if the input is invalid, setting *errorp, or if the sink fails (see
+// json_sink_flush).
+enum { json_minify_strict = 1 };
+int json_minify(const char* input,
+                Json_sink* sink,
+                int flags,
+                Json_parse_error* errorp);
+
+// Incremental parsing, for input that arrives in pieces (say, from a
+// socket). Create a parser, feed it the pieces in order as they arrive, then
+// call json_parser_finish once at the end of the input to obtain the result.
+// Only the unparsed tail of the input is buffered, so tokens may be split
+// anywhere. The result is the same as json_parse would give for all of the
+// input, except that a nul byte is an error rather than the end of input.
+typedef struct Json_parser Json_parser;
+
+// Creates a parser whose result is allocated from `arena`, or the heap if
+// `arena` is null (see json_parse_arena).
+Json_parser* json_parser_create(Json_arena* arena);
+
+// Releases the parser, along with any partial result.
+void json_parser_destroy(Json_parser* p);
+
+// Parses the next `len` bytes of input at `buf`. Returns 0 if the input is
+// known to be invalid, in which case further input is ignored and the error
+// is reported by json_parser_finish; otherwise returns 1.
+int json_parser_feed(Json_parser* p, const char* buf, size_t len);
+
+// Ends the input and returns the parsed value, which belongs to the caller,
+// or NULL on error.
+Json_value* json_parser_finish(Json_parser* p, Json_parse_error* errorp);
+
 void json_parse_error_print(FILE* fp, const Json_parse_error e);
 const char* json_parse_error_code_to_string(Json_parse_error_code e);
 
@@ -0,0 +1,782 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int points_into(const char* p, const char* buf, size_t n)
+{
+    return p >= buf && p < buf + n;
+}
+
+static void test_insitu_strings()
+{
+    char buf[] = "[\"plain\", \"esc\\\"aped\\n\", 'single', \"\"]";
+    Json_value* v = json_parse_insitu(buf, NULL, NULL);
+    mu_assert(v != NULL);
+
+    Json_iterator* i = json_iterator_create(v);
+    const Json_value* s = json_iterator_curr_value(i);
+    mu_assert(strcmp(json_value_get_cstr(s), "plain") == 0);
+    mu_assert(json_value_get_cstr_length(s) == 5);
+    mu_assert(points_into(json_value_get_cstr(s), buf, sizeof(buf)));
+
+    json_iterator_advance(i);
+    s = json_iterator_curr_value(i);
+    mu_assert(strcmp(json_value_get_cstr(s), "esc\"aped\n") == 0);
+    mu_assert(json_value_get_cstr_length(s) == 9);
+    mu_assert(points_into(json_value_get_cstr(s), buf, sizeof(buf)));
+
+    json_iterator_advance(i);
+    s = json_iterator_curr_value(i);
+    mu_assert(strcmp(json_value_get_cstr(s), "single") == 0);
+
+    json_iterator_advance(i);
+    s = json_iterator_curr_value(i);
+    mu_assert(json_value_get_cstr_length(s) == 0);
+    json_iterator_destroy(i);
+
+    json_value_destroy(v);
+}
+
+static void test_insitu_keys()
+{
+    char buf[] = "{ \"k\\tey\": 1, ident: 2, \"x\": { \"y\": \"z\" } }";
+    Json_arena* a = json_arena_create(0);
+    Json_value* v = json_parse_insitu(buf, a, NULL);
+    mu_assert(v != NULL);
+
+    Json_iterator* i = json_iterator_create(v);
+    mu_assert(strcmp(json_iterator_curr_key(i), "k\tey") == 0);
+    mu_assert(points_into(json_iterator_curr_key(i), buf, sizeof(buf)));
+    json_iterator_advance(i);
+    mu_assert(strcmp(json_iterator_curr_key(i), "ident") == 0);
+    json_iterator_destroy(i);
+
+    const Json_value* x = json_value_get_key(v, "x");
+    mu_assert(strcmp(json_value_get_cstr(json_value_get_key(x, "y")),
+                     "z") == 0);
+    json_arena_destroy(a);
+}
+
+static void test_insitu_copy_is_independent()
+{
+    char buf[] = "{ \"key\": \"value\" }";
+    Json_value* v = json_parse_insitu(buf, NULL, NULL);
+    Json_value* w = json_value_copy(v);
+    json_value_destroy(v);
+    memset(buf, 'x', sizeof(buf) - 1);
+    mu_assert(strcmp(json_value_get_cstr(json_value_get_key(w, "key")),
+                     "value") == 0);
+    json_value_destroy(w);
+}
+
+static void test_insitu_error()
+{
+    char buf[] = "{ \"a\": \"unterminated }";
+    Json_parse_error e;
+    mu_assert(json_parse_insitu(buf, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_runaway_string);
+}
+
+// Parses `input` with a push parser, fed `chunk` bytes at a time.
+static Json_value* push_parse(const char* input,
+                              int chunk,
+                              Json_parse_error* e)
+{
+    Json_parser* p = json_parser_create(NULL);
+    const char* end = input + strlen(input);
+    while (input < end) {
+        const int n = end - input < chunk ? end - input : chunk;
+        json_parser_feed(p, input, n);
+        input += n;
+    }
+    Json_value* v = json_parser_finish(p, e);
+    json_parser_destroy(p);
+    return v;
+}
+
+// Checks that every chunk size gives the same result as json_parse.
+static int push_parses_like_json_parse(const char* input)
+{
+    Json_parse_error e1, e2;
+    Json_value* expected = json_parse(input, &e1);
+    char* expected_text = expected ? json_stringify(expected) : NULL;
+    int chunk;
+    int same = 1;
+
+    for (chunk = 1; chunk <= (int) strlen(input) + 1; chunk++) {
+        Json_value* v = push_parse(input, chunk, &e2);
+        if (v && expected) {
+            char* text = json_stringify(v);
+            same &= strcmp(text, expected_text) == 0;
+            free(text);
+        } else {
+            same &= v == NULL && expected == NULL && e1.code == e2.code
+                && e1.line == e2.line && e1.column == e2.column;
+        }
+        if (v)
+            json_value_destroy(v);
+    }
+    if (expected)
+        json_value_destroy(expected);
+    free(expected_text);
+    return same;
+}
+
+static void test_push_split_tokens()
+{
+    mu_assert(push_parses_like_json_parse(
+        "{ \"str\\\"ing\": 'single\\n', ident: [1.5e+10, -0.25, 12345],\r\n"
+        "  /* block\r\n comment */ \"k\": true, // line comment\r\n"
+        "  \"f\": fALSE, \"n\": null }\r\n"));
+    mu_assert(push_parses_like_json_parse("  12345678901234567890  "));
+    mu_assert(push_parses_like_json_parse("[truex]"));
+}
+
+static void test_push_errors()
+{
+    mu_assert(push_parses_like_json_parse("[1, 2"));
+    mu_assert(push_parses_like_json_parse("{\"a\":\r\n\r\n  1e}"));
+    mu_assert(push_parses_like_json_parse("[\"abc\n def"));
+    mu_assert(push_parses_like_json_parse("[1] /* runaway"));
+    mu_assert(push_parses_like_json_parse("[1] 2"));
+    mu_assert(push_parses_like_json_parse("\"a\\q\""));
+    mu_assert(push_parses_like_json_parse("{\"a\" 1}"));
+    mu_assert(push_parses_like_json_parse(""));
+    mu_assert(push_parses_like_json_parse("/"));
+    json_parser_destroy(NULL);
+}
+
+// Feeds `input` to a push parser `chunk` bytes at a time and checks that the
+// result is written as json_parse's is.
+static int push_parses_in_chunks(const char* input, int chunk)
+{
+    Json_value* expected = json_parse(input, NULL);
+    Json_value* v = push_parse(input, chunk, NULL);
+    int same = 0;
+
+    if (v && expected) {
+        char* text = json_stringify(v);
+        char* expected_text = json_stringify(expected);
+        same = strcmp(text, expected_text) == 0;
+        free(text);
+        free(expected_text);
+    }
+    json_value_destroy(v);
+    json_value_destroy(expected);
+    return same;
+}
+
+static void test_push_long_tokens()
+{
+    const int n = 4 << 20;
+    char* input = (char*) malloc(3*n + 100);
+    char* w = input;
+    int i;
+
+    // A string with escapes and line breaks, a number and a comment, each
+    // of them megabytes long and split over a thousand chunks. Lexing each
+    // only once, however it is split, keeps this quick.
+    w += sprintf(w, "{\"s\": \"");
+    for (i = 0; i < n; i++) {
+        if (i % 1000 == 0) {
+            *w++ = '\n';
+        } else if (i % 100 == 0) {
+            *w++ = '\\';
+            *w++ = 't';
+        } else {
+            *w++ = 'a' + i % 26;
+        }
+    }
+    w += sprintf(w, "\", \"n\": 1.");
+    memset(w, '0', n / 4);
+    w += n / 4;
+    w += sprintf(w, "1, /* ");
+    memset(w, '*', n / 4);
+    w += n / 4;
+    strcpy(w, "*/ \"c\": true}");
+    mu_assert(push_parses_in_chunks(input, 4096));
+    mu_assert(push_parses_in_chunks(input, 4093));
+    free(input);
+}
+
+static void test_push_stops_at_error()
+{
+    Json_parser* p = json_parser_create(NULL);
+    Json_parse_error e;
+    mu_assert(json_parser_feed(p, "[1, ", 4));
+    mu_assert(!json_parser_feed(p, "}", 1));
+    mu_assert(!json_parser_feed(p, "]", 1));
+    mu_assert(json_parser_finish(p, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_input);
+    mu_assert(e.column == 5);
+    json_parser_destroy(p);
+}
+
+static void test_push_arena()
+{
+    Json_arena* a = json_arena_create(0);
+    Json_parser* p = json_parser_create(a);
+    json_parser_feed(p, "{\"ke", 4);
+    json_parser_feed(p, "y\": [\"val", 9);
+    json_parser_feed(p, "ue\"]}", 5);
+    Json_value* v = json_parser_finish(p, NULL);
+    json_parser_destroy(p);
+    mu_assert(v != NULL);
+    char* s = json_stringify(v);
+    mu_assert(strcmp(s, "{\"key\":[\"value\"]}") == 0);
+    free(s);
+    json_arena_destroy(a);
+}
+
+// Rebuilds the text of a document from its events, in json_stringify's
+// format, and cancels at the event numbered `stop_at`.
+typedef struct Rebuilder Rebuilder;
+struct Rebuilder {
+    char text[1024];
+    int length;
+    int need_comma[64];
+    int depth;
+    int events;
+    int stop_at;
+    int bad_length;     // was a string's length wrong?
+};
+
+static void emit(Rebuilder* r, const char* s, int is_key, int is_value)
+{
+    if (r->depth > 0 && !is_value && r->need_comma[r->depth - 1])
+        r->length += sprintf(r->text + r->length, ", ");
+    r->length += sprintf(r->text + r->length, "%s%s", s, is_key ? ":" : "");
+    if (r->depth > 0)
+        r->need_comma[r->depth - 1] = !is_key;
+}
+
+static int count_event(Rebuilder* r)
+{
+    return ++r->events != r->stop_at;
+}
+
+static int on_start(Rebuilder* r, const char* s)
+{
+    emit(r, s, 0, 0);
+    r->need_comma[r->depth++] = 0;
+    return count_event(r);
+}
+
+static int on_end(Rebuilder* r, const char* s)
+{
+    r->length += sprintf(r->text + r->length, "%s", s);
+    r->depth--;
+    return count_event(r);
+}
+
+static int on_start_object(void* c) { return on_start(c, "{"); }
+static int on_end_object(void* c) { return on_end(c, "}"); }
+static int on_start_array(void* c) { return on_start(c, "["); }
+static int on_end_array(void* c) { return on_end(c, "]"); }
+
+static int on_key(void* c, const char* k, size_t length)
+{
+    char buf[128];
+    ((Rebuilder*) c)->bad_length |= strlen(k) != length;
+    sprintf(buf, "\"%s\"", k);
+    emit(c, buf, 1, 0);
+    return count_event(c);
+}
+
+static int on_string(void* c, const char* s, size_t length)
+{
+    Json_value* v = json_value_from_cstr(s);
+    char* text = json_stringify(v);
+    ((Rebuilder*) c)->bad_length |= strlen(s) != length;
+    emit(c, text, 0, 0);
+    free(text);
+    json_value_destroy(v);
+    return count_event(c);
+}
+
+static int on_number(void* c, double n)
+{
+    Json_value* v = json_value_from_double(n);
+    char* text = json_stringify(v);
+    emit(c, text, 0, 0);
+    free(text);
+    json_value_destroy(v);
+    return count_event(c);
+}
+
+static int on_boolean(void* c, int b)
+{
+    emit(c, b ? "true" : "false", 0, 0);
+    return count_event(c);
+}
+
+static int on_null(void* c)
+{
+    emit(c, "null", 0, 0);
+    return count_event(c);
+}
+
+static const Json_handler rebuilder = {
+    on_start_object, on_end_object, on_start_array, on_end_array,
+    on_key, on_string, on_number, on_boolean, on_null,
+};
+
+static void test_events_match_tree()
+{
+    const char* input =
+        "{ \"a\": [1, 2.5, \"s\\tr\"], b: { \"c\": null, \"d\": [] },"
+        "  \"e\": tRUE, \"f\": false, \"g\": {}, \"h\": [[[-1e300]]] }";
+    Json_value* v = json_parse(input, NULL);
+    char* expected = json_stringify(v);
+    Rebuilder r;
+
+    memset(&r, 0, sizeof(r));
+    mu_assert(json_parse_events(input, &rebuilder, &r, NULL));
+    mu_assert(strcmp(r.text, expected) == 0);
+    mu_assert(r.depth == 0);
+    mu_assert(!r.bad_length);
+
+    free(expected);
+    json_value_destroy(v);
+}
+
+static void test_events_errors()
+{
+    const char* inputs[] = { "[1, 2", "{\"a\" 1}", "[}", "1 2", "", "[1 @]" };
+    const Json_handler none = { 0 };
+    int i;
+
+    for (i = 0; i < sizeof(inputs)/sizeof(inputs[0]); i++) {
+        Json_parse_error e1, e2;
+        mu_assert(json_parse(inputs[i], &e1) == NULL);
+        mu_assert(!json_parse_events(inputs[i], &none, NULL, &e2));
+        mu_assert(e1.code == e2.code);
+        mu_assert(e1.line == e2.line && e1.column == e2.column);
+    }
+}
+
+static void test_events_cancel()
+{
+    Rebuilder r;
+    Json_parse_error e;
+
+    memset(&r, 0, sizeof(r));
+    r.stop_at = 3;
+    mu_assert(!json_parse_events("[1, [2], 3]", &rebuilder, &r, &e));
+    mu_assert(e.code == json_parse_error_cancelled);
+    mu_assert(strcmp(r.text, "[1, [") == 0);
+}
+
+static void test_events_deep_nesting()
+{
+    char input[402];
+    int i;
+
+    for (i = 0; i < 200; i++) {
+        input[i] = '[';
+        input[i + 200] = ']';
+    }
+    input[400] = '\0';
+    const Json_handler none = { 0 };
+    mu_assert(json_parse_events(input, &none, NULL, NULL));
+}
+
+// Checks that a lazy parse, fully expanded by json_stringify, gives the same
+// result as json_parse, with and without an arena.
+static int lazy_parses_like_json_parse(const char* input)
+{
+    Json_value* expected = json_parse(input, NULL);
+    char* expected_text = json_stringify(expected);
+    json_value_destroy(expected);
+
+    Json_value* v = json_parse_lazy(input, NULL, NULL);
+    char* text = json_stringify(v);
+    int same = strcmp(text, expected_text) == 0;
+    free(text);
+    json_value_destroy(v);
+
+    Json_arena* a = json_arena_create(0);
+    v = json_parse_lazy(input, a, NULL);
+    text = json_stringify(v);
+    same &= strcmp(text, expected_text) == 0;
+    free(text);
+    json_arena_destroy(a);
+
+    free(expected_text);
+    return same;
+}
+
+static void test_lazy_matches_json_parse()
+{
+    mu_assert(lazy_parses_like_json_parse(
+        "{ \"a\": [1, [2, [3]], {\"b\": {}}], c: { \"d\": [] },\r\n"
+        "  \"brackets\": [\"]\", '}', \"\\\"]\", /* ] */ 1 // }\n ],\n"
+        "  \"e\": \"x\" }"));
+    mu_assert(lazy_parses_like_json_parse("[[1, 2], [3, [4, [5]]], []]"));
+    mu_assert(lazy_parses_like_json_parse("  \"scalar\"  "));
+}
+
+static void test_lazy_accessors()
+{
+    const char* input =
+        "{\"id\": 7, \"tags\": [\"x\", \"y\"], \"user\": {\"name\": \"ann\"}}";
+    Json_value* v = json_parse_lazy(input, NULL, NULL);
+    mu_assert(v != NULL);
+    mu_assert(json_value_get_double(json_value_get_key(v, "id")) == 7);
+
+    const Json_value* user = json_value_get_key(v, "user");
+    mu_assert(json_value_has_type(user, json_type_object));
+    mu_assert(strcmp(json_value_get_cstr(json_value_get_key(user, "name")),
+                     "ann") == 0);
+
+    const Json_value* tags = json_value_get_key(v, "tags");
+    mu_assert(json_value_count_members(tags) == 2);
+    mu_assert(!json_value_is_malformed(tags));
+
+    // Lazy containers can still be modified and copied.
+    json_value_append((Json_value*) tags, json_value_from_cstr("z"));
+    Json_value* w = json_value_copy(v);
+    char* s = json_stringify(w);
+    mu_assert(strcmp(s, "{\"id\":7, \"tags\":[\"x\", \"y\", \"z\"], "
+                        "\"user\":{\"name\":\"ann\"}}") == 0);
+    free(s);
+    json_value_destroy(w);
+    json_value_destroy(v);
+
+    // Unexpanded values are released too.
+    json_value_destroy(json_parse_lazy(input, NULL, NULL));
+}
+
+static void test_lazy_errors()
+{
+    Json_parse_error e;
+
+    // Errors within nested containers are found only when they are parsed.
+    Json_value* v = json_parse_lazy("{\"a\": 1, \"b\": [1, : 2]}", NULL, &e);
+    mu_assert(v != NULL);
+    mu_assert(json_value_get_double(json_value_get_key(v, "a")) == 1);
+    const Json_value* b = json_value_get_key(v, "b");
+    mu_assert(json_value_is_malformed(b));
+    mu_assert(json_value_count_members(b) == 0);
+    mu_assert(!json_value_is_malformed(v));
+    json_value_destroy(v);
+
+    // Unbalanced brackets, strings and comments are found up front.
+    mu_assert(json_parse_lazy("{\"a\": [1, [2]", NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+    mu_assert(json_parse_lazy("[[\"]]", NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_runaway_string);
+    mu_assert(json_parse_lazy("[[/* ]]", NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_runaway_comment);
+
+    // Positions of later errors count the lines that were skipped.
+    Json_parse_error e2;
+    const char* input = "{\"a\": [\n1,\r\n\"x\ny\"], \"b\" 3}";
+    mu_assert(json_parse_lazy(input, NULL, &e) == NULL);
+    mu_assert(json_parse(input, &e2) == NULL);
+    mu_assert(e.code == e2.code);
+    mu_assert(e.line == e2.line);
+    mu_assert(e.column == e2.column);
+}
+
+// Checks that json_validate, given `input` without its nul, gives the same
+// result and error as json_parse.
+static int validates_like_json_parse(const char* input)
+{
+    const size_t n = strlen(input);
+    char* copy = (char*) malloc(n + 1);
+    Json_parse_error e1, e2;
+    int i;
+
+    memcpy(copy, input, n);
+    Json_value* v = json_parse(input, &e1);
+    const int ok = json_validate(copy, n, &e2);
+    free(copy);
+    json_value_destroy(v);
+
+    if (v || ok) {
+        return v && ok;
+    }
+    for (i = 0; e1.expected_token_types[i] != json_token_type_error; i++) {
+        if (e1.expected_token_types[i] != e2.expected_token_types[i])
+            return 0;
+    }
+    return e1.code == e2.code && e1.line == e2.line
+        && e1.column == e2.column
+        && e2.expected_token_types[i] == json_token_type_error
+        && e1.actual_token_type == e2.actual_token_type;
+}
+
+static void test_validate_matches_json_parse()
+{
+    const char* inputs[] = {
+        "{ \"a\": [1, 2.5, \"s\\tr\"], b: { \"c\": null, \"d\": [] },"
+        "  \"e\": tRUE, 'f': false, \"g\": {}, \"h\": [[[-1e300]]] }",
+        "[1 2,]", "{\"a\": 1,}", "[[]", "  7 // end", "/* c */ \"x\"",
+        "\"multi\nline\"", "",  "[1, 2", "{\"a\" 1}", "[}", "1 2", "[1 @]",
+        "{\"a\": }", "{1: 2}", "[\"\\q\"]", "[\"open", "[1e999]", "[1.]",
+        "/* open", "[\"a\"\r\n, \"b\nc\" x]", "{a: 1, b:\n[2, {c: 3}] ,}",
+        "tru", "[t]", "[nul", "\"\\", "{\"a\": 1 \"b\": 2}", "[,]", "/",
+        "{\"a\": 1} 2",
+    };
+    int i;
+
+    for (i = 0; i < sizeof(inputs)/sizeof(inputs[0]); i++) {
+        mu_assert(validates_like_json_parse(inputs[i]));
+    }
+}
+
+static void test_validate_limits()
+{
+    const int n = json_validate_max_depth + 1;
+    char* input = (char*) malloc(2 * n);
+    Json_parse_error e;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        input[i] = '[';
+        input[2 * n - 1 - i] = ']';
+    }
+    mu_assert(json_validate(input + 1, 2 * n - 2, NULL));
+    mu_assert(!json_validate(input, 2 * n, &e));
+    mu_assert(e.code == json_parse_error_nesting_too_deep);
+    free(input);
+
+    // Unlike json_parse, which does not support them yet, json_validate
+    // rejects \u escapes.
+    mu_assert(!json_validate("[\"\\u0041\"]", 10, &e));
+    mu_assert(e.code == json_parse_error_illegal_escape_sequence);
+
+    // Only the given bytes are read.
+    mu_assert(json_validate("[1, 2] 3", 6, NULL));
+    mu_assert(json_validate("truex", 4, NULL));
+}
+
+// Minifies `input` with `flags` and returns the output, or "error" if
+// json_minify fails.
+static const char* minify(const char* input, int flags)
+{
+    static char buf[512];
+    Json_sink* sink = json_sink_create_buffer(buf, sizeof(buf));
+    if (!json_minify(input, sink, flags, NULL))
+        strcpy(buf, "error");
+    json_sink_destroy(sink);
+    return buf;
+}
+
+static void test_minify()
+{
+    const char* input =
+        "{ a: 1, 'b': [1 2, -3.50e1,], // comment\n"
+        "  \"c\\\"\": 'it\\'s \"x\"\\t', d: tRUE, e: /* x */ null,\n"
+        "  f: {}, 'g\nh': [[], {},] }";
+
+    mu_assert(strcmp(minify(input, json_minify_strict),
+                     "{\"a\":1,\"b\":[1,2,-3.50e1],"
+                     "\"c\\\"\":\"it's \\\"x\\\"\\t\",\"d\":true,"
+                     "\"e\":null,\"f\":{},\"g\\nh\":[[],{}]}") == 0);
+    mu_assert(strcmp(minify(input, 0),
+                     "{a:1,'b':[1,2,-3.50e1],\"c\\\"\":'it\\'s \"x\"\\t',"
+                     "d:true,e:null,f:{},'g\nh':[[],{}]}") == 0);
+    mu_assert(strcmp(minify(" 1e400x ", 0), "error") == 0);
+    mu_assert(strcmp(minify(" 0.10 ", 0), "0.10") == 0);
+    mu_assert(strcmp(minify("[+1, -00, 007.5, -.5e3, 1., 2.E+05]", 0),
+                     "[+1,-00,007.5,-.5e3,1.,2.E+05]") == 0);
+    mu_assert(strcmp(minify("[+1, -00, 007.5, -.5e3, 1., 2.E+05]",
+                            json_minify_strict),
+                     "[1,-0,7.5,-0.5e3,1,2E+05]") == 0);
+    mu_assert(strcmp(minify("[\"a\x01\x1f b\x7f\"]", json_minify_strict),
+                     "[\"a\\u0001\\u001f b\x7f\"]") == 0);
+    mu_assert(strcmp(minify("[\"a\x01\x1f b\"]", 0),
+                     "[\"a\x01\x1f b\"]") == 0);
+
+    // Strict output parses to the same value as the input.
+    Json_value* v1 = json_parse(input, NULL);
+    Json_value* v2 = json_parse(minify(input, json_minify_strict), NULL);
+    char* s1 = json_stringify(v1);
+    char* s2 = json_stringify(v2);
+    mu_assert(strcmp(s1, s2) == 0);
+    free(s1);
+    free(s2);
+    json_value_destroy(v1);
+    json_value_destroy(v2);
+}
+
+static void test_minify_errors()
+{
+    char buf[8];
+    Json_parse_error e;
+
+    // Output before the error is kept.
+    Json_sink* sink = json_sink_create_buffer(buf, sizeof(buf));
+    mu_assert(!json_minify("[1, {]", sink, 0, &e));
+    mu_assert(e.code == json_parse_error_unexpected_input);
+    mu_assert(strcmp(buf, "[1,{") == 0);
+    json_sink_destroy(sink);
+
+    // A failure of the sink is reported too.
+    sink = json_sink_create_buffer(buf, sizeof(buf));
+    mu_assert(!json_minify("[1, 2, 3, 4, 5]", sink, 0, &e));
+    mu_assert(json_sink_flush(sink) != 0);
+    json_sink_destroy(sink);
+}
+
+// Tests that json_parse_length, given a copy of `input` with no nul after it,
+// gives the same result or error as json_parse.
+static int parses_length_like_json_parse(const char* input)
+{
+    const size_t n = strlen(input);
+    char* copy = (char*) malloc(n ? n : 1);
+    Json_parse_error e1, e2;
+    int ok;
+
+    memcpy(copy, input, n);
+    Json_value* v1 = json_parse(input, &e1);
+    Json_value* v2 = json_parse_length(copy, n, NULL, &e2);
+    if (v1 && v2) {
+        char* s1 = json_stringify(v1);
+        char* s2 = json_stringify(v2);
+        ok = strcmp(s1, s2) == 0;
+        free(s1);
+        free(s2);
+    } else {
+        ok = !v1 && !v2 && e1.code == e2.code && e1.line == e2.line
+            && e1.column == e2.column;
+    }
+    json_value_destroy(v1);
+    json_value_destroy(v2);
+    free(copy);
+    return ok;
+}
+
+static void test_parse_length()
+{
+    const char* inputs[] = {
+        "{\"a\": [1, 2.5e3, \"s\\tr\"], \"b\": {\"c\": null}}", "true",
+        "[false]", "null", "-12", "\"x\"", "[tru", "[1, 2", "{a: 'b'}",
+        "[1] // end", "/* open", "\"open", "\"esc\\", "", "[1e", "{\"a\": n",
+    };
+    Json_parse_error e;
+    int i;
+
+    for (i = 0; i < sizeof(inputs)/sizeof(inputs[0]); i++) {
+        mu_assert(parses_length_like_json_parse(inputs[i]));
+    }
+
+    // The length, not a nul, ends the input.
+    mu_assert(json_parse_length("[1]\0", 4, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_extraneous_input);
+    mu_assert(json_parse_length("[1]", 2, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+}
+
+// Writes `text` to a new temporary file and returns its descriptor, at the
+// start of the file. The file is removed at once.
+static int temporary_file(const char* text)
+{
+    char path[] = "/tmp/parser.t.XXXXXX";
+    const int fd = mkstemp(path);
+    const size_t n = strlen(text);
+
+    unlink(path);
+    if (fd < 0 || write(fd, text, n) != (ssize_t) n
+        || lseek(fd, 0, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    return fd;
+}
+
+// Tests that `v` is the array [1, 2], and destroys it.
+static int is_one_two(Json_value* v)
+{
+    char* s = v ? json_stringify(v) : NULL;
+    const int ok = s && strcmp(s, "[1, 2]") == 0;
+    free(s);
+    json_value_destroy(v);
+    return ok;
+}
+
+static void test_parse_file()
+{
+    Json_parse_error e;
+    int fd, fds[2];
+
+    fd = temporary_file("[1, 2]");
+    mu_assert(fd >= 0);
+    mu_assert(is_one_two(json_parse_fd(fd, NULL, NULL)));
+    mu_assert(lseek(fd, 0, SEEK_CUR) == 6);
+    close(fd);
+
+    // From the current offset.
+    fd = temporary_file("xx[1, 2]");
+    mu_assert(fd >= 0 && lseek(fd, 2, SEEK_SET) == 2);
+    mu_assert(is_one_two(json_parse_fd(fd, NULL, NULL)));
+    close(fd);
+
+    fd = temporary_file("[1, \n2");
+    mu_assert(json_parse_fd(fd, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+    mu_assert(e.line == 1);
+    close(fd);
+
+    fd = temporary_file("");
+    mu_assert(json_parse_fd(fd, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+    close(fd);
+
+    // Pipes are read rather than mapped.
+    mu_assert(pipe(fds) == 0);
+    mu_assert(write(fds[1], "[1,", 3) == 3 && write(fds[1], " 2]", 3) == 3);
+    close(fds[1]);
+    mu_assert(is_one_two(json_parse_fd(fds[0], NULL, NULL)));
+    close(fds[0]);
+
+    mu_assert(json_parse_file("/nonexistent/file.json", NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_io && errno == ENOENT);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_insitu_strings);
+    mu_run_test(test_insitu_keys);
+    mu_run_test(test_insitu_copy_is_independent);
+    mu_run_test(test_insitu_error);
+    mu_run_test(test_push_split_tokens);
+    mu_run_test(test_push_errors);
+    mu_run_test(test_push_long_tokens);
+    mu_run_test(test_push_stops_at_error);
+    mu_run_test(test_push_arena);
+    mu_run_test(test_events_match_tree);
+    mu_run_test(test_events_errors);
+    mu_run_test(test_events_cancel);
+    mu_run_test(test_events_deep_nesting);
+    mu_run_test(test_lazy_matches_json_parse);
+    mu_run_test(test_lazy_accessors);
+    mu_run_test(test_lazy_errors);
+    mu_run_test(test_validate_matches_json_parse);
+    mu_run_test(test_validate_limits);
+    mu_run_test(test_minify);
+    mu_run_test(test_minify_errors);
+    mu_run_test(test_parse_length);
+    mu_run_test(test_parse_file);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
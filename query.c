@@ -0,0 +1,451 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "query.h"
+#include "lazy.h"
+#include "lexer.h"
+#include "str.h"
+#include "utilities.h"
+#include <ctype.h>
+#include <string.h>
+
+// Stands for no index in a Step.
+static const size_t _no_index = (size_t) -1;
+
+// One step of a path, selecting some of the members of an object or the
+// elements of an array.
+typedef struct Step Step;
+struct Step {
+    char* key;      // name of the member to select, or null
+    size_t index;   // index of the element to select, or _no_index
+    int any;        // select all of them?
+};
+
+struct Json_query {
+    Step* steps;
+    int n_steps;
+    int size;       // capacity of `steps`
+};
+
+//
+// +-------------+
+// | compilation |
+// +-------------+
+//
+
+static void _add_step(Json_query* q, char* key, size_t index, int any)
+{
+    if (q->n_steps == q->size) {
+        q->size *= 2;
+        q->steps = (Step*) erealloc(q->steps, q->size * sizeof(Step));
+    }
+    q->steps[q->n_steps].key = key;
+    q->steps[q->n_steps].index = index;
+    q->steps[q->n_steps].any = any;
+    q->n_steps++;
+}
+
+// Parses the array index of `length` digits at `p`. Returns _no_index unless
+// they form a number without leading zeros that is less than _no_index.
+static size_t _parse_index(const char* p, size_t length)
+{
+    size_t n = 0;
+    size_t i;
+
+    if (length == 0 || (p[0] == '0' && length > 1)) {
+        return _no_index;
+    }
+    for (i = 0; i < length; i++) {
+        if (!isdigit((unsigned char) p[i]) || n > (_no_index - 10) / 10) {
+            return _no_index;
+        }
+        n = 10 * n + (p[i] - '0');
+    }
+    return n;
+}
+
+// Compiles the JSON Pointer `p` into `q`. Returns 0 if it is malformed.
+static int _compile_pointer(Json_query* q, const char* p)
+{
+    while (*p == '/') {
+        Str* token = str_create(16);
+        for (p++; *p != '\0' && *p != '/'; p++) {
+            if (*p != '~') {
+                str_append_char(&token, *p);
+            } else if (p[1] == '0' || p[1] == '1') {
+                str_append_char(&token, *++p == '0' ? '~' : '/');
+            } else {
+                str_destroy(token);
+                return 0;
+            }
+        }
+        const size_t index = _parse_index(str_cstr(token), str_length(token));
+        _add_step(q, str_destroy_and_copy(token), index, 0);
+    }
+    return *p == '\0';
+}
+
+// Compiles the JSONPath steps at `p` (after the `$`) into `q`. Returns 0 if
+// they are malformed or use anything but child steps.
+static int _compile_path(Json_query* q, const char* p)
+{
+    while (*p != '\0') {
+        if (p[0] == '.' && p[1] == '*') {
+            _add_step(q, NULL, _no_index, 1);
+            p += 2;
+        } else if (p[0] == '.') {
+            const char* name = ++p;
+            while (*p != '\0' && *p != '.' && *p != '[') {
+                p++;
+            }
+            if (p == name) {
+                return 0;       // includes recursive descent, `..`
+            }
+            Str* key = str_create(p - name);
+            str_append_chars(&key, name, p - name);
+            _add_step(q, str_destroy_and_copy(key), _no_index, 0);
+        } else if (p[0] == '[' && p[1] == '*' && p[2] == ']') {
+            _add_step(q, NULL, _no_index, 1);
+            p += 3;
+        } else if (p[0] == '[' && (p[1] == '\'' || p[1] == '"')) {
+            const char quote = p[1];
+            Str* key = str_create(16);
+            for (p += 2; *p != '\0' && *p != quote; p++) {
+                if (*p == '\\' && p[1] != '\0') {
+                    p++;
+                }
+                str_append_char(&key, *p);
+            }
+            if (p[0] != quote || p[1] != ']') {
+                str_destroy(key);
+                return 0;
+            }
+            _add_step(q, str_destroy_and_copy(key), _no_index, 0);
+            p += 2;
+        } else if (p[0] == '[') {
+            const char* digits = ++p;
+            while (isdigit((unsigned char) *p)) {
+                p++;
+            }
+            const size_t index = _parse_index(digits, p - digits);
+            if (index == _no_index || *p++ != ']') {
+                return 0;
+            }
+            _add_step(q, NULL, index, 0);
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+Json_query* json_query_compile(const char* path)
+{
+    Json_query* q = (Json_query*) emalloc(sizeof(Json_query));
+    int ok;
+
+    q->n_steps = 0;
+    q->size = 4;
+    q->steps = (Step*) emalloc(q->size * sizeof(Step));
+
+    if (path[0] == '$') {
+        ok = _compile_path(q, path + 1);
+    } else {
+        ok = _compile_pointer(q, path);
+    }
+    if (!ok) {
+        json_query_destroy(q);
+        return NULL;
+    }
+    return q;
+}
+
+void json_query_destroy(Json_query* q)
+{
+    int i;
+
+    if (!q) return;
+
+    for (i = 0; i < q->n_steps; i++) {
+        free(q->steps[i].key);
+    }
+    free(q->steps);
+    free(q);
+}
+
+//
+// +------------+
+// | evaluation |
+// +------------+
+//
+
+typedef struct Run Run;
+struct Run {
+    const Json_query* query;
+    Lexer* lexer;
+    Json_arena* arena;      // holds each selected value during the callback
+    Json_query_callback callback;
+    void* context;
+    Json_parse_error error;
+};
+
+// Records an error of type `code` at the lexer's position. Returns 0.
+static int _fail(Run* run, Json_parse_error_code code)
+{
+    run->error.code = code;
+    run->error.line = lexer_line(run->lexer);
+    run->error.column = lexer_column(run->lexer);
+    return 0;
+}
+
+// Records the lexer's error (see _translate_lexer_error in parser.c).
+// Returns 0.
+static int _fail_lexer(Run* run)
+{
+    switch (lexer_error(run->lexer)) {
+    case lexer_error_input_exhausted:
+        return _fail(run, json_parse_error_unexpected_end_of_input);
+    case lexer_error_illegal_escape_sequence:
+        return _fail(run, json_parse_error_illegal_escape_sequence);
+    case lexer_error_runaway_string:
+        return _fail(run, json_parse_error_runaway_string);
+    case lexer_error_runaway_comment:
+        return _fail(run, json_parse_error_runaway_comment);
+    case lexer_error_numeric_overflow:
+    case lexer_error_numeric_underflow:
+    case lexer_error_invalid_number:
+        return _fail(run, json_parse_error_invalid_number);
+    case lexer_error_unexpected_input:
+        return _fail(run, json_parse_error_unexpected_input);
+    default:
+        return _fail(run, json_parse_error_internal);
+    }
+}
+
+// Records that the current token was not expected. Returns 0.
+static int _unexpected(Run* run)
+{
+    run->error.actual_token_type = lexer_token(run->lexer).type;
+    return _fail(run, json_parse_error_unexpected_input);
+}
+
+// Moves on to the next token, which the input must have.
+static int _advance(Run* run)
+{
+    return lexer_advance(run->lexer) || _fail_lexer(run);
+}
+
+// Steps over the value that begins with the current token.
+static int _skip(Run* run)
+{
+    switch (lexer_token(run->lexer).type) {
+    case json_token_type_left_bracket:
+    case json_token_type_left_curly:
+        return lexer_skip_container(run->lexer) || _fail_lexer(run);
+    case json_token_type_null:
+    case json_token_type_string:
+    case json_token_type_number:
+    case json_token_type_true:
+    case json_token_type_false:
+        return 1;
+    default:
+        return _unexpected(run);
+    }
+}
+
+// Passes the value that begins with the current token to the callback.
+static int _select(Run* run)
+{
+    Lexer* lexer = run->lexer;
+    const Token token = lexer_token(lexer);
+    const char* text = lexer_position(lexer) - 1;
+    Json_value* v;
+
+    switch (token.type) {
+    case json_token_type_null:
+        v = json_value_new_null_in(run->arena);
+        break;
+    case json_token_type_string:
+        v = json_value_from_cstr_nocopy_in(run->arena, token.value.string,
+                                           token.length);
+        break;
+    case json_token_type_number:
+        v = json_value_from_double_in(run->arena, token.value.number);
+        break;
+    case json_token_type_true:
+    case json_token_type_false:
+        v = json_value_from_bool_in(run->arena,
+                                    token.type == json_token_type_true);
+        break;
+    case json_token_type_left_bracket:
+    case json_token_type_left_curly:
+        if (!lexer_skip_container(lexer)) {
+            return _fail_lexer(run);
+        }
+        v = json_value_new_lazy_in(run->arena,
+                                   token.type == json_token_type_left_bracket
+                                       ? json_type_array : json_type_object,
+                                   text, lexer_position(lexer) - text);
+        break;
+    default:
+        return _unexpected(run);
+    }
+
+    const int more = run->callback(run->context, v);
+    json_arena_reset(run->arena);
+    return more || _fail(run, json_parse_error_cancelled);
+}
+
+static int _value(Run* run, int depth);
+
+// Handles the members of the object whose '{' is the current token, which
+// the first `depth` steps selected.
+static int _object(Run* run, int depth)
+{
+    const Step* step = &run->query->steps[depth];
+    Lexer* lexer = run->lexer;
+    Json_token_type type;
+
+    for (;;) {
+        if (!_advance(run)) {
+            return 0;
+        }
+        const Token key = lexer_token(lexer);
+        if (key.type == json_token_type_right_curly) {
+            return 1;   // empty, or after a trailing comma
+        }
+        if (key.type != json_token_type_string
+            && key.type != json_token_type_identifier)
+        {
+            return _unexpected(run);
+        }
+        const int selected = step->any
+            || (step->key && strcmp(step->key, key.value.string) == 0);
+
+        if (!_advance(run)) {
+            return 0;
+        }
+        if (lexer_token(lexer).type != json_token_type_colon) {
+            return _unexpected(run);
+        }
+        if (!_advance(run)
+            || !(selected ? _value(run, depth + 1) : _skip(run))
+            || !_advance(run))
+        {
+            return 0;
+        }
+
+        type = lexer_token(lexer).type;
+        if (type == json_token_type_right_curly) {
+            return 1;
+        }
+        if (type != json_token_type_comma) {
+            return _unexpected(run);
+        }
+    }
+}
+
+// Handles the elements of the array whose '[' is the current token, which
+// the first `depth` steps selected. As in the parser, commas between
+// elements are optional.
+static int _array(Run* run, int depth)
+{
+    const Step* step = &run->query->steps[depth];
+    Lexer* lexer = run->lexer;
+    size_t index = 0;
+
+    if (!_advance(run)) {
+        return 0;
+    }
+    while (lexer_token(lexer).type != json_token_type_right_bracket) {
+        const int selected = step->any || step->index == index;
+        if (!(selected ? _value(run, depth + 1) : _skip(run))) {
+            return 0;
+        }
+
+        if (!step->any && index == step->index) {
+            // No later element can be selected.
+            return lexer_skip_container(lexer) || _fail_lexer(run);
+        }
+        index++;
+
+        if (!_advance(run)) {
+            return 0;
+        }
+        if (lexer_token(lexer).type == json_token_type_comma
+            && !_advance(run))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Handles the value that begins with the current token, which the first
+// `depth` steps selected.
+static int _value(Run* run, int depth)
+{
+    if (depth == run->query->n_steps) {
+        return _select(run);
+    }
+
+    const Step* step = &run->query->steps[depth];
+    switch (lexer_token(run->lexer).type) {
+    case json_token_type_left_curly:
+        if (step->any || step->key) {
+            return _object(run, depth);
+        }
+        break;
+    case json_token_type_left_bracket:
+        if (step->any || step->index != _no_index) {
+            return _array(run, depth);
+        }
+        break;
+    default:
+        break;
+    }
+    return _skip(run);
+}
+
+int json_query_run(const Json_query* q,
+                   const char* input,
+                   Json_query_callback callback,
+                   void* context,
+                   Json_parse_error* errorp)
+{
+    Run run;
+    int ok;
+
+    run.query = q;
+    run.lexer = lexer_create(input);
+    run.arena = json_arena_create(0);
+    run.callback = callback;
+    run.context = context;
+    run.error.code = json_parse_error_success;
+    run.error.line = 0;
+    run.error.column = 0;
+    run.error.expected_token_types[0] = json_token_type_error;
+    run.error.actual_token_type = json_token_type_error;
+
+    ok = _advance(&run) && _value(&run, 0);
+
+    // It's an error for there to be more input.
+    if (ok && (lexer_advance(run.lexer)
+               || lexer_error(run.lexer) != lexer_error_input_exhausted))
+    {
+        ok = _fail(&run, json_parse_error_extraneous_input);
+    }
+
+    lexer_destroy(run.lexer);
+    json_arena_destroy(run.arena);
+
+    if (errorp && !ok)
+        *errorp = run.error;
+
+    return ok;
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_QUERY__
+#define __INCLUDED_LIBJSON_QUERY__
+
+// Queries that pick values out of a document as it is read, without building
+// a tree for the rest of it. A query is a path written in either of two
+// notations:
+//
+//   - JSONPath, limited to child steps: `$` followed by any of `.name`,
+//     `.*`, `['name']` (or with double quotes), `[N]` and `[*]`; for example,
+//     "$.items[*].price".
+//   - JSON Pointer (RFC 6901): "" or `/`-separated reference tokens, with ~0
+//     and ~1 escapes; for example, "/items/0/price". A token of digits also
+//     selects that element of an array.
+//
+// The query is evaluated on the lexer's tokens. Arrays and objects the path
+// cannot lead into are skipped by matching brackets, and keys and scalars
+// off the path are never copied. Skipped parts of the input are therefore not
+// checked for errors beyond unbalanced brackets, strings and comments.
+
+#include "json.h"
+#include "parser.h"
+
+typedef struct Json_query Json_query;
+
+// Called with each value that the query selects, in document order (all of
+// them, where an object repeats a key). The value and everything in it are
+// valid only during the call; arrays and objects are parsed lazily (see
+// json_parse_lazy). Returns nonzero to continue or zero to stop, which makes
+// json_query_run fail with json_parse_error_cancelled.
+typedef int (*Json_query_callback)(void* context, const Json_value* v);
+
+// Compiles the path `path`. Returns null if it is not a valid path in either
+// notation. A compiled query is never modified, so it may be run by several
+// threads at once.
+Json_query* json_query_compile(const char* path);
+
+void json_query_destroy(Json_query* q);
+
+// Runs `q` over `input`, passing each value it selects to `callback` with
+// `context`. Returns 1 on success and 0 on error.
+int json_query_run(const Json_query* q,
+                   const char* input,
+                   Json_query_callback callback,
+                   void* context,
+                   Json_parse_error* errorp);
+
+#endif
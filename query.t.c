@@ -0,0 +1,152 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "query.h"
+#include "munit.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* document =
+    "{ \"items\": [ { \"name\": \"pen\", \"price\": 1.5 },\n"
+    "               { \"name\": \"ink\", \"price\": 12, \"tags\": [\"a\"] },\n"
+    "               { \"name\": \"pad\" } ],\n"
+    "  \"a/b\": { \"m~n\": true }, '0': 'zero', // comment [\n"
+    "  owner: { \"name\": \"ann\", \"items\": [9] } }";
+
+// Collects the selected values, stringified and separated by spaces, and
+// stops after `limit` of them.
+typedef struct Results Results;
+struct Results {
+    char text[512];
+    int count;
+    int limit;
+};
+
+static int collect(void* context, const Json_value* v)
+{
+    Results* r = (Results*) context;
+    char* s = json_stringify(v);
+    if (r->count++ > 0)
+        strcat(r->text, " ");
+    strcat(r->text, s);
+    free(s);
+    return r->count != r->limit;
+}
+
+// Runs the query `path` over `input` and returns the selected values, or
+// "error" if the run fails.
+static const char* run(const char* path, const char* input)
+{
+    static Results r;
+    Json_query* q = json_query_compile(path);
+    r.text[0] = '\0';
+    r.count = 0;
+    r.limit = -1;
+    if (!json_query_run(q, input, collect, &r, NULL))
+        strcpy(r.text, "error");
+    json_query_destroy(q);
+    return r.text;
+}
+
+static void test_jsonpath()
+{
+    mu_assert(strcmp(run("$.items[*].price", document), "1.5 12") == 0);
+    mu_assert(strcmp(run("$.items[1].tags", document), "[\"a\"]") == 0);
+    mu_assert(strcmp(run("$['items'][2].name", document), "\"pad\"") == 0);
+    mu_assert(strcmp(run("$[\"a/b\"].*", document), "true") == 0);
+    mu_assert(strcmp(run("$.owner.items[0]", document), "9") == 0);
+    mu_assert(strcmp(run("$.*.name", document), "\"ann\"") == 0);
+    mu_assert(strcmp(run("$.items[3]", document), "") == 0);
+    mu_assert(strcmp(run("$.nothing.here", document), "") == 0);
+    mu_assert(strcmp(run("$", "[1, {\"b\": 2}]"), "[1, {\"b\":2}]") == 0);
+    mu_assert(strcmp(run("$[*][*]", "[[1, 2] [3], 4, {\"x\": 5}]"),
+                     "1 2 3 5") == 0);
+}
+
+static void test_json_pointer()
+{
+    mu_assert(strcmp(run("/items/0/name", document), "\"pen\"") == 0);
+    mu_assert(strcmp(run("/a~1b/m~0n", document), "true") == 0);
+    mu_assert(strcmp(run("/0", document), "\"zero\"") == 0);
+    mu_assert(strcmp(run("/0", "[7, 8]"), "7") == 0);
+    mu_assert(strcmp(run("", "\"whole\""), "\"whole\"") == 0);
+}
+
+static void test_compile_errors()
+{
+    const char* paths[] = {
+        "$..price", "$.", "$[", "$[-1]", "$[01]", "$['open", "$x",
+        "items", "/a~2", "$[99999999999999999999]",
+    };
+    int i;
+
+    for (i = 0; i < sizeof(paths)/sizeof(paths[0]); i++) {
+        mu_assert(json_query_compile(paths[i]) == NULL);
+    }
+}
+
+static void test_run_errors()
+{
+    Json_query* q = json_query_compile("$.a");
+    Results r = { "", 0, -1 };
+    Json_parse_error e;
+
+    mu_assert(!json_query_run(q, "{\"a\": 1,, }", collect, &r, &e));
+    mu_assert(e.code == json_parse_error_unexpected_input);
+    mu_assert(!json_query_run(q, "{\"a\": 1} 2", collect, &r, &e));
+    mu_assert(e.code == json_parse_error_extraneous_input);
+    mu_assert(!json_query_run(q, "{\"b\": [1, 2}", collect, &r, &e));
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+    mu_assert(!json_query_run(q, "{\"a\": 1", collect, &r, &e));
+    mu_assert(e.code == json_parse_error_unexpected_end_of_input);
+
+    // Skipped values are not checked.
+    r.text[0] = '\0';
+    r.count = 0;
+    mu_assert(json_query_run(q, "{\"b\": [1 : 2], \"a\": 3}", collect, &r,
+                             NULL));
+    mu_assert(strcmp(r.text, "3") == 0);
+
+    // Nor are values after the selected element of an array.
+    json_query_destroy(q);
+    q = json_query_compile("$[0]");
+    r.text[0] = '\0';
+    r.count = 0;
+    mu_assert(json_query_run(q, "[1, 2 :: 3]", collect, &r, NULL));
+    mu_assert(strcmp(r.text, "1") == 0);
+    json_query_destroy(q);
+}
+
+static void test_cancel()
+{
+    Json_query* q = json_query_compile("$.items[*].name");
+    Results r = { "", 0, 2 };
+    Json_parse_error e;
+
+    mu_assert(!json_query_run(q, document, collect, &r, &e));
+    mu_assert(e.code == json_parse_error_cancelled);
+    mu_assert(strcmp(r.text, "\"pen\" \"ink\"") == 0);
+    json_query_destroy(q);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_jsonpath);
+    mu_run_test(test_json_pointer);
+    mu_run_test(test_compile_errors);
+    mu_run_test(test_run_errors);
+    mu_run_test(test_cancel);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -0,0 +1,453 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "scan.h"
+#include <string.h>
+
+// Number of spaces that scan_whitespace skips one at a time before handing
+// the rest of the run to the vector loop.
+enum { scan_short_run = 16 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && defined(__SSE2__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct Scanners Scanners;
+struct Scanners {
+    const char* name;
+
+    // Returns the first byte in [p, end) equal to any of a, b, c or d.
+    const char* (*find4)(const char* p, const char* end,
+                         char a, char b, char c, char d);
+
+    // Implements scan_whitespace.
+    const char* (*whitespace)(const char* p, const char* end,
+                              size_t* lines, const char** line_start);
+
+    // Implements scan_classify.
+    void (*classify)(const char* p, int n, Scan_masks* masks);
+};
+
+//
+// +-------------------------+
+// | scalar (portable) scans |
+// +-------------------------+
+//
+
+static const char* _scalar_find4(const char* p, const char* end,
+                                 char a, char b, char c, char d)
+{
+    for (; p < end; p++) {
+        const char x = *p;
+        if (x == a || x == b || x == c || x == d) {
+            break;
+        }
+    }
+    return p;
+}
+
+static const char* _scalar_whitespace(const char* p, const char* end,
+                                      size_t* lines, const char** line_start)
+{
+    for (; p < end; p++) {
+        switch (*p) {
+        case '\r':
+            if (p + 1 < end && p[1] == '\n') {
+                break;  // the LF ends the line
+            }
+            // fall through
+        case '\n':
+            (*lines)++;
+            *line_start = p + 1;
+            break;
+        case ' ': case '\t': case '\v': case '\f':
+            break;
+        default:
+            return p;
+        }
+    }
+    return p;
+}
+
+static void _scalar_classify(const char* p, int n, Scan_masks* masks)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++, p += 64) {
+        uint64_t quote = 0, backslash = 0, structural = 0;
+        for (j = 0; j < 64; j++) {
+            const uint64_t bit = (uint64_t) 1 << j;
+            switch (p[j]) {
+            case '"':
+                quote |= bit;
+                break;
+            case '\\':
+                backslash |= bit;
+                break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                structural |= bit;
+                break;
+            }
+        }
+        masks[i].quote = quote;
+        masks[i].backslash = backslash;
+        masks[i].structural = structural;
+    }
+}
+
+static const Scanners _scalar = {
+    "scalar", _scalar_find4, _scalar_whitespace, _scalar_classify
+};
+
+#ifdef SCAN_X86
+
+// Accounts for the line endings among the first `n` bytes of the `width`-byte
+// block at `p`, all of which are whitespace. `lf` and `cr` are bit masks of
+// the block's LFs and CRs; a CR only ends a line if no LF follows it.
+static void _count_lines(const char* p, const char* end, int width, int n,
+                         unsigned lf, unsigned cr,
+                         size_t* lines, const char** line_start)
+{
+    unsigned lf_next = lf >> 1;     // bit i set if byte i+1 is a LF
+    if (p + width < end && p[width] == '\n') {
+        lf_next |= 1u << (width - 1);
+    }
+
+    unsigned endings = lf | (cr & ~lf_next);
+    if (n < 32) {
+        endings &= (1u << n) - 1;
+    }
+    if (endings != 0) {
+        *lines += __builtin_popcount(endings);
+        *line_start = p + (31 - __builtin_clz(endings)) + 1;
+    }
+}
+
+//
+// +------------+
+// | SSE2 scans |
+// +------------+
+//
+
+static const char* _sse2_find4(const char* p, const char* end,
+                               char a, char b, char c, char d)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vd = _mm_set1_epi8(d);
+
+    for (; end - p >= 16; p += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i*) p);
+        const __m128i hits =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va),
+                                      _mm_cmpeq_epi8(x, vb)),
+                         _mm_or_si128(_mm_cmpeq_epi8(x, vc),
+                                      _mm_cmpeq_epi8(x, vd)));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return _scalar_find4(p, end, a, b, c, d);
+}
+
+static const char* _sse2_whitespace(const char* p, const char* end,
+                                    size_t* lines, const char** line_start)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    for (; end - p >= 16; p += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i*) p);
+
+        // '\t' through '\r' are contiguous, so one unsigned range check
+        // (x - '\t' <= 4) catches all of them.
+        const __m128i t = _mm_sub_epi8(x, tab);
+        const __m128i ws =
+            _mm_or_si128(_mm_cmpeq_epi8(x, space),
+                         _mm_cmpeq_epi8(_mm_min_epu8(t, four), t));
+        const unsigned other = ~_mm_movemask_epi8(ws) & 0xffff;
+        const int n = other ? __builtin_ctz(other) : 16;
+
+        _count_lines(p, end, 16, n,
+                     _mm_movemask_epi8(_mm_cmpeq_epi8(x, lf)),
+                     _mm_movemask_epi8(_mm_cmpeq_epi8(x, cr)),
+                     lines, line_start);
+        if (n < 16) {
+            return p + n;
+        }
+    }
+    return _scalar_whitespace(p, end, lines, line_start);
+}
+
+// Returns a mask of the bytes of `x` that are structural characters. Setting
+// bit 5 maps '[' and ']' onto '{' and '}' and no other byte onto either.
+static int _sse2_structural(__m128i x)
+{
+    const __m128i folded = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    const __m128i hits =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                  _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(':')),
+                                  _mm_cmpeq_epi8(x, _mm_set1_epi8(','))));
+    return _mm_movemask_epi8(hits);
+}
+
+static void _sse2_classify(const char* p, int n, Scan_masks* masks)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    int i, j;
+
+    for (i = 0; i < n; i++, p += 64) {
+        Scan_masks m = { 0, 0, 0 };
+        for (j = 0; j < 4; j++) {
+            const __m128i x = _mm_loadu_si128((const __m128i*) (p + 16*j));
+            const int shift = 16 * j;
+            m.quote |= (uint64_t) (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(x, quote)) << shift;
+            m.backslash |= (uint64_t) (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(x, backslash)) << shift;
+            m.structural |= (uint64_t) (unsigned) _sse2_structural(x) << shift;
+        }
+        masks[i] = m;
+    }
+}
+
+static const Scanners _sse2 = {
+    "sse2", _sse2_find4, _sse2_whitespace, _sse2_classify
+};
+
+//
+// +------------+
+// | AVX2 scans |
+// +------------+
+//
+
+__attribute__((target("avx2")))
+static const char* _avx2_find4(const char* p, const char* end,
+                               char a, char b, char c, char d)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    const __m256i vd = _mm256_set1_epi8(d);
+
+    for (; end - p >= 32; p += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        const __m256i hits =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, va),
+                                            _mm256_cmpeq_epi8(x, vb)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(x, vc),
+                                            _mm256_cmpeq_epi8(x, vd)));
+        const unsigned mask = (unsigned) _mm256_movemask_epi8(hits);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return _sse2_find4(p, end, a, b, c, d);
+}
+
+__attribute__((target("avx2")))
+static const char* _avx2_whitespace(const char* p, const char* end,
+                                    size_t* lines, const char** line_start)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    for (; end - p >= 32; p += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        const __m256i t = _mm256_sub_epi8(x, tab);
+        const __m256i ws =
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, space),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(t, four), t));
+        const unsigned other = ~(unsigned) _mm256_movemask_epi8(ws);
+        const int n = other ? __builtin_ctz(other) : 32;
+
+        _count_lines(p, end, 32, n,
+                     (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, lf)),
+                     (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, cr)),
+                     lines, line_start);
+        if (n < 32) {
+            return p + n;
+        }
+    }
+    return _sse2_whitespace(p, end, lines, line_start);
+}
+
+// As _sse2_structural, 32 bytes at a time.
+__attribute__((target("avx2")))
+static unsigned _avx2_structural(__m256i x)
+{
+    const __m256i folded = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+    const __m256i hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                        _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(':')),
+                        _mm256_cmpeq_epi8(x, _mm256_set1_epi8(','))));
+    return (unsigned) _mm256_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2")))
+static void _avx2_classify(const char* p, int n, Scan_masks* masks)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    int i;
+
+    for (i = 0; i < n; i++, p += 64) {
+        const __m256i lo = _mm256_loadu_si256((const __m256i*) p);
+        const __m256i hi = _mm256_loadu_si256((const __m256i*) (p + 32));
+        masks[i].quote =
+            (uint64_t) (unsigned) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(lo, quote))
+            | (uint64_t) (unsigned) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(hi, quote)) << 32;
+        masks[i].backslash =
+            (uint64_t) (unsigned) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(lo, backslash))
+            | (uint64_t) (unsigned) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(hi, backslash)) << 32;
+        masks[i].structural =
+            (uint64_t) _avx2_structural(lo)
+            | (uint64_t) _avx2_structural(hi) << 32;
+    }
+}
+
+static const Scanners _avx2 = {
+    "avx2", _avx2_find4, _avx2_whitespace, _avx2_classify
+};
+
+#endif
+
+//
+// +----------+
+// | dispatch |
+// +----------+
+//
+
+// Returns the fastest implementation this CPU supports.
+static const Scanners* _best_scanners()
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &_avx2;
+    }
+    return &_sse2;
+#else
+    return &_scalar;
+#endif
+}
+
+// The implementation in use; chosen on first use. Racing threads all store
+// the same pointer, atomically.
+static const Scanners* _scanners = NULL;
+
+static const Scanners* _get_scanners()
+{
+    const Scanners* s = __atomic_load_n(&_scanners, __ATOMIC_ACQUIRE);
+    if (s == NULL) {
+        s = _best_scanners();
+        __atomic_store_n(&_scanners, s, __ATOMIC_RELEASE);
+    }
+    return s;
+}
+
+// Makes `s` the implementation in use.
+static void _set_scanners(const Scanners* s)
+{
+    __atomic_store_n(&_scanners, s, __ATOMIC_RELEASE);
+}
+
+const char* scan_string(const char* p, const char* end, char quote)
+{
+    return _get_scanners()->find4(p, end, quote, '\\', '\n', '\r');
+}
+
+const char* scan_whitespace(const char* p, const char* end,
+                            size_t* lines, const char** line_start)
+{
+    int n;
+
+    // Most tokens are not preceded by whitespace at all, and most of the
+    // rest by a space or a line break and a short indent, which are skipped
+    // here; only longer runs are worth loading into vector registers.
+    if (p < end && (unsigned char) *p > ' ') {
+        return p;
+    }
+    if (p < end && (*p == '\n' || *p == '\r')) {
+        if (*p == '\r' && p + 1 < end && p[1] == '\n') {
+            p++;
+        }
+        (*lines)++;
+        *line_start = ++p;
+    }
+    for (n = 0; n < scan_short_run && p < end && *p == ' '; n++) {
+        p++;
+    }
+    if (p == end || (unsigned char) *p > ' ') {
+        return p;
+    }
+    return _get_scanners()->whitespace(p, end, lines, line_start);
+}
+
+const char* scan_line_end(const char* p, const char* end)
+{
+    return _get_scanners()->find4(p, end, '\n', '\r', '\n', '\r');
+}
+
+const char* scan_block_comment(const char* p, const char* end)
+{
+    return _get_scanners()->find4(p, end, '*', '\n', '\r', '*');
+}
+
+void scan_classify(const char* p, int n, Scan_masks* masks)
+{
+    _get_scanners()->classify(p, n, masks);
+}
+
+const char* scan_implementation()
+{
+    return _get_scanners()->name;
+}
+
+int scan_use_implementation(const char* name)
+{
+    if (name == NULL) {
+        _set_scanners(_best_scanners());
+        return 1;
+    }
+    if (strcmp(name, "scalar") == 0) {
+        _set_scanners(&_scalar);
+        return 1;
+    }
+#ifdef SCAN_X86
+    if (strcmp(name, "sse2") == 0) {
+        _set_scanners(&_sse2);
+        return 1;
+    }
+    if (strcmp(name, "avx2") == 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            _set_scanners(&_avx2);
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_SCAN__
+#define __INCLUDED_LIBJSON_SCAN__
+
+// Byte-scanning primitives for the lexer. On x86 these process 16 or 32 bytes
+// at a time with SSE2 or AVX2, chosen at run time according to what the CPU
+// supports; elsewhere they fall back to plain loops.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns a pointer to the first byte in [p, end) that is `quote`, a
+// backslash, '\n' or '\r', or `end` if there is none.
+const char* scan_string(const char* p, const char* end, char quote);
+
+// Returns a pointer to the first byte in [p, end) that is not whitespace
+// (space, tab, vertical tab, form feed, CR or LF), or `end` if there is none.
+// Adds the number of line endings skipped to `*lines` (a CRLF pair counts
+// once, as does a lone CR or LF) and, if there were any, points `*line_start`
+// just past the last of them.
+const char* scan_whitespace(const char* p, const char* end,
+                            size_t* lines, const char** line_start);
+
+// Returns a pointer to the first CR or LF in [p, end), or `end`.
+const char* scan_line_end(const char* p, const char* end);
+
+// Returns a pointer to the first '*', CR or LF in [p, end), or `end`.
+const char* scan_block_comment(const char* p, const char* end);
+
+// Bit masks classifying the bytes of a 64-byte block: bit i of each mask is
+// set if byte i of the block is a double quote, a backslash, or one of the
+// structural characters {}[]:, respectively.
+typedef struct Scan_masks Scan_masks;
+struct Scan_masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+};
+
+// Classifies the `n` consecutive 64-byte blocks at `p` into `masks[0]`
+// through `masks[n-1]`.
+void scan_classify(const char* p, int n, Scan_masks* masks);
+
+// Returns the name of the implementation in use: "avx2", "sse2" or "scalar".
+const char* scan_implementation();
+
+// Forces the named implementation, or the best one available if `name` is
+// null. Returns 0 (and changes nothing) if the CPU does not support it. This
+// exists for benchmarks and tests and is not thread-safe.
+int scan_use_implementation(const char* name);
+
+#endif
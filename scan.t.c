@@ -0,0 +1,200 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "scan.h"
+#include "munit.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* implementations[] = { "scalar", "sse2", "avx2" };
+enum { n_implementations = sizeof(implementations)/sizeof(implementations[0]) };
+
+// Checks scan_string against every implementation the CPU supports, for a
+// special character at each position of a 100-byte buffer.
+static void test_scan_string()
+{
+    const char specials[] = "\"'\\\n\r";
+    char buf[100];
+    int i, j, k;
+
+    for (i = 0; i < n_implementations; i++) {
+        if (!scan_use_implementation(implementations[i]))
+            continue;
+        for (j = 0; j < sizeof(buf); j++) {
+            for (k = 0; k < strlen(specials); k++) {
+                memset(buf, 'a', sizeof(buf));
+                buf[j] = specials[k];
+                const char* end = buf + sizeof(buf);
+                const char* hit = scan_string(buf, end, '"');
+                if (specials[k] == '\'') {
+                    mu_assert(hit == end);
+                    mu_assert(scan_string(buf, end, '\'') == buf + j);
+                } else {
+                    mu_assert(hit == buf + j);
+                }
+                mu_assert(scan_string(buf + j + 1, end, '"') == end);
+            }
+        }
+    }
+    scan_use_implementation(NULL);
+}
+
+// High-bit bytes must not be mistaken for specials by the signed compares.
+static void test_scan_string_high_bytes()
+{
+    char buf[64];
+    int i;
+
+    memset(buf, 0xa2, sizeof(buf));    // 0xa2 == '"' | 0x80
+    for (i = 0; i < n_implementations; i++) {
+        if (!scan_use_implementation(implementations[i]))
+            continue;
+        mu_assert(scan_string(buf, buf + sizeof(buf), '"') ==
+                  buf + sizeof(buf));
+    }
+    scan_use_implementation(NULL);
+}
+
+// Skips whitespace a byte at a time, as scan_whitespace should.
+static const char* reference_whitespace(const char* p, const char* end,
+                                        size_t* lines,
+                                        const char** line_start)
+{
+    for (; p < end && strchr(" \t\n\r\v\f", *p) != NULL; p++) {
+        if (*p == '\n' || (*p == '\r' && (p + 1 == end || p[1] != '\n'))) {
+            (*lines)++;
+            *line_start = p + 1;
+        }
+    }
+    return p;
+}
+
+// Compares scan_whitespace across implementations, and with
+// reference_whitespace, on random whitespace.
+static void test_scan_whitespace()
+{
+    const char alphabet[] = "    \t\t\n\r\r\v\fx";
+    char buf[200];
+    int round, i, j;
+
+    srand(1);
+    for (round = 0; round < 2000; round++) {
+        const int len = rand() % sizeof(buf);
+        for (j = 0; j < len; j++) {
+            buf[j] = alphabet[rand() % (sizeof(alphabet) - 1 - (round & 1))];
+        }
+        const char* end = buf + len;
+
+        size_t lines = 0;
+        const char* line_start = NULL;
+        scan_use_implementation("scalar");
+        const char* stop = scan_whitespace(buf, end, &lines, &line_start);
+        size_t lines0 = 0;
+        const char* line_start0 = NULL;
+        mu_assert(reference_whitespace(buf, end, &lines0, &line_start0)
+                  == stop);
+        mu_assert(lines0 == lines && line_start0 == line_start);
+
+        for (i = 1; i < n_implementations; i++) {
+            if (!scan_use_implementation(implementations[i]))
+                continue;
+            size_t lines2 = 0;
+            const char* line_start2 = NULL;
+            mu_assert(scan_whitespace(buf, end, &lines2, &line_start2) == stop);
+            mu_assert(lines2 == lines);
+            mu_assert(line_start2 == line_start);
+        }
+    }
+    scan_use_implementation(NULL);
+}
+
+static void test_scan_whitespace_line_endings()
+{
+    const char s[] = "  \r\n\n\r  \r\r\n x";
+    size_t lines = 0;
+    const char* line_start = NULL;
+    const char* stop = scan_whitespace(s, s + strlen(s), &lines, &line_start);
+    mu_assert(stop == strchr(s, 'x'));
+    mu_assert(lines == 5);
+    mu_assert(line_start == stop - 1);
+}
+
+static void test_scan_comments()
+{
+    const char s[] = "a comment that ends here */ { \r\n";
+    const char* end = s + strlen(s);
+    int i;
+
+    for (i = 0; i < n_implementations; i++) {
+        if (!scan_use_implementation(implementations[i]))
+            continue;
+        mu_assert(scan_block_comment(s, end) == strchr(s, '*'));
+        mu_assert(scan_line_end(s, end) == strchr(s, '\r'));
+        mu_assert(scan_line_end(s, end - 2) == end - 2);
+    }
+    scan_use_implementation(NULL);
+}
+
+// Compares scan_classify across implementations on random bytes drawn mostly
+// from the characters it picks out, including their high-bit twins.
+static void test_scan_classify()
+{
+    const char alphabet[] = "\"\\{}[]:,;{[]}\x22\xa2\xdb\xfb\xba\xac ax";
+    char buf[3 * 64];
+    Scan_masks expected[3], masks[3];
+    int round, i, j;
+
+    srand(2);
+    for (round = 0; round < 500; round++) {
+        for (j = 0; j < sizeof(buf); j++) {
+            buf[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        scan_use_implementation("scalar");
+        scan_classify(buf, 3, expected);
+        for (j = 0; j < 3; j++) {
+            for (i = 0; i < 64; i++) {
+                const char c = buf[64 * j + i];
+                mu_assert(((expected[j].quote >> i) & 1) == (c == '"'));
+                mu_assert(((expected[j].backslash >> i) & 1) == (c == '\\'));
+                mu_assert(((expected[j].structural >> i) & 1) ==
+                          (c != '\0' && strchr("{}[]:,", c) != NULL));
+            }
+        }
+
+        for (i = 1; i < n_implementations; i++) {
+            if (!scan_use_implementation(implementations[i]))
+                continue;
+            scan_classify(buf, 3, masks);
+            mu_assert(memcmp(masks, expected, sizeof(masks)) == 0);
+        }
+    }
+    scan_use_implementation(NULL);
+}
+
+static void test_unknown_implementation()
+{
+    mu_assert(!scan_use_implementation("mmx"));
+    mu_assert(scan_use_implementation(NULL));
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_scan_string);
+    mu_run_test(test_scan_string_high_bytes);
+    mu_run_test(test_scan_whitespace);
+    mu_run_test(test_scan_whitespace_line_endings);
+    mu_run_test(test_scan_comments);
+    mu_run_test(test_scan_classify);
+    mu_run_test(test_unknown_implementation);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
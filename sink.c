@@ -0,0 +1,168 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "sink.h"
+#include "utilities.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { sink_default_buffer_size = 4096 };
+
+struct Json_sink {
+    Json_sink_callback callback;    // null for caller-owned buffers
+    void* context;
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    size_t written;
+    int failed;
+    int owns_buffer;
+};
+
+static Json_sink* _create(Json_sink_callback callback,
+                          void* context,
+                          char* buffer,
+                          size_t capacity,
+                          int owns_buffer)
+{
+    Json_sink* sink = (Json_sink*) emalloc(sizeof(Json_sink));
+    sink->callback = callback;
+    sink->context = context;
+    sink->buffer = buffer;
+    sink->capacity = capacity;
+    sink->length = 0;
+    sink->written = 0;
+    sink->failed = 0;
+    sink->owns_buffer = owns_buffer;
+    return sink;
+}
+
+Json_sink* json_sink_create(Json_sink_callback callback,
+                            void* context,
+                            size_t buffer_size)
+{
+    if (buffer_size == 0) {
+        buffer_size = sink_default_buffer_size;
+    }
+    return _create(callback, context, (char*) emalloc(buffer_size),
+                   buffer_size, 1);
+}
+
+static int _write_file(void* context, const char* data, size_t length)
+{
+    return fwrite(data, 1, length, (FILE*) context) != length;
+}
+
+Json_sink* json_sink_create_file(FILE* f)
+{
+    return json_sink_create(_write_file, f, 0);
+}
+
+static int _write_fd(void* context, const char* data, size_t length)
+{
+    const int fd = (int) (size_t) context;
+    while (length > 0) {
+        const ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        data += n;
+        length -= n;
+    }
+    return 0;
+}
+
+Json_sink* json_sink_create_fd(int fd)
+{
+    return json_sink_create(_write_fd, (void*) (size_t) fd, 0);
+}
+
+Json_sink* json_sink_create_buffer(char* buf, size_t size)
+{
+    if (size == 0) {
+        return _create(NULL, NULL, NULL, 0, 0);
+    }
+    buf[0] = '\0';
+    return _create(NULL, NULL, buf, size - 1, 0);
+}
+
+void json_sink_destroy(Json_sink* sink)
+{
+    if (!sink) return;
+
+    if (sink->owns_buffer) {
+        free(sink->buffer);
+    }
+    free(sink);
+}
+
+// Empties the buffer through the callback; a caller-owned buffer can only be
+// terminated, not emptied.
+static void _drain(Json_sink* sink)
+{
+    if (sink->callback == NULL) {
+        if (sink->buffer != NULL) {
+            sink->buffer[sink->length] = '\0';
+        }
+        return;
+    }
+    if (sink->length > 0 && !sink->failed) {
+        sink->failed = sink->callback(sink->context, sink->buffer,
+                                      sink->length) != 0;
+    }
+    sink->length = 0;
+}
+
+void json_sink_write(Json_sink* sink, const char* data, size_t length)
+{
+    sink->written += length;
+    while (length > 0) {
+        size_t room = sink->capacity - sink->length;
+        if (room == 0) {
+            if (sink->callback == NULL) {
+                sink->failed = 1;
+                break;
+            }
+            _drain(sink);
+            room = sink->capacity;
+        }
+        const size_t n = length < room ? length : room;
+        memcpy(sink->buffer + sink->length, data, n);
+        sink->length += n;
+        data += n;
+        length -= n;
+    }
+    if (sink->callback == NULL) {
+        _drain(sink);
+    }
+}
+
+void json_sink_put(Json_sink* sink, char c)
+{
+    if (sink->length < sink->capacity && sink->callback != NULL) {
+        sink->buffer[sink->length++] = c;
+        sink->written++;
+    } else {
+        json_sink_write(sink, &c, 1);
+    }
+}
+
+int json_sink_flush(Json_sink* sink)
+{
+    _drain(sink);
+    return sink->failed;
+}
+
+size_t json_sink_bytes_written(const Json_sink* sink)
+{
+    return sink->written;
+}
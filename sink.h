@@ -0,0 +1,63 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_SINK__
+#define __INCLUDED_LIBJSON_SINK__
+
+// Destination for serialized output. A sink collects bytes in a buffer of
+// fixed size and hands them to a callback whenever the buffer fills up (and
+// on json_sink_flush), so output of any length is produced in constant
+// memory. Once the callback fails, the sink discards further output and
+// reports the failure from json_sink_flush.
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct Json_sink Json_sink;
+
+// Called with the next `length` bytes of output; returns zero on success and
+// nonzero on failure.
+typedef int (*Json_sink_callback)(void* context, const char* data, size_t length);
+
+// Creates a sink that passes its output to `callback`, `buffer_size` bytes at
+// a time at most; a zero `buffer_size` selects a reasonable default.
+Json_sink* json_sink_create(Json_sink_callback callback,
+                            void* context,
+                            size_t buffer_size);
+
+// Creates a sink that writes to the stdio stream `f`.
+Json_sink* json_sink_create_file(FILE* f);
+
+// Creates a sink that writes to the file descriptor `fd`, retrying short and
+// interrupted writes.
+Json_sink* json_sink_create_fd(int fd);
+
+// Creates a sink that writes to the caller's buffer `buf` of `size` bytes,
+// which is kept nul-terminated. Output that does not fit is a failure; what
+// did fit is left in the buffer.
+Json_sink* json_sink_create_buffer(char* buf, size_t size);
+
+// Releases the sink without flushing it.
+void json_sink_destroy(Json_sink* sink);
+
+// Appends `length` bytes from `data` to the output.
+void json_sink_write(Json_sink* sink, const char* data, size_t length);
+
+// Appends the character `c` to the output.
+void json_sink_put(Json_sink* sink, char c);
+
+// Passes all buffered output to the callback. Returns zero if every write
+// so far has succeeded and nonzero otherwise.
+int json_sink_flush(Json_sink* sink);
+
+// Returns the number of bytes written to the sink so far, including any that
+// were lost to a failure; after filling a caller-owned buffer, this is the
+// size the output needed.
+size_t json_sink_bytes_written(const Json_sink* sink);
+
+#endif
@@ -0,0 +1,155 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "sink.h"
+#include "munit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char* document =
+    "{\"name\": \"tab\\there\", \"list\": [1, 2.5, true, null, \"\\\"q\\\"\"]}";
+
+// Collects output, remembering the largest piece the sink passed along.
+typedef struct Collector Collector;
+struct Collector {
+    char data[256];
+    size_t length;
+    size_t largest;
+    int fail_after;
+};
+
+static int collect(void* context, const char* data, size_t length)
+{
+    Collector* c = (Collector*) context;
+    if (c->fail_after-- == 0)
+        return 1;
+    memcpy(c->data + c->length, data, length);
+    c->length += length;
+    c->data[c->length] = '\0';
+    if (length > c->largest)
+        c->largest = length;
+    return 0;
+}
+
+static void test_callback_sink()
+{
+    Json_value* v = json_parse(document, NULL);
+    char* expected = json_stringify(v);
+
+    Collector c = { "", 0, 0, -1 };
+    Json_sink* sink = json_sink_create(collect, &c, 7);
+    mu_assert(json_write(v, sink) == 0);
+    mu_assert(strcmp(c.data, expected) == 0);
+    mu_assert(c.largest <= 7);
+    mu_assert(json_sink_bytes_written(sink) == strlen(expected));
+    json_sink_destroy(sink);
+
+    free(expected);
+    json_value_destroy(v);
+}
+
+static void test_callback_failure()
+{
+    Json_value* v = json_parse(document, NULL);
+    Collector c = { "", 0, 0, 2 };
+    Json_sink* sink = json_sink_create(collect, &c, 4);
+    mu_assert(json_write(v, sink) != 0);
+    mu_assert(c.length == 8);
+    json_sink_destroy(sink);
+    json_sink_destroy(NULL);
+    json_value_destroy(v);
+}
+
+static void test_buffer_sink()
+{
+    Json_value* v = json_parse("[1, \"two\", {\"3\":4}]", NULL);
+    char buf[32];
+
+    Json_sink* sink = json_sink_create_buffer(buf, sizeof(buf));
+    mu_assert(json_write(v, sink) == 0);
+    mu_assert(strcmp(buf, "[1, \"two\", {\"3\":4}]") == 0);
+    json_sink_destroy(sink);
+
+    // The output needs 19 bytes plus the nul.
+    sink = json_sink_create_buffer(buf, 10);
+    mu_assert(json_write(v, sink) != 0);
+    mu_assert(strcmp(buf, "[1, \"two\"") == 0);
+    mu_assert(json_sink_bytes_written(sink) == 19);
+    json_sink_destroy(sink);
+
+    sink = json_sink_create_buffer(buf, 20);
+    mu_assert(json_write(v, sink) == 0);
+    mu_assert(strlen(buf) == 19);
+    json_sink_destroy(sink);
+
+    json_value_destroy(v);
+}
+
+static void test_file_sink()
+{
+    Json_value* v = json_parse(document, NULL);
+    char* expected = json_stringify(v);
+    char buf[256];
+
+    FILE* f = tmpfile();
+    Json_sink* sink = json_sink_create_file(f);
+    mu_assert(json_write(v, sink) == 0);
+    json_sink_destroy(sink);
+    rewind(f);
+    const size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    mu_assert(strcmp(buf, expected) == 0);
+
+    free(expected);
+    json_value_destroy(v);
+}
+
+static void test_fd_sink()
+{
+    Json_value* v = json_parse(document, NULL);
+    char* expected = json_stringify(v);
+    char buf[256];
+    int fds[2];
+
+    mu_assert(pipe(fds) == 0);
+    Json_sink* sink = json_sink_create_fd(fds[1]);
+    mu_assert(json_write(v, sink) == 0);
+    json_sink_destroy(sink);
+    close(fds[1]);
+
+    size_t n = 0;
+    ssize_t r;
+    while ((r = read(fds[0], buf + n, sizeof(buf) - 1 - n)) > 0)
+        n += r;
+    buf[n] = '\0';
+    close(fds[0]);
+    mu_assert(strcmp(buf, expected) == 0);
+
+    free(expected);
+    json_value_destroy(v);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_callback_sink);
+    mu_run_test(test_callback_failure);
+    mu_run_test(test_buffer_sink);
+    mu_run_test(test_file_sink);
+    mu_run_test(test_fd_sink);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
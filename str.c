@@ -12,17 +12,20 @@
 #include <string.h>
 
 struct Str {
-    int length;
-    int size;
+    size_t length;
+    size_t size;
     char data[1];
 };
 
-static void _str_insure_capacity(Str** s, int extra_chars)
+static void _str_insure_capacity(Str** s, size_t extra_chars)
 {
     Str* t = *s;  // to reduce dereferencing
-    const int min_size = t->length + extra_chars + 1;
+    if (extra_chars > (size_t) -1 - t->length - 1) {
+        JSON_PANIC(("string too long"));
+    }
+    const size_t min_size = t->length + extra_chars + 1;
     if (t->size < min_size) {
-        do { t->size *= 2; } while (t->size < min_size);
+        t->size = egrow(t->size, min_size);
         Str* new_str = str_create(t->size);
         new_str->length = t->length;
         memcpy(new_str->data, t->data, t->length + 1);
@@ -31,9 +34,9 @@ static void _str_insure_capacity(Str** s, int extra_chars)
     }
 }
 
-Str* str_create(int size_hint)
+Str* str_create(size_t size_hint)
 {
-    const int size = size_hint > 0 ? size_hint : 16;
+    const size_t size = size_hint > 0 ? size_hint : 16;
     Str* s = (Str*) emalloc(sizeof(Str) + size*sizeof(char));
     s->length = 0;
     s->size = size;
@@ -43,7 +46,7 @@ Str* str_create(int size_hint)
 
 Str* str_create_from_cstr(const char* t)
 {
-    const int size = strlen(t) + 1;
+    const size_t size = strlen(t) + 1;
     Str* s = (Str*) emalloc(sizeof(Str) + size);
     s->length = size - 1;
     s->size = size;
@@ -66,7 +69,7 @@ char* str_destroy_and_copy(Str* s)
 
 void str_append_cstr(Str** s, const char* t)
 {
-    const int t_len = strlen(t);
+    const size_t t_len = strlen(t);
     _str_insure_capacity(s, t_len);
     memcpy((*s)->data + (*s)->length, t, t_len + 1);
     (*s)->length += t_len;
@@ -79,12 +82,20 @@ void str_append_char(Str** s, char c)
     (*s)->data[(*s)->length] = '\0';
 }
 
+void str_append_chars(Str** s, const char* t, size_t length)
+{
+    _str_insure_capacity(s, length);
+    memcpy((*s)->data + (*s)->length, t, length);
+    (*s)->length += length;
+    (*s)->data[(*s)->length] = '\0';
+}
+
 const char* str_cstr(const Str* s)
 {
     return s->data;
 }
 
-int str_length(const Str* s)
+size_t str_length(const Str* s)
 {
     return s->length;
 }
@@ -9,15 +9,18 @@
 #ifndef __INCLUDED_LIBJSON_STR__
 #define __INCLUDED_LIBJSON_STR__
 
+#include <stddef.h>
+
 typedef struct Str Str;
 
-Str* str_create(int size_hint);
+Str* str_create(size_t size_hint);
 Str* str_create_from_cstr(const char* s);
 void str_destroy(Str* s);
 char* str_destroy_and_copy(Str* s);
 void str_append_cstr(Str** s, const char* t);
 void str_append_char(Str** s, char c);
+void str_append_chars(Str** s, const char* t, size_t length);
 const char* str_cstr(const Str* s);
-int str_length(const Str* s);
+size_t str_length(const Str* s);
 
 #endif
@@ -46,6 +46,17 @@ static void test_append_char()
     str_destroy(s);
 }
 
+static void test_append_chars()
+{
+    Str* s = str_create(1);
+    str_append_chars(&s, "12345", 3);
+    str_append_chars(&s, "", 0);
+    str_append_chars(&s, "45", 2);
+    mu_assert(strcmp(str_cstr(s), "12345") == 0);
+    mu_assert(str_length(s) == 5);
+    str_destroy(s);
+}
+
 static void test_destroy_and_copy()
 {
     Str* s = str_create(1);
@@ -60,6 +71,7 @@ static void run_all_tests()
     mu_run_test(test_new_str);
     mu_run_test(test_append_cstr);
     mu_run_test(test_append_char);
+    mu_run_test(test_append_chars);
     mu_run_test(test_destroy_and_copy);
 }
 
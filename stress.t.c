@@ -0,0 +1,122 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+// Tests with documents of more than 4 GB, whose offsets, lengths and line
+// numbers do not fit in 32 bits. They need about as much free disk and, for
+// the long string, 2 GB of memory, and are slow, so they are run by `make
+// stress` instead of `make test`.
+
+#include "json.h"
+#include "parser.h"
+#include "munit.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Number of bytes of filler in the huge documents.
+static const size_t huge = ((size_t) 1 << 32) + 4096;
+
+// Length of the long string, which is more than an int can count.
+static const size_t long_string = ((size_t) 1 << 31) + 4096;
+
+enum { block_size = 1 << 20 };
+
+// Writes `head`, `n` copies of `fill` and `tail` to a new temporary file and
+// returns its descriptor, at the start of the file, or -1 if that fails. The
+// file is removed at once.
+static int temporary_file(const char* head,
+                          char fill,
+                          size_t n,
+                          const char* tail)
+{
+    char path[] = "/tmp/stress.t.XXXXXX";
+    const int fd = mkstemp(path);
+    char* block = (char*) malloc(block_size);
+    int ok = fd >= 0;
+
+    unlink(path);
+    memset(block, fill, block_size);
+    ok = ok && write(fd, head, strlen(head)) == (ssize_t) strlen(head);
+    while (ok && n > 0) {
+        const size_t k = n < block_size ? n : block_size;
+        ok = write(fd, block, k) == (ssize_t) k;
+        n -= k;
+    }
+    ok = ok && write(fd, tail, strlen(tail)) == (ssize_t) strlen(tail);
+    ok = ok && lseek(fd, 0, SEEK_SET) == 0;
+    free(block);
+    if (!ok && fd >= 0) {
+        close(fd);
+    }
+    return ok ? fd : -1;
+}
+
+// Tests that `v` is the array ["a", 1], and destroys it.
+static int is_a_one(Json_value* v)
+{
+    char* s = v ? json_stringify(v) : NULL;
+    const int ok = s && strcmp(s, "[\"a\", 1]") == 0;
+    free(s);
+    json_value_destroy(v);
+    return ok;
+}
+
+static void test_huge_whitespace()
+{
+    const int fd = temporary_file("[\"a\",", '\n', huge, " 1]");
+
+    mu_assert(fd >= 0);
+    mu_assert(is_a_one(json_parse_fd(fd, NULL, NULL)));
+    close(fd);
+}
+
+static void test_huge_error_position()
+{
+    const int fd = temporary_file("[1,", '\n', huge, "  x]");
+    Json_parse_error e;
+
+    mu_assert(fd >= 0);
+    mu_assert(json_parse_fd(fd, NULL, &e) == NULL);
+    mu_assert(e.code == json_parse_error_unexpected_input);
+    mu_assert(e.line == huge);
+    mu_assert(e.column == 3);
+    close(fd);
+}
+
+static void test_long_string()
+{
+    char* buf = (char*) malloc(long_string + 3);
+    Json_value* v;
+
+    mu_assert(buf != NULL);
+    buf[0] = '"';
+    memset(buf + 1, 'a', long_string);
+    buf[long_string + 1] = '"';
+    buf[long_string + 2] = '\0';
+
+    mu_assert(json_validate(buf, long_string + 2, NULL));
+    v = json_parse_insitu(buf, NULL, NULL);
+    mu_assert(v != NULL);
+    mu_assert(json_value_get_cstr_length(v) == long_string);
+    mu_assert(json_value_get_cstr(v)[long_string - 1] == 'a');
+    json_value_destroy(v);
+    free(buf);
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_huge_whitespace);
+    mu_run_test(test_huge_error_position);
+    mu_run_test(test_long_string);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -0,0 +1,521 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "structural.h"
+#include "number.h"
+#include "scan.h"
+#include "utilities.h"
+#include <string.h>
+
+// Number of 64-byte blocks classified at a time.
+enum { structural_batch = 64 };
+
+// Nesting depth up to which stage two needs no memory for its stack.
+enum { structural_inline_depth = 32 };
+
+static int _enabled = 1;
+
+typedef enum Walk_state Walk_state;
+enum Walk_state {
+    walk_state_value,       // expecting a value
+    walk_state_key,         // expecting a key
+    walk_state_after,       // after a value
+};
+
+typedef struct Frame Frame;
+struct Frame {
+    Json_value* container;
+    int is_array;
+};
+
+// Stage one runs a batch of blocks ahead of stage two, which asks for the
+// next batch only once it has used up the positions of the last; so the
+// index takes no memory to speak of, and input that is not strict JSON costs
+// little more to reject than it takes to reach the offending byte.
+typedef struct Walker Walker;
+struct Walker {
+    const char* input;
+    const char* end;
+    size_t length;
+    size_t indexed;         // number of input bytes classified
+    size_t base;            // offset of the batch the index covers
+    uint64_t escape_carry;  // see _escaped
+    uint64_t in_string;     // all ones if the next block starts in a string
+    int count;              // number of positions in index
+    int next;               // first position not yet reached
+    Json_arena* arena;
+    int elements;           // parsing the elements of an array instead?
+    int open;               // ... whose closing bracket lies past the end?
+    Json_value* root;
+    Frame* stack;           // unfinished arrays and objects, innermost last
+    int depth;
+    int stack_size;
+    char* text;             // unescaped string value
+    size_t text_size;
+    char* key;              // unescaped key of the member being parsed
+    size_t key_size;
+    Frame inline_stack[structural_inline_depth];
+
+    // The positions, in increasing order, of the unescaped double quotes and
+    // of the structural characters outside strings, in the next batch of
+    // blocks with any, relative to `base` so that they stay small.
+    int index[64 * structural_batch];
+};
+
+//
+// +-----------------------------+
+// | stage one: structural index |
+// +-----------------------------+
+//
+
+// Returns a mask of the bytes of a block that are escaped, given the block's
+// backslashes. `*carry` says whether the block's first byte is escaped by a
+// backslash at the end of the previous block, and is updated for the next.
+// Backslashes are rare, so each one is simply visited in turn.
+static uint64_t _escaped(uint64_t backslash, uint64_t* carry)
+{
+    uint64_t escaped = *carry;
+
+    backslash &= ~escaped;  // an escaped backslash escapes nothing
+    *carry = 0;
+    while (backslash != 0) {
+        const int i = __builtin_ctzll(backslash);
+        if (i == 63) {
+            *carry = 1;
+            break;
+        }
+        escaped |= (uint64_t) 2 << i;
+        backslash &= ~((uint64_t) 3 << i);
+    }
+    return escaped;
+}
+
+// Returns a mask in which bit i is the exclusive or of bits 0 through i of
+// `x`. Applied to the quotes of a block, this marks the bytes from each
+// opening quote up to (but not including) its closing quote.
+static uint64_t _prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Replaces the used-up index with the positions from the next batch of blocks
+// that has any, returning 0 if the rest of the input has none.
+static int _refill(Walker* w)
+{
+    Scan_masks masks[structural_batch];
+    char tail[64];
+    int i;
+
+    w->count = w->next = 0;
+    while (w->count == 0 && w->indexed < w->length) {
+        const char* p = w->input + w->indexed;
+        const size_t left = (w->length - w->indexed) / 64;
+        int blocks = left > structural_batch ? structural_batch : left;
+
+        w->base = w->indexed;
+        if (blocks == 0) {          // pad the last, partial block
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, p, w->length - w->indexed);
+            p = tail;
+            blocks = 1;
+        }
+        scan_classify(p, blocks, masks);
+
+        for (i = 0; i < blocks; i++, w->indexed += 64) {
+            const uint64_t escaped =
+                _escaped(masks[i].backslash, &w->escape_carry);
+            const uint64_t quote = masks[i].quote & ~escaped;
+            const uint64_t inside = _prefix_xor(quote) ^ w->in_string;
+            uint64_t bits = quote | (masks[i].structural & ~inside);
+
+            w->in_string = (uint64_t) ((int64_t) inside >> 63);
+            while (bits != 0) {
+                w->index[w->count++] =
+                    w->indexed - w->base + __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+    }
+    return w->count > 0;
+}
+
+//
+// +-----------------------------+
+// | stage two: building values  |
+// +-----------------------------+
+//
+
+static const char* _skip_ws(const char* p, const char* end)
+{
+    size_t lines = 0;
+    const char* line_start;
+    return scan_whitespace(p, end, &lines, &line_start);
+}
+
+// Tests whether `p` is the next position in the index, and if so moves on to
+// the one after it.
+static int _at_next(Walker* w, const char* p)
+{
+    if (w->next == w->count && !_refill(w)) {
+        return 0;
+    }
+    if (p == w->input + w->base + w->index[w->next]) {
+        w->next++;
+        return 1;
+    }
+    return 0;
+}
+
+// Unescapes the string whose opening quote is at `p` into `*buf` (of
+// `*size` bytes), and returns a pointer just past its closing quote. Returns
+// null if the string is not where the index says or contains an escape
+// sequence the lexer would not accept as is.
+static const char* _string(Walker* w,
+                           const char* p,
+                           char** buf,
+                           size_t* size)
+{
+    if (!_at_next(w, p) || (w->next == w->count && !_refill(w))) {
+        return NULL;
+    }
+    const char* s = p + 1;
+    const char* e = w->input + w->base + w->index[w->next++];  // closing quote
+    if ((size_t) (e - s) + 1 > *size) {
+        *size = egrow(*size, (size_t) (e - s) + 1);
+        *buf = (char*) erealloc(*buf, *size);
+    }
+
+    char* out = *buf;
+    const char* bs;
+    while ((bs = memchr(s, '\\', e - s)) != NULL) {
+        memcpy(out, s, bs - s);
+        out += bs - s;
+        switch (bs[1]) {    // the closing quote is never escaped
+        case '"': case '\\': case '/':
+            *out++ = bs[1];
+            break;
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        default:
+            return NULL;
+        }
+        s = bs + 2;
+    }
+    memcpy(out, s, e - s);
+    out[e - s] = '\0';
+    return e + 1;
+}
+
+// Returns the byte at `p`, or a nul at the end of the input.
+static char _peek(const Walker* w, const char* p)
+{
+    return p < w->end ? *p : '\0';
+}
+
+// Parses the strict JSON number at `p` into `*d`, returning a pointer past
+// its end, or null if there is no such number.
+static const char* _number(const Walker* w, const char* p, double* d)
+{
+    const char* start = p;
+    const char* endp;
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define PEEK _peek(w, p)
+
+    if (PEEK == '-') {
+        p++;
+    }
+    if (PEEK == '0') {
+        p++;
+    } else if (IS_DIGIT(PEEK)) {
+        while (IS_DIGIT(PEEK)) p++;
+    } else {
+        return NULL;
+    }
+    if (PEEK == '.') {
+        p++;
+        if (!IS_DIGIT(PEEK)) {
+            return NULL;
+        }
+        while (IS_DIGIT(PEEK)) p++;
+    }
+    if (PEEK == 'e' || PEEK == 'E') {
+        p++;
+        if (PEEK == '+' || PEEK == '-') {
+            p++;
+        }
+        if (!IS_DIGIT(PEEK)) {
+            return NULL;
+        }
+        while (IS_DIGIT(PEEK)) p++;
+    }
+
+#undef PEEK
+#undef IS_DIGIT
+
+    if (number_parse(start, p, d, &endp) != number_status_success
+        || endp != p)
+    {
+        return NULL;
+    }
+    return p;
+}
+
+// Adds the new value `v` to the innermost array or object, or makes it the
+// result if there is none.
+static void _add_value(Walker* w, Json_value* v)
+{
+    if (w->depth == 0) {
+        w->root = v;
+        return;
+    }
+
+    const Frame* top = &w->stack[w->depth - 1];
+    if (top->is_array) {
+        json_value_append(top->container, v);
+    } else {
+        json_value_set_key(top->container, w->key, v);
+    }
+}
+
+static void _push(Walker* w, Json_value* v, int is_array)
+{
+    if (w->depth == w->stack_size) {
+        const int size = 2 * w->stack_size;
+        if (w->stack == w->inline_stack) {
+            w->stack = (Frame*) emalloc(size * sizeof(Frame));
+            memcpy(w->stack, w->inline_stack, w->stack_size * sizeof(Frame));
+        } else {
+            w->stack = (Frame*) erealloc(w->stack, size * sizeof(Frame));
+        }
+        w->stack_size = size;
+    }
+    w->stack[w->depth].container = v;
+    w->stack[w->depth].is_array = is_array;
+    w->depth++;
+}
+
+// Builds the tree, returning 0 as soon as the input turns out not to be
+// strict JSON.
+static int _walk(Walker* w)
+{
+    const char* p = w->input;
+    Walk_state state = walk_state_value;
+    Json_value* v;
+    double d;
+
+    if (w->elements) {
+        v = json_value_new_array_in(w->arena, 0);
+        _add_value(w, v);
+        _push(w, v, 1);
+
+        // The array may be empty.
+        p = _skip_ws(p, w->end);
+        if (_peek(w, p) == ']' && _at_next(w, p)) {
+            p++;
+            w->depth--;
+            state = walk_state_after;
+        }
+    }
+
+    for (;;) {
+        p = _skip_ws(p, w->end);
+
+        switch (state) {
+        case walk_state_value:
+            switch (_peek(w, p)) {
+            case '"':
+                if ((p = _string(w, p, &w->text, &w->text_size)) == NULL) {
+                    return 0;
+                }
+                v = json_value_from_cstr_in(w->arena, w->text);
+                break;
+            case '[': case '{':
+                if (!_at_next(w, p)) {
+                    return 0;
+                }
+                if (*p++ == '[') {
+                    v = json_value_new_array_in(w->arena, 0);
+                    _add_value(w, v);
+                    _push(w, v, 1);
+                } else {
+                    v = json_value_new_object_in(w->arena, 0);
+                    _add_value(w, v);
+                    _push(w, v, 0);
+                    state = walk_state_key;
+                }
+
+                // The container may be empty.
+                p = _skip_ws(p, w->end);
+                if (_peek(w, p)
+                    == (w->stack[w->depth - 1].is_array ? ']' : '}'))
+                {
+                    if (!_at_next(w, p)) {
+                        return 0;
+                    }
+                    p++;
+                    w->depth--;
+                    state = walk_state_after;
+                }
+                continue;
+            case 't':
+                if (w->end - p < 4 || memcmp(p, "true", 4) != 0) {
+                    return 0;
+                }
+                v = json_value_from_bool_in(w->arena, 1);
+                p += 4;
+                break;
+            case 'f':
+                if (w->end - p < 5 || memcmp(p, "false", 5) != 0) {
+                    return 0;
+                }
+                v = json_value_from_bool_in(w->arena, 0);
+                p += 5;
+                break;
+            case 'n':
+                if (w->end - p < 4 || memcmp(p, "null", 4) != 0) {
+                    return 0;
+                }
+                v = json_value_new_null_in(w->arena);
+                p += 4;
+                break;
+            default:
+                if ((p = _number(w, p, &d)) == NULL) {
+                    return 0;
+                }
+                v = json_value_from_double_in(w->arena, d);
+                break;
+            }
+            _add_value(w, v);
+            state = walk_state_after;
+            break;
+
+        case walk_state_key:
+            if (_peek(w, p) != '"'
+                || (p = _string(w, p, &w->key, &w->key_size)) == NULL)
+            {
+                return 0;
+            }
+            p = _skip_ws(p, w->end);
+            if (_peek(w, p) != ':' || !_at_next(w, p)) {
+                return 0;
+            }
+            p++;
+            state = walk_state_value;
+            break;
+
+        case walk_state_after:
+            if (w->depth == 0) {
+                return !w->open && p == w->end && w->next == w->count
+                    && !_refill(w);
+            }
+            if (w->open && w->depth == 1 && p == w->end) {
+                return w->next == w->count && !_refill(w);
+            }
+            if (!_at_next(w, p)) {
+                return 0;
+            }
+            if (*p == ',') {
+                state = w->stack[w->depth - 1].is_array ? walk_state_value
+                                                        : walk_state_key;
+            } else if (*p == (w->stack[w->depth - 1].is_array ? ']' : '}')) {
+                w->depth--;
+            } else {
+                return 0;
+            }
+            p++;
+            break;
+        }
+    }
+}
+
+//
+// +------------+
+// | public API |
+// +------------+
+//
+
+// Does the work of structural_parse and structural_parse_elements.
+static Json_value* _parse(const char* input,
+                          size_t length,
+                          Json_arena* arena,
+                          int elements,
+                          int open)
+{
+    Walker w;
+    Json_arena_mark mark;
+
+    if (arena) {
+        mark = json_arena_mark(arena);
+    }
+    w.input = input;
+    w.end = input + length;
+    w.length = length;
+    w.indexed = w.base = 0;
+    w.escape_carry = 0;
+    w.in_string = 0;
+    w.count = w.next = 0;
+    w.arena = arena;
+    w.elements = elements;
+    w.open = open;
+    w.root = NULL;
+    w.stack = w.inline_stack;
+    w.depth = 0;
+    w.stack_size = structural_inline_depth;
+    w.text_size = w.key_size = 64;
+    w.text = (char*) emalloc(w.text_size);
+    w.key = (char*) emalloc(w.key_size);
+
+    if (!_walk(&w)) {
+        json_value_destroy(w.root);
+        w.root = NULL;
+        if (arena) {
+            json_arena_rewind(arena, mark);
+        }
+    }
+
+    free(w.text);
+    free(w.key);
+    if (w.stack != w.inline_stack) {
+        free(w.stack);
+    }
+    return w.root;
+}
+
+Json_value* structural_parse(const char* input,
+                             size_t length,
+                             Json_arena* arena)
+{
+    return _parse(input, length, arena, 0, 0);
+}
+
+Json_value* structural_parse_elements(const char* input,
+                                      size_t length,
+                                      int open)
+{
+    return _parse(input, length, NULL, 1, open);
+}
+
+int structural_enabled()
+{
+    return _enabled;
+}
+
+void structural_set_enabled(int enabled)
+{
+    _enabled = enabled;
+}
@@ -0,0 +1,52 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_STRUCTURAL__
+#define __INCLUDED_LIBJSON_STRUCTURAL__
+
+// Two-stage parser for strict JSON. Stage one classifies the input with SIMD
+// (see scan_classify), a few kilobytes ahead of stage two, and records the
+// position of every unescaped double quote and of every structural character
+// {}[]:, outside strings.
+// Stage two builds the Json_value tree by walking those positions, jumping
+// from each string's opening quote straight to its closing quote.
+//
+// Only RFC 8259 JSON without \u escapes is accepted (except that, like the
+// lexer, it lets control characters appear in strings unescaped); the
+// lexer's extensions (comments, single quotes, unquoted keys, missing or
+// trailing commas, and so on) and all errors are left to the general parser,
+// which json_parse_two_stage falls back on. Whatever this parser accepts, it
+// parses exactly as the general parser would.
+
+#include "json.h"
+
+// Parses the `length` bytes at `input`, which need not be followed by a nul.
+// Returns null if the input is not strict JSON, having released everything
+// it allocated, and rewound `arena` to where it was.
+Json_value* structural_parse(const char* input,
+                             size_t length,
+                             Json_arena* arena);
+
+// Parses the `length` bytes at `input` as the elements of an array, that is,
+// as if they followed its opening bracket, and returns that array (on the
+// heap). Unless `open` is set, the bytes must end with the closing bracket;
+// if it is, they must end after an element. Returns null if the bytes are
+// not strict JSON.
+Json_value* structural_parse_elements(const char* input,
+                                      size_t length,
+                                      int open);
+
+// Returns nonzero if json_parse_two_stage and json_parse_parallel try this
+// parser first, as they do by default.
+int structural_enabled();
+
+// Makes them use this parser (or not). This exists for benchmarks and
+// tests and is not thread-safe.
+void structural_set_enabled(int enabled);
+
+#endif
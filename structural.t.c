@@ -0,0 +1,231 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "scan.h"
+#include "structural.h"
+#include "munit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* implementations[] = { "scalar", "sse2", "avx2" };
+enum { n_implementations = sizeof(implementations)/sizeof(implementations[0]) };
+
+// Returns the output of the general parser for `input`, or null if it fails.
+static char* general(const char* input)
+{
+    Json_value* v = json_parse(input, NULL);
+    if (v == NULL)
+        return NULL;
+    char* s = json_stringify(v);
+    json_value_destroy(v);
+    return s;
+}
+
+// Tests that the structural parser accepts `input`, with every scan
+// implementation and with and without an arena, and parses it exactly as
+// the general parser does.
+static int parses_like_general(const char* input)
+{
+    char* expected = general(input);
+    int ok = expected != NULL;
+    int i;
+
+    for (i = 0; ok && i < n_implementations; i++) {
+        if (!scan_use_implementation(implementations[i]))
+            continue;
+
+        Json_value* v = structural_parse(input, strlen(input), NULL);
+        char* s = v ? json_stringify(v) : NULL;
+        ok = s != NULL && strcmp(s, expected) == 0;
+        free(s);
+        json_value_destroy(v);
+
+        Json_arena* a = json_arena_create(0);
+        v = structural_parse(input, strlen(input), a);
+        s = v ? json_stringify(v) : NULL;
+        ok = ok && s != NULL && strcmp(s, expected) == 0;
+        free(s);
+        json_arena_destroy(a);
+    }
+    scan_use_implementation(NULL);
+    free(expected);
+    return ok;
+}
+
+// Tests that the structural parser leaves `input` to the general parser,
+// with every scan implementation, and leaves nothing in an arena.
+static int falls_back(const char* input)
+{
+    Json_arena* a = json_arena_create(0);
+    int ok = 1;
+    int i;
+
+    json_arena_alloc(a, 8);
+    for (i = 0; i < n_implementations; i++) {
+        if (!scan_use_implementation(implementations[i]))
+            continue;
+        Json_value* v = structural_parse(input, strlen(input), NULL);
+        ok = ok && v == NULL;
+        json_value_destroy(v);
+
+        ok = ok && structural_parse(input, strlen(input), a) == NULL
+            && json_arena_bytes_used(a) == 8;
+    }
+    json_arena_destroy(a);
+    scan_use_implementation(NULL);
+    return ok;
+}
+
+static void test_strict_documents()
+{
+    mu_assert(parses_like_general("{}"));
+    mu_assert(parses_like_general(" [ ] "));
+    mu_assert(parses_like_general("\"just a string\""));
+    mu_assert(parses_like_general("-12.5e-3"));
+    mu_assert(parses_like_general("true"));
+    mu_assert(parses_like_general("null"));
+    mu_assert(parses_like_general(
+        "{\"a\": [1, 2, {\"b\": null}], \"c\": {\"d\": [true, false]},\n"
+        " \"e\": \"x\\\"y\\\\z\\/\\b\\f\\n\\r\\t\", \"f\": -0, \"g\": 1E+2,\n"
+        " \"[{:,}]\": \"[{:,}]\", \"\": \"\", \"h\": [[], {}, [[]]]}"));
+}
+
+// Strings and escapes that straddle the 64-byte blocks of stage one.
+static void test_block_boundaries()
+{
+    char buf[256];
+    int i, slashes;
+
+    for (i = 0; i < 140; i++) {
+        for (slashes = 1; slashes <= 4; slashes++) {
+            int n = sprintf(buf, "[\"%*s", i, "");
+            memset(buf + n, '\\', slashes);
+            n += slashes;
+            // An odd run of backslashes escapes the quote that follows.
+            n += sprintf(buf + n, "%s\", {\"k\": [1]}]",
+                         slashes % 2 ? "\"" : "");
+            mu_assert(parses_like_general(buf));
+        }
+
+        sprintf(buf, "{\"%*s\": [\"]\", \"}\"], \"x,\": 2}", i, "");
+        mu_assert(parses_like_general(buf));
+    }
+}
+
+static void test_deep_nesting()
+{
+    char buf[2 * 100 + 1];
+    int i;
+
+    for (i = 0; i < 100; i++) {
+        buf[i] = '[';
+        buf[199 - i] = ']';
+    }
+    buf[200] = '\0';
+    mu_assert(parses_like_general(buf));
+}
+
+// Everything the lexer accepts beyond RFC 8259, and every error, goes to the
+// general parser.
+static void test_fallback()
+{
+    const char* inputs[] = {
+        "", "   ", "[1, 2", "[1 2]", "[1, 2,]", "{\"a\": 1,}", "{\"a\" 1}",
+        "{a: 1}", "['single']", "[\"\\u0041\"]", "[\"\\q\"]", "[01]",
+        "[1.]", "[.5]", "[+1]", "[1e]", "[tRUE]", "[TRUE]", "[nul]",
+        "[truex]", "[1x]", "[1] // comment", "/* c */ [1]", "[1] [2]",
+        "[1]]", "[[1]", "{]", "[}", "{\"a\": 1 \"b\": 2}", "\"open",
+        "[\"a\\\"]", "{\"k\" : }", "[,]", "[1e999]", "[:]", "1 2",
+    };
+    int i;
+
+    for (i = 0; i < sizeof(inputs)/sizeof(inputs[0]); i++) {
+        mu_assert(falls_back(inputs[i]));
+    }
+}
+
+// Tests that structural_parse_elements parses the first `length` bytes of
+// `input` as `expected`, or fails if `expected` is null.
+static int parses_elements(const char* input,
+                           int length,
+                           int open,
+                           const char* expected)
+{
+    Json_value* v = structural_parse_elements(input, length, open);
+    char* s = v ? json_stringify(v) : NULL;
+    int ok = expected ? s && strcmp(s, expected) == 0 : v == NULL;
+    free(s);
+    json_value_destroy(v);
+    return ok;
+}
+
+static void test_elements()
+{
+    const char* input = "1, {\"a\": [2, \"]\"]}, \"x\" ] ";
+    mu_assert(parses_elements(input, strlen(input), 0,
+                              "[1, {\"a\":[2, \"]\"]}, \"x\"]"));
+    mu_assert(parses_elements(input, 1, 1, "[1]"));
+    mu_assert(parses_elements(input, 18, 1, "[1, {\"a\":[2, \"]\"]}]"));
+    mu_assert(parses_elements("]", 1, 0, "[]"));
+
+    // An open run may not close the array, nor a closed one leave it open.
+    mu_assert(parses_elements(input, strlen(input), 1, NULL));
+    mu_assert(parses_elements(input, 18, 0, NULL));
+    mu_assert(parses_elements("{\"a\": [1}, 2", 10, 1, NULL));
+    mu_assert(parses_elements("1], [2]", 2, 1, NULL));
+    mu_assert(parses_elements("1, ", 3, 0, NULL));
+}
+
+// json_parse_two_stage gives the same results and errors as json_parse.
+static void test_json_parse()
+{
+    const char* inputs[] = {
+        "{\"a\": [1, 2.5, \"x\"]}", "[1, 2,]", "{a: 1}", "[1, 2", "[1}",
+    };
+    int i;
+
+    for (i = 0; i < sizeof(inputs)/sizeof(inputs[0]); i++) {
+        Json_parse_error e1, e2;
+        char* expected = general(inputs[i]);
+        Json_value* v1 = json_parse(inputs[i], &e1);
+        Json_value* v2 = json_parse_two_stage(inputs[i], strlen(inputs[i]),
+                                              NULL, &e2);
+        mu_assert((v1 == NULL) == (v2 == NULL));
+        if (v2) {
+            char* s = json_stringify(v2);
+            mu_assert(strcmp(s, expected) == 0);
+            free(s);
+        } else {
+            mu_assert(e1.code == e2.code);
+            mu_assert(e1.line == e2.line);
+            mu_assert(e1.column == e2.column);
+        }
+        json_value_destroy(v1);
+        json_value_destroy(v2);
+        free(expected);
+    }
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_strict_documents);
+    mu_run_test(test_block_boundaries);
+    mu_run_test(test_deep_nesting);
+    mu_run_test(test_fallback);
+    mu_run_test(test_elements);
+    mu_run_test(test_json_parse);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -7,101 +7,354 @@
 // DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
 
 #include "table.h"
+#include "intern.h"
 #include "utilities.h"
 #include <assert.h>
 #include <string.h>
 
+// Tables with more than this many keys get a hash index; smaller tables are
+// searched linearly, which is faster than hashing for a handful of keys.
+// Entries without keys (the elements of arrays) are never looked up, so they
+// do not count.
+enum { table_index_threshold = 8 };
+
+// Marks an empty slot of the index.
+static const size_t _no_pair = (size_t) -1;
+
 typedef struct Pair Pair;
 struct Pair {
     char* key;
     void* value;
+    unsigned hash;  // hash of `key`; valid if interned or the table is indexed
+    unsigned owns_key : 1;  // was `key` copied, to be freed with us?
+    unsigned interned : 1;  // is `key` interned (see intern.h)?
 };
 
 struct Table {
-    int capacity;   // physical length of the `pairs` array
-    int size;       // logical length (number of entries in table
-    Pair pairs[1];  // table contents: array of key-value pairs
+    Json_arena* arena;  // source of all memory, or null for the heap
+    unsigned refs;      // references held; see table_share
+    size_t capacity;    // physical length of the `pairs` array
+    size_t size;        // logical length (number of entries in table
+    size_t n_keys;      // number of entries with keys
+    size_t* index;      // open-addressed positions into `pairs`, or null
+    size_t index_mask;  // number of slots in `index`, minus one
+    Pair pairs[1];      // table contents: array of key-value pairs
 };
 
-static void _extend_table(Table** t, int new_capacity)
+// Allocates memory from `arena`, or from the heap if `arena` is null.
+static void* _alloc(Json_arena* arena, size_t n)
+{
+    return arena ? json_arena_alloc(arena, n) : emalloc(n);
+}
+
+// Releases memory obtained from _alloc. Arena memory is never freed here.
+static void _free(Json_arena* arena, void* p)
+{
+    if (arena == NULL)
+        free(p);
+}
+
+static size_t _table_bytes(size_t capacity)
+{
+    return sizeof(Table) + emul(capacity - 1, sizeof(Pair));
+}
+
+static void _extend_table(Table** t, size_t new_capacity)
 {
     assert((*t)->capacity < new_capacity);
-    Table* new_table = table_create(new_capacity);
-    new_table->size = (*t)->size;
-    memcpy(new_table->pairs, (*t)->pairs, (*t)->size*sizeof(Pair));
-    free(*t);
-    *t = new_table;
+    Json_arena* arena = (*t)->arena;
+    if (arena == NULL) {
+        *t = (Table*) erealloc(*t, _table_bytes(new_capacity));
+    } else {
+        Table* new_table = (Table*) json_arena_alloc(arena,
+                                                     _table_bytes(new_capacity));
+        memcpy(new_table, *t, _table_bytes((*t)->size));
+        *t = new_table;
+    }
+    (*t)->capacity = new_capacity;
 }
 
-static int _keys_are_equal(const char* s, const char* t)
+// Tests whether the key of `p` is `key`, which is interned if `interned` is
+// set. Two interned keys are equal only if they are the same key.
+static int _keys_are_equal(const Pair* p, const char* key, int interned)
 {
+    if (p->interned && interned) {
+        return p->key == key;
+    }
     // Null keys can never equal other keys, not even other null keys.
-    return s && t && strcmp(s, t) == 0;
+    return p->key && key && strcmp(p->key, key) == 0;
+}
+
+// FNV-1a hash of a nul-terminated key.
+static unsigned _hash_key(const char* key)
+{
+    unsigned h = 2166136261u;
+    for (; *key != '\0'; key++) {
+        h ^= (unsigned char) *key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Records pair number `pos` (which must have a non-null key) in the index.
+static void _index_insert(Table* t, size_t pos)
+{
+    size_t i = t->pairs[pos].hash & t->index_mask;
+    while (t->index[i] != _no_pair) {
+        i = (i + 1) & t->index_mask;
+    }
+    t->index[i] = pos;
+}
+
+// (Re)builds the hash index of `t` with `slots` slots; `slots` must be a power
+// of two comfortably larger than the number of entries. Key hashes are only
+// computed the first time; after that they are cached in the pairs.
+static void _build_index(Table* t, size_t slots)
+{
+    const int first_time = t->index == NULL;
+    size_t i;
+
+    _free(t->arena, t->index);
+    t->index = (size_t*) _alloc(t->arena, emul(slots, sizeof(size_t)));
+    t->index_mask = slots - 1;
+    for (i = 0; i < slots; i++) {
+        t->index[i] = _no_pair;
+    }
+    for (i = 0; i < t->size; i++) {
+        if (t->pairs[i].key != NULL) {
+            if (first_time && !t->pairs[i].interned)
+                t->pairs[i].hash = _hash_key(t->pairs[i].key);
+            _index_insert(t, i);
+        }
+    }
+}
+
+// Returns the position of `key` in `t`, or _no_pair if it is not present.
+// `interned` says whether `key` is interned, and `hash` is its hash, which
+// is needed only if `t` is indexed.
+static size_t _find_key(const Table* t,
+                        const char* key,
+                        int interned,
+                        unsigned hash)
+{
+    size_t i;
+
+    if (t->index == NULL) {
+        for (i = 0; i < t->size; i++) {
+            if (_keys_are_equal(&t->pairs[i], key, interned)) {
+                return i;
+            }
+        }
+        return _no_pair;
+    }
+
+    for (i = hash & t->index_mask; t->index[i] != _no_pair;
+         i = (i + 1) & t->index_mask)
+    {
+        const Pair* p = &t->pairs[t->index[i]];
+        if (p->hash == hash && _keys_are_equal(p, key, interned)) {
+            return t->index[i];
+        }
+    }
+    return _no_pair;
+}
+
+// Returns the hash of `key` (which is interned if `interned` is set) for
+// _find_key in `t`, or zero if it is not needed.
+static unsigned _hash_for(const Table* t, const char* key, int interned)
+{
+    if (interned) {
+        return intern_hash(key);
+    }
+    return t->index ? _hash_key(key) : 0;
 }
 
 // +-----------+
 // | Table API |
 // +-----------+
 
-Table* table_create(int size_hint)
+Table* table_create(size_t size_hint)
 {
-    const int capacity = size_hint > 0 ? size_hint : 4;
-    Table* t = (Table*) emalloc(2*sizeof(int) + capacity*sizeof(Pair));
+    return table_create_in(NULL, size_hint);
+}
+
+Table* table_create_in(Json_arena* arena, size_t size_hint)
+{
+    const size_t capacity = size_hint > 0 ? size_hint : 4;
+    Table* t = (Table*) _alloc(arena, _table_bytes(capacity));
+    t->arena = arena;
+    t->refs = 1;
     t->capacity = capacity;
     t->size = 0;
+    t->n_keys = 0;
+    t->index = NULL;
+    t->index_mask = 0;
     return t;
 }
 
 void table_destroy(Table* t, void (*destroy_value)(void*))
 {
     assert(t);
-    int i;
+    size_t i;
+
+    // The last reference can be dropped without an atomic operation, as no
+    // one else can be adding one.
+    if (__atomic_load_n(&t->refs, __ATOMIC_ACQUIRE) != 1
+        && __atomic_sub_fetch(&t->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    {
+        return;
+    }
     for (i = 0; i < t->size; i++) {
-        free(t->pairs[i].key);
+        if (t->pairs[i].owns_key)
+            _free(t->arena, t->pairs[i].key);
         if (destroy_value != NULL)
             destroy_value(t->pairs[i].value);
     }
-    free(t);
+    _free(t->arena, t->index);
+    _free(t->arena, t);
 }
 
-void* table_set_key(Table** t, const char* key, void* value)
+Table* table_share(Table* t)
+{
+    assert(t->arena == NULL);
+    __atomic_add_fetch(&t->refs, 1, __ATOMIC_RELAXED);
+    return t;
+}
+
+int table_is_shared(const Table* t)
+{
+    return __atomic_load_n(&t->refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+Table* table_clone(const Table* t, void* (*copy_value)(const void*))
 {
-    // If a key was given, search for it and overwrite its value if found.
+    Table* clone = table_create(t->capacity);
+    size_t i;
+
+    memcpy(clone->pairs, t->pairs, t->size * sizeof(Pair));
+    clone->size = t->size;
+    clone->n_keys = t->n_keys;
+    for (i = 0; i < t->size; i++) {
+        Pair* p = &clone->pairs[i];
+        if (p->key != NULL && !p->interned) {
+            p->key = estrdup(p->key);
+            p->owns_key = 1;
+        }
+        p->value = copy_value(p->value);
+    }
+    if (t->index != NULL) {
+        const size_t slots = t->index_mask + 1;
+        clone->index = (size_t*) emalloc(emul(slots, sizeof(size_t)));
+        memcpy(clone->index, t->index, slots * sizeof(size_t));
+        clone->index_mask = t->index_mask;
+    }
+    return clone;
+}
+
+// Does the work of table_set_key and table_set_key_nocopy.
+static void* _set_key(Table** t, const char* key, void* value, int copy_key)
+{
+    int interned = 0;
+    unsigned hash = 0;
+
+    // If a key was given, search for it and overwrite its value if found. A
+    // key that would be copied is interned instead where possible.
     if (key != NULL) {
-        int i;
-        for (i = 0; i < (*t)->size; i++) {
-            if (_keys_are_equal((*t)->pairs[i].key, key)) {
-                void* old_value = (*t)->pairs[i].value;
-                (*t)->pairs[i].value = value;
-                return old_value;
-            }
+        const char* k;
+        if (intern_contains(key)) {
+            interned = 1;
+        } else if (copy_key && (k = intern_key(key, strlen(key))) != NULL) {
+            key = k;
+            interned = 1;
+            copy_key = 0;
+        }
+        hash = _hash_for(*t, key, interned);
+        const size_t i = _find_key(*t, key, interned, hash);
+        if (i != _no_pair) {
+            void* old_value = (*t)->pairs[i].value;
+            (*t)->pairs[i].value = value;
+            return old_value;
         }
     }
 
     // If the table is full, double its capacity.
     if ((*t)->capacity <= (*t)->size)
-        _extend_table(t, (*t)->capacity * 2);
+        _extend_table(t, egrow((*t)->capacity, (*t)->size + 1));
 
     // Add the key-value pair to the end of the table.
-    (*t)->pairs[(*t)->size].key = estrdup(key);
-    (*t)->pairs[(*t)->size].value = value;
-    (*t)->size++;
+    const size_t pos = (*t)->size++;
+    if (copy_key) {
+        (*t)->pairs[pos].key = (*t)->arena
+            ? json_arena_strdup((*t)->arena, key)
+            : estrdup(key);
+    } else {
+        (*t)->pairs[pos].key = (char*) key;
+    }
+    (*t)->pairs[pos].value = value;
+    (*t)->pairs[pos].hash = hash;
+    (*t)->pairs[pos].owns_key = copy_key;
+    (*t)->pairs[pos].interned = interned;
+
+    // Keep the index at most half full; build it once the table's keys
+    // outgrow a linear search.
+    if (key != NULL && ++(*t)->n_keys > table_index_threshold) {
+        if ((*t)->index == NULL)
+            _build_index(*t, 4*table_index_threshold);
+        else if (2*(*t)->n_keys > (*t)->index_mask + 1)
+            _build_index(*t, egrow((*t)->index_mask + 1, 2*(*t)->n_keys));
+        else
+            _index_insert(*t, pos);
+    }
 
     return NULL;
 }
 
-int table_get_size(const Table *t)
+void* table_set_key(Table** t, const char* key, void* value)
+{
+    return _set_key(t, key, value, 1);
+}
+
+void* table_set_key_nocopy(Table** t, const char* key, void* value)
+{
+    return _set_key(t, key, value, 0);
+}
+
+const void* table_get_key(const Table* t, const char* key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+    const int interned = intern_contains(key);
+    const size_t i = _find_key(t, key, interned, _hash_for(t, key, interned));
+    return i != _no_pair ? t->pairs[i].value : NULL;
+}
+
+size_t table_get_size(const Table *t)
 {
     return t->size;
 }
 
+const void* table_get_value_at(const Table* t, size_t i)
+{
+    assert(i < t->size);
+    return t->pairs[i].value;
+}
+
+void* table_set_value_at(Table* t, size_t i, void* value)
+{
+    assert(i < t->size);
+    void* old_value = t->pairs[i].value;
+    t->pairs[i].value = value;
+    return old_value;
+}
+
 // +--------------------+
 // | Table_iterator API |
 // +--------------------+
 
 struct Table_iterator {
     const Table* table; // table over which we are iterating
-    int pos;            // current position in iteration
+    size_t pos;         // current position in iteration
 };
 
 Table_iterator* table_iterator_create(const Table* t)
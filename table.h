@@ -9,28 +9,67 @@
 #ifndef __INCLUDED_LIBJSON_TABLE__
 #define __INCLUDED_LIBJSON_TABLE__
 
-// Simple O(N)-lookup table for (string, void*) pairs.
+// Insertion-ordered table for (string, void*) pairs. Small tables are searched
+// linearly; larger ones maintain a hash index for amortized O(1) lookups.
+// Interned keys (see intern.h) are compared by address.
+
+#include "arena.h"
 
 typedef struct Table Table;
 typedef struct Table_iterator Table_iterator;
 
-// Creates an empty table. If `size_hint` is non-positive it will be ignored;
+// Creates an empty table. If `size_hint` is zero it will be ignored;
 // otherwise, it hints at the maximum number of key-value pairs the table will
 // contain.
-Table* table_create(int size_hint);
+Table* table_create(size_t size_hint);
+
+// Like table_create, but the table, its keys and its index are allocated from
+// `arena` (or the heap if `arena` is null). Such a table is never freed
+// piecemeal; table_destroy only calls `destroy_value` for its values.
+Table* table_create_in(Json_arena* arena, size_t size_hint);
 
 // Destroys a table created by table_create. `destroy_value` will be called
-// for each value stored in the table.
+// for each value stored in the table. A shared table (see table_share) is
+// only destroyed along with its last reference; before that, this just
+// drops one.
 void table_destroy(Table* t, void (*destroy_value)(void*));
 
+// Adds a reference to the heap table `t`, which is then shared: it must not
+// be changed until the other references are dropped. Returns `t`. Tables
+// are counted atomically, so the references may be held and dropped by any
+// number of threads.
+Table* table_share(Table* t);
+
+// Returns nonzero if more than one reference to `t` is held.
+int table_is_shared(const Table* t);
+
+// Returns a new heap table with the same pairs as `t`, in the same order,
+// except that each value is passed through `copy_value` first.
+Table* table_clone(const Table* t, void* (*copy_value)(const void*));
+
 // Sets the given key-value pair in the table `t`. If the key is null, the
 // value will be appended without a key; otherwise, the key-value pair will be
-// inserted (or overwritten if the key is already in the table). Returns the
-// old value if the key was overwritten, null otherwise.
+// inserted (or overwritten if the key is already in the table). The table
+// refers to the interned copy of the key if it can be interned, and keeps a
+// copy of its own if not. Returns the old value if the key was overwritten,
+// null otherwise.
 void* table_set_key(Table** t, const char* key, void* value);
 
+// Like table_set_key, but if the pair is inserted, the table refers to `key`
+// rather than a copy of it; the caller must keep `key` alive until the table
+// is destroyed.
+void* table_set_key_nocopy(Table** t, const char* key, void* value);
+
+// Returns the value stored under `key`, or null if there is no such key.
+const void* table_get_key(const Table* t, const char* key);
+
 // Returns the number of entries in the given table.
-int table_get_size(const Table *t);
+size_t table_get_size(const Table *t);
+
+// Returns or replaces the value of entry number `i` (in insertion order),
+// which must exist. table_set_value_at returns the old value.
+const void* table_get_value_at(const Table* t, size_t i);
+void* table_set_value_at(Table* t, size_t i, void* value);
 
 // Table_iterator API
 Table_iterator* table_iterator_create(const Table* t);
@@ -9,6 +9,7 @@
 #include "table.h"
 #include "munit.h"
 #include "utilities.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -129,6 +130,106 @@ static void test_overwrite_key()
     table_destroy(t, free);
 }
 
+static void test_get_key()
+{
+    Table* t = table_create(0);
+    table_set_key(&t, "foo", estrdup("bar"));
+    table_set_key(&t, NULL, estrdup("null key"));
+    mu_assert(strcmp((char*) table_get_key(t, "foo"), "bar") == 0);
+    mu_assert(table_get_key(t, "bar") == NULL);
+    mu_assert(table_get_key(t, NULL) == NULL);
+    table_destroy(t, free);
+}
+
+static void test_many_keys()
+{
+    const int n = 1000;
+    char key[32];
+    int i;
+
+    // Enough keys to force the hash index to be built and grown repeatedly.
+    Table* t = table_create(0);
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", i);
+        table_set_key(&t, key, estrdup(key));
+        if (i % 7 == 0)
+            table_set_key(&t, NULL, estrdup("null key"));
+    }
+    mu_assert(table_get_size(t) == n + (n+6)/7);
+
+    // Overwriting must not disturb the order of insertion.
+    for (i = 0; i < n; i += 3) {
+        sprintf(key, "key%d", i);
+        free(table_set_key(&t, key, estrdup("overwritten")));
+    }
+    mu_assert(table_get_size(t) == n + (n+6)/7);
+
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", i);
+        const char* v = (const char*) table_get_key(t, key);
+        mu_assert(v != NULL);
+        mu_assert(strcmp(v, i % 3 == 0 ? "overwritten" : key) == 0);
+    }
+    mu_assert(table_get_key(t, "key1000") == NULL);
+
+    Table_iterator* it = table_iterator_create(t);
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", i);
+        mu_assert(strcmp(table_iterator_curr_key(it), key) == 0);
+        table_iterator_advance(it);
+        if (i % 7 == 0) {
+            mu_assert(table_iterator_curr_key(it) == NULL);
+            table_iterator_advance(it);
+        }
+    }
+    mu_assert(!table_iterator_is_valid(it));
+    table_iterator_destroy(it);
+    table_destroy(t, free);
+}
+
+static void* copy_string(const void* s)
+{
+    return estrdup((const char*) s);
+}
+
+static void test_share_and_clone()
+{
+    const int n = 20;
+    char key[32];
+    int i;
+
+    Table* t = table_create(0);
+    table_set_key(&t, NULL, estrdup("null key"));
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", i);
+        table_set_key(&t, key, estrdup(key));
+    }
+    mu_assert(!table_is_shared(t));
+    mu_assert(table_share(t) == t && table_is_shared(t));
+
+    // The clone is indexed as the table is, and changes independently.
+    Table* c = table_clone(t, copy_string);
+    mu_assert(!table_is_shared(c));
+    free(table_set_key(&c, "key3", estrdup("overwritten")));
+    free(table_set_value_at(c, 0, estrdup("first")));
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", i);
+        mu_assert(strcmp((const char*) table_get_key(t, key), key) == 0);
+        mu_assert(strcmp((const char*) table_get_key(c, key),
+                         i == 3 ? "overwritten" : key) == 0);
+    }
+    mu_assert(strcmp((const char*) table_get_value_at(t, 0),
+                     "null key") == 0);
+    mu_assert(strcmp((const char*) table_get_value_at(c, 0), "first") == 0);
+    table_destroy(c, free);
+
+    // The first destroy drops the extra reference; the second, the table.
+    table_destroy(t, free);
+    mu_assert(!table_is_shared(t));
+    mu_assert(table_get_size(t) == n + 1);
+    table_destroy(t, free);
+}
+
 static void run_all_tests()
 {
     mu_run_test(test_new_table);
@@ -137,6 +238,9 @@ static void run_all_tests()
     mu_run_test(test_null_key);
     mu_run_test(test_mixed_keys);
     mu_run_test(test_overwrite_key);
+    mu_run_test(test_get_key);
+    mu_run_test(test_many_keys);
+    mu_run_test(test_share_and_clone);
 }
 
 int main()
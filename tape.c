@@ -0,0 +1,667 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "tape.h"
+#include "utilities.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Each word of the tape has a tag in its top byte and a payload below it:
+//
+//   null, true, false     one word; no payload
+//   number                two words; the second holds the double's bits
+//   string, key           two words; the payload is the offset of the text
+//                         in `strings`, and the second word its length
+//   start_array/object    one word; the payload is the position just past
+//                         the matching end word
+//   end_array/object      one word; the payload is the number of members
+//
+// Members of objects are a key followed by a value.
+typedef enum Tag Tag;
+enum Tag {
+    tag_null = 1,
+    tag_true,
+    tag_false,
+    tag_number,
+    tag_string,
+    tag_key,
+    tag_start_array,
+    tag_end_array,
+    tag_start_object,
+    tag_end_object,
+};
+
+enum { tag_shift = 56 };
+
+#define PAYLOAD_MASK ((UINT64_C(1) << tag_shift) - 1)
+
+struct Json_tape {
+    uint64_t* words;
+    size_t n_words;
+    size_t size;
+    char* strings;          // nul-terminated, one after another
+    size_t strings_length;
+    size_t strings_size;
+
+    // For a tape read from an image, `words` and `strings` point into the
+    // image instead of the heap, and `mapping` is the image's file mapping,
+    // if it has one.
+    int from_image;
+    void* mapping;
+    size_t mapping_size;
+};
+
+static Tag _tag(const Json_tape* t, size_t v)
+{
+    assert(v < t->n_words);
+    return (Tag) (t->words[v] >> tag_shift);
+}
+
+static size_t _payload(const Json_tape* t, size_t v)
+{
+    return (size_t) (t->words[v] & PAYLOAD_MASK);
+}
+
+//
+// +----------+
+// | building |
+// +----------+
+//
+
+typedef struct Builder Builder;
+struct Builder {
+    Json_tape* tape;
+    size_t* open;           // positions of the unclosed arrays and objects
+    size_t* counts;         // and how many members each has so far
+    size_t depth;
+    size_t size;            // capacity of `open` and `counts`
+};
+
+static void _emit_word(Json_tape* t, uint64_t word)
+{
+    if (t->n_words == t->size) {
+        t->size = egrow(t->size, t->n_words + 1);
+        t->words = (uint64_t*) erealloc(t->words,
+                                        emul(t->size, sizeof(uint64_t)));
+    }
+    t->words[t->n_words++] = word;
+}
+
+static void _emit(Json_tape* t, Tag tag, uint64_t payload)
+{
+    assert(payload <= PAYLOAD_MASK);
+    _emit_word(t, ((uint64_t) tag << tag_shift) | payload);
+}
+
+// Counts a value as a member of the innermost array or object, if any.
+static void _count(Builder* b)
+{
+    if (b->depth > 0)
+        b->counts[b->depth - 1]++;
+}
+
+static int _emit_text(Builder* b, Tag tag, const char* s, size_t length)
+{
+    Json_tape* t = b->tape;
+
+    if (t->strings_length + length + 1 > t->strings_size) {
+        t->strings_size = egrow(t->strings_size,
+                                t->strings_length + length + 1);
+        t->strings = (char*) erealloc(t->strings, t->strings_size);
+    }
+    _emit(t, tag, t->strings_length);
+    _emit_word(t, length);
+    memcpy(t->strings + t->strings_length, s, length);
+    t->strings[t->strings_length + length] = '\0';
+    t->strings_length += length + 1;
+    return 1;
+}
+
+static int _open(Builder* b, Tag tag)
+{
+    _count(b);
+    if (b->depth == b->size) {
+        b->size = egrow(b->size, b->depth + 1);
+        b->open = (size_t*) erealloc(b->open, emul(b->size, sizeof(size_t)));
+        b->counts = (size_t*) erealloc(b->counts,
+                                       emul(b->size, sizeof(size_t)));
+    }
+    b->open[b->depth] = b->tape->n_words;
+    b->counts[b->depth] = 0;
+    b->depth++;
+    _emit(b->tape, tag, 0);
+    return 1;
+}
+
+static int _close(Builder* b, Tag tag)
+{
+    Json_tape* t = b->tape;
+
+    assert(b->depth > 0);
+    b->depth--;
+    _emit(t, tag, b->counts[b->depth]);
+    t->words[b->open[b->depth]] |= t->n_words;
+    return 1;
+}
+
+static int _start_object(void* context)
+{
+    return _open((Builder*) context, tag_start_object);
+}
+
+static int _end_object(void* context)
+{
+    return _close((Builder*) context, tag_end_object);
+}
+
+static int _start_array(void* context)
+{
+    return _open((Builder*) context, tag_start_array);
+}
+
+static int _end_array(void* context)
+{
+    return _close((Builder*) context, tag_end_array);
+}
+
+static int _key(void* context, const char* key, size_t length)
+{
+    return _emit_text((Builder*) context, tag_key, key, length);
+}
+
+static int _string(void* context, const char* s, size_t length)
+{
+    _count((Builder*) context);
+    return _emit_text((Builder*) context, tag_string, s, length);
+}
+
+static int _number(void* context, double n)
+{
+    Builder* b = (Builder*) context;
+    uint64_t bits;
+
+    memcpy(&bits, &n, sizeof(bits));
+    _count(b);
+    _emit(b->tape, tag_number, 0);
+    _emit_word(b->tape, bits);
+    return 1;
+}
+
+static int _boolean(void* context, int v)
+{
+    Builder* b = (Builder*) context;
+    _count(b);
+    _emit(b->tape, v ? tag_true : tag_false, 0);
+    return 1;
+}
+
+static int _null(void* context)
+{
+    Builder* b = (Builder*) context;
+    _count(b);
+    _emit(b->tape, tag_null, 0);
+    return 1;
+}
+
+static const Json_handler _builder_handler = {
+    _start_object,
+    _end_object,
+    _start_array,
+    _end_array,
+    _key,
+    _string,
+    _number,
+    _boolean,
+    _null,
+};
+
+Json_tape* json_tape_parse(const char* input, Json_parse_error* errorp)
+{
+    Json_tape* t = (Json_tape*) emalloc(sizeof(Json_tape));
+    Builder b;
+    int ok;
+
+    t->size = 64;
+    t->n_words = 0;
+    t->words = (uint64_t*) emalloc(t->size * sizeof(uint64_t));
+    t->strings_size = 256;
+    t->strings_length = 0;
+    t->strings = (char*) emalloc(t->strings_size);
+    t->from_image = 0;
+    t->mapping = NULL;
+    t->mapping_size = 0;
+
+    b.tape = t;
+    b.depth = 0;
+    b.size = 0;
+    b.open = NULL;
+    b.counts = NULL;
+
+    ok = json_parse_events(input, &_builder_handler, &b, errorp);
+    free(b.open);
+    free(b.counts);
+
+    if (!ok) {
+        json_tape_destroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void json_tape_destroy(Json_tape* t)
+{
+    if (!t) return;
+
+    if (t->mapping) {
+        munmap(t->mapping, t->mapping_size);
+    }
+    if (!t->from_image) {
+        free(t->words);
+        free(t->strings);
+    }
+    free(t);
+}
+
+//
+// +-----------+
+// | accessors |
+// +-----------+
+//
+
+Json_type json_tape_get_type(const Json_tape* t, size_t v)
+{
+    switch (_tag(t, v)) {
+    case tag_null:
+        return json_type_null;
+    case tag_true:
+    case tag_false:
+        return json_type_bool;
+    case tag_number:
+        return json_type_number;
+    case tag_string:
+        return json_type_string;
+    case tag_start_array:
+        return json_type_array;
+    case tag_start_object:
+        return json_type_object;
+    default:
+        break;
+    }
+    assert(0);  // not the position of a value
+    return json_type_null;
+}
+
+const char* json_tape_get_cstr(const Json_tape* t, size_t v)
+{
+    assert(_tag(t, v) == tag_string || _tag(t, v) == tag_key);
+    return t->strings + _payload(t, v);
+}
+
+size_t json_tape_get_cstr_length(const Json_tape* t, size_t v)
+{
+    assert(_tag(t, v) == tag_string || _tag(t, v) == tag_key);
+    return (size_t) t->words[v + 1];
+}
+
+double json_tape_get_double(const Json_tape* t, size_t v)
+{
+    double n;
+
+    assert(_tag(t, v) == tag_number);
+    memcpy(&n, &t->words[v + 1], sizeof(n));
+    return n;
+}
+
+int json_tape_get_bool(const Json_tape* t, size_t v)
+{
+    assert(_tag(t, v) == tag_true || _tag(t, v) == tag_false);
+    return _tag(t, v) == tag_true;
+}
+
+size_t json_tape_count_members(const Json_tape* t, size_t v)
+{
+    assert(_tag(t, v) == tag_start_array || _tag(t, v) == tag_start_object);
+    return _payload(t, _payload(t, v) - 1);
+}
+
+size_t json_tape_get_key(const Json_tape* t, size_t object, const char* k)
+{
+    const size_t length = strlen(k);
+    const size_t end = _payload(t, object) - 1;
+    size_t pos;
+
+    assert(_tag(t, object) == tag_start_object);
+    for (pos = object + 1; pos < end; pos = json_tape_skip(t, pos + 2)) {
+        if ((size_t) t->words[pos + 1] == length
+            && memcmp(t->strings + _payload(t, pos), k, length) == 0)
+        {
+            return pos + 2;
+        }
+    }
+    return 0;
+}
+
+size_t json_tape_skip(const Json_tape* t, size_t v)
+{
+    switch (_tag(t, v)) {
+    case tag_null:
+    case tag_true:
+    case tag_false:
+        return v + 1;
+    case tag_number:
+    case tag_string:
+        return v + 2;
+    case tag_start_array:
+    case tag_start_object:
+        return _payload(t, v);
+    default:
+        break;
+    }
+    assert(0);  // not the position of a value
+    return v + 1;
+}
+
+//
+// +-----------+
+// | iterators |
+// +-----------+
+//
+
+void json_tape_iterator_init(Json_tape_iterator* iter,
+                             const Json_tape* t,
+                             size_t v)
+{
+    assert(_tag(t, v) == tag_start_array || _tag(t, v) == tag_start_object);
+    iter->tape = t;
+    iter->pos = v + 1;
+    iter->end = _payload(t, v) - 1;
+    iter->object = _tag(t, v) == tag_start_object;
+}
+
+void json_tape_iterator_advance(Json_tape_iterator* iter)
+{
+    assert(json_tape_iterator_is_valid(iter));
+    iter->pos = json_tape_skip(iter->tape,
+                               json_tape_iterator_curr_value(iter));
+}
+
+int json_tape_iterator_is_valid(const Json_tape_iterator* iter)
+{
+    return iter->pos < iter->end;
+}
+
+const char* json_tape_iterator_curr_key(const Json_tape_iterator* iter)
+{
+    assert(json_tape_iterator_is_valid(iter));
+    return iter->object ? json_tape_get_cstr(iter->tape, iter->pos) : NULL;
+}
+
+size_t json_tape_iterator_curr_value(const Json_tape_iterator* iter)
+{
+    assert(json_tape_iterator_is_valid(iter));
+    return iter->object ? iter->pos + 2 : iter->pos;
+}
+
+//
+// +--------+
+// | images |
+// +--------+
+//
+
+// An image is this header, then the words of the tape, then its strings.
+typedef struct Image_header Image_header;
+struct Image_header {
+    char magic[8];          // image_magic, without its nul
+    uint32_t version;       // image_version
+    uint32_t byte_order;    // image_byte_order, as the writer stored it
+    uint64_t n_words;
+    uint64_t strings_length;
+};
+
+static const char image_magic[] = "JSONTAPE";
+enum { image_version = 1 };
+enum { image_byte_order = 0x01020304 };
+
+// Position returned by _check_tape for a valid tape.
+static const size_t _valid = (size_t) -1;
+
+// An array or object being checked by _check_tape.
+typedef struct Check_frame Check_frame;
+struct Check_frame {
+    size_t close;           // position of its end word
+    size_t count;           // of its members so far
+    int object;
+    int want_key;           // is a key next (in an object)?
+};
+
+// Checks that the `length` bytes of the string at `pos` lie within the
+// strings and are followed by a nul.
+static int _check_text(const Json_tape* t, size_t pos)
+{
+    const size_t offset = _payload(t, pos);
+    const uint64_t length = t->words[pos + 1];
+
+    return offset < t->strings_length
+        && length < t->strings_length - offset
+        && t->strings[offset + length] == '\0';
+}
+
+// Checks the tape of an image word by word, so that its accessors and
+// iterators can trust it as they trust a tape they built: that it holds one
+// value, that every array and object ends where its start says, with an end
+// word of the right kind and count, that objects alternate keys and values,
+// and that every string lies within the strings. Returns the position of
+// the first word found wrong, or _valid.
+static size_t _check_tape(const Json_tape* t)
+{
+    Check_frame* frames = NULL;
+    size_t depth = 0, size = 0;
+    size_t pos = 0;
+
+    if (t->n_words == 0)
+        return 0;
+
+    do {
+        Check_frame* top = depth > 0 ? &frames[depth - 1] : NULL;
+        const size_t close = top ? top->close : t->n_words;
+        const Tag tag = _tag(t, pos);
+        size_t end;
+
+        if (top && pos == close) {
+            const Tag expected = top->object ? tag_end_object : tag_end_array;
+            if (tag != expected || _payload(t, pos) != top->count
+                || !top->want_key)
+            {
+                break;
+            }
+            pos++;
+            depth--;
+            continue;
+        }
+        if (top && top->object && top->want_key) {
+            if (tag != tag_key || pos + 2 > close || !_check_text(t, pos))
+                break;
+            top->want_key = 0;
+            pos += 2;
+            continue;
+        }
+        if (top) {
+            top->count++;
+            top->want_key = 1;
+        }
+
+        switch (tag) {
+        case tag_null:
+        case tag_true:
+        case tag_false:
+            pos++;
+            continue;
+        case tag_number:
+            if (pos + 2 > close)
+                break;
+            pos += 2;
+            continue;
+        case tag_string:
+            if (pos + 2 > close || !_check_text(t, pos))
+                break;
+            pos += 2;
+            continue;
+        case tag_start_array:
+        case tag_start_object:
+            end = _payload(t, pos);
+            if (end < pos + 2 || end > close)
+                break;
+            if (depth == size) {
+                size = egrow(size ? size : 16, depth + 1);
+                frames = (Check_frame*) erealloc(
+                    frames, emul(size, sizeof(Check_frame)));
+            }
+            frames[depth].close = end - 1;
+            frames[depth].count = 0;
+            frames[depth].object = tag == tag_start_object;
+            frames[depth].want_key = 1;
+            depth++;
+            pos++;
+            continue;
+        default:
+            break;
+        }
+        break;
+    } while (depth > 0);
+
+    free(frames);
+    return depth == 0 && pos == t->n_words ? _valid : pos;
+}
+
+// Reports that an image is invalid at the byte offset `offset`.
+static Json_tape* _image_error(Json_parse_error* errorp,
+                               Json_parse_error_code code,
+                               size_t offset)
+{
+    if (errorp) {
+        errorp->code = code;
+        errorp->line = 0;
+        errorp->column = offset;
+        errorp->expected_token_types[0] = json_token_type_error;
+        errorp->actual_token_type = json_token_type_error;
+    }
+    return NULL;
+}
+
+int json_tape_write_image(const Json_tape* t, Json_sink* sink)
+{
+    Image_header h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, image_magic, sizeof(h.magic));
+    h.version = image_version;
+    h.byte_order = image_byte_order;
+    h.n_words = t->n_words;
+    h.strings_length = t->strings_length;
+
+    json_sink_write(sink, (const char*) &h, sizeof(h));
+    json_sink_write(sink, (const char*) t->words,
+                    t->n_words * sizeof(uint64_t));
+    json_sink_write(sink, t->strings, t->strings_length);
+    return json_sink_flush(sink);
+}
+
+Json_tape* json_tape_from_image(const char* image,
+                                size_t length,
+                                Json_parse_error* errorp)
+{
+    Image_header h;
+    size_t bad;
+
+    if ((uintptr_t) image % sizeof(uint64_t) != 0 || length < sizeof(h)) {
+        return _image_error(errorp, json_parse_error_invalid_image, 0);
+    }
+    memcpy(&h, image, sizeof(h));
+    if (memcmp(h.magic, image_magic, sizeof(h.magic)) != 0
+        || h.version != image_version
+        || h.byte_order != image_byte_order)
+    {
+        return _image_error(errorp, json_parse_error_invalid_image, 0);
+    }
+    const size_t most_words = (length - sizeof(h)) / sizeof(uint64_t);
+    if (h.n_words > most_words
+        || h.strings_length
+           != length - sizeof(h) - h.n_words * sizeof(uint64_t))
+    {
+        return _image_error(errorp, json_parse_error_invalid_image,
+                            offsetof(Image_header, n_words));
+    }
+
+    Json_tape* t = (Json_tape*) emalloc(sizeof(Json_tape));
+    t->words = (uint64_t*) (image + sizeof(h));
+    t->n_words = t->size = h.n_words;
+    t->strings = (char*) (image + sizeof(h)) + h.n_words * sizeof(uint64_t);
+    t->strings_length = t->strings_size = h.strings_length;
+    t->from_image = 1;
+    t->mapping = NULL;
+    t->mapping_size = 0;
+
+    if ((bad = _check_tape(t)) != _valid) {
+        free(t);
+        return _image_error(errorp, json_parse_error_invalid_image,
+                            sizeof(h) + bad * sizeof(uint64_t));
+    }
+    return t;
+}
+
+Json_tape* json_tape_map(const char* path, Json_parse_error* errorp)
+{
+    struct stat st;
+    void* map;
+    int fd;
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return _image_error(errorp, json_parse_error_io, 0);
+    }
+    if (fstat(fd, &st) != 0) {
+        const int saved = errno;
+        close(fd);
+        errno = saved;
+        return _image_error(errorp, json_parse_error_io, 0);
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return _image_error(errorp, json_parse_error_invalid_image, 0);
+    }
+
+    // The mapping is shared, so that every process that maps the image uses
+    // the same pages of the page cache.
+    const size_t size = st.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    const int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved;
+        return _image_error(errorp, json_parse_error_io, 0);
+    }
+
+    Json_tape* t = json_tape_from_image((const char*) map, size, errorp);
+    if (t == NULL) {
+        munmap(map, size);
+        return NULL;
+    }
+    t->mapping = map;
+    t->mapping_size = size;
+    return t;
+}
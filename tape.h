@@ -0,0 +1,106 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#ifndef __INCLUDED_LIBJSON_TAPE__
+#define __INCLUDED_LIBJSON_TAPE__
+
+// Flat, read-only documents. A Json_value is a tree of separately allocated
+// nodes, which reading it chases from one to the next; a tape holds the whole
+// document in one array of 64-bit words, in document order, with the bytes
+// of its strings and keys in one other buffer. Each array and object records
+// where it ends, so that it can be skipped in constant time, and how many
+// members it has. Reading a tape from start to end therefore reads memory
+// from start to end.
+//
+// Values are denoted by their positions in the tape, the root being at 0.
+// The accessors and iterators mirror those of Json_value (see json.h), and
+// expect values of the same types.
+
+#include "json.h"
+#include "parser.h"
+#include "sink.h"
+
+typedef struct Json_tape Json_tape;
+
+// Parses `input` into a tape, accepting what json_parse accepts and reporting
+// the same errors. Returns null on error.
+Json_tape* json_tape_parse(const char* input, Json_parse_error* errorp);
+
+// Releases the tape, unmapping its image if it was mapped.
+void json_tape_destroy(Json_tape* t);
+
+// Images. A tape refers to its contents by position and offset rather than
+// by address, so it can be saved as an image: a header followed by its
+// words and strings, as they are in memory. An image that is read back,
+// whether from memory or a file mapping, is used in place: nothing is
+// parsed or copied, and the accessors and iterators read its bytes
+// directly. Many processes that map the same image file therefore share one
+// copy of it in the page cache instead of each building its own document.
+//
+// Images are in the byte order of the machine that writes them, and are
+// rejected by machines of the other. As an image may come from anywhere, it
+// is checked when it is read, in one pass over its words (which brings them
+// into memory): its header must match its size, and its tape must be one
+// that json_tape_parse could have built. A failed check is reported as
+// json_parse_error_invalid_image (see parser.h), whose column is the offset
+// of the offending byte, or, for a bad header, of the field.
+
+// Writes `t` to `sink` as an image and flushes it. Returns zero on success
+// and nonzero if the sink failed.
+int json_tape_write_image(const Json_tape* t, Json_sink* sink);
+
+// Returns a tape that reads the `length` bytes of the image at `image`,
+// which must be aligned to 8 bytes and outlive the tape. Returns null if
+// the image is invalid.
+Json_tape* json_tape_from_image(const char* image,
+                                size_t length,
+                                Json_parse_error* errorp);
+
+// Maps the image file at `path` read-only and shared, and returns a tape
+// that reads it, or null on error. If the file cannot be opened or mapped,
+// the error is json_parse_error_io, and errno says why. The file is
+// unmapped by json_tape_destroy; it must not be modified meanwhile.
+Json_tape* json_tape_map(const char* path, Json_parse_error* errorp);
+
+Json_type json_tape_get_type(const Json_tape* t, size_t v);
+const char* json_tape_get_cstr(const Json_tape* t, size_t v);
+size_t json_tape_get_cstr_length(const Json_tape* t, size_t v);
+double json_tape_get_double(const Json_tape* t, size_t v);
+int json_tape_get_bool(const Json_tape* t, size_t v);
+size_t json_tape_count_members(const Json_tape* t, size_t v);
+
+// Returns the value of the member of `object` with the key `k`, or 0 if there
+// is none (0 being the root, which is no member). Members are searched in
+// order, skipping their values.
+size_t json_tape_get_key(const Json_tape* t, size_t object, const char* k);
+
+// Returns the position just past the value `v`, which, if `v` is an element
+// or a member's value, is that of the next key or element, if any. Takes
+// constant time.
+size_t json_tape_skip(const Json_tape* t, size_t v);
+
+// Iterates over the elements of an array or the members of an object. The
+// fields are private; the structure is defined here so that an iterator can
+// live on the stack, and it needs no destroying.
+typedef struct Json_tape_iterator Json_tape_iterator;
+struct Json_tape_iterator {
+    const Json_tape* tape;
+    size_t pos;     // of the current element, or key
+    size_t end;     // of the word that closes the array or object
+    int object;     // iterating over an object?
+};
+
+void json_tape_iterator_init(Json_tape_iterator* iter,
+                             const Json_tape* t,
+                             size_t v);
+void json_tape_iterator_advance(Json_tape_iterator* iter);
+int json_tape_iterator_is_valid(const Json_tape_iterator* iter);
+const char* json_tape_iterator_curr_key(const Json_tape_iterator* iter);
+size_t json_tape_iterator_curr_value(const Json_tape_iterator* iter);
+
+#endif
@@ -0,0 +1,346 @@
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+#include "json.h"
+#include "parser.h"
+#include "tape.h"
+#include "munit.h"
+#include <errno.h>
+#include <glob.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Builds a Json_value from the value `v` of a tape, using only the tape's
+// accessors and iterators.
+static Json_value* to_value(const Json_tape* t, size_t v)
+{
+    Json_tape_iterator i;
+    Json_value* result;
+
+    switch (json_tape_get_type(t, v)) {
+    case json_type_null:
+        return json_value_new_null();
+    case json_type_bool:
+        return json_value_from_bool(json_tape_get_bool(t, v));
+    case json_type_number:
+        return json_value_from_double(json_tape_get_double(t, v));
+    case json_type_string:
+        return json_value_from_cstr(json_tape_get_cstr(t, v));
+    case json_type_array:
+        result = json_value_new_array(json_tape_count_members(t, v));
+        json_tape_iterator_init(&i, t, v);
+        for (; json_tape_iterator_is_valid(&i);
+             json_tape_iterator_advance(&i))
+        {
+            json_value_append(result,
+                to_value(t, json_tape_iterator_curr_value(&i)));
+        }
+        return result;
+    case json_type_object:
+        result = json_value_new_object(json_tape_count_members(t, v));
+        json_tape_iterator_init(&i, t, v);
+        for (; json_tape_iterator_is_valid(&i);
+             json_tape_iterator_advance(&i))
+        {
+            json_value_set_key(result, json_tape_iterator_curr_key(&i),
+                to_value(t, json_tape_iterator_curr_value(&i)));
+        }
+        return result;
+    }
+    return NULL;
+}
+
+// Tests that the tape of `input` reads as json_parse's result does.
+static int reads_like_json_parse(const char* input)
+{
+    Json_value* expected = json_parse(input, NULL);
+    Json_tape* t = json_tape_parse(input, NULL);
+    int ok = expected != NULL && t != NULL;
+
+    if (ok) {
+        Json_value* v = to_value(t, 0);
+        char* s = json_stringify(v);
+        char* e = json_stringify(expected);
+        ok = strcmp(s, e) == 0;
+        free(s);
+        free(e);
+        json_value_destroy(v);
+        json_tape_destroy(t);
+    }
+    json_value_destroy(expected);
+    return ok;
+}
+
+static void test_documents()
+{
+    mu_assert(reads_like_json_parse("null"));
+    mu_assert(reads_like_json_parse("-1.5e3"));
+    mu_assert(reads_like_json_parse("\"a\\tb\""));
+    mu_assert(reads_like_json_parse("[]"));
+    mu_assert(reads_like_json_parse("{}"));
+    mu_assert(reads_like_json_parse("[[[]], {}, [{}]]"));
+    mu_assert(reads_like_json_parse(
+        "[{\"id\": 1, \"name\": \"user 1\", \"active\": true, "
+        "\"tags\": [\"a\", \"b\"], \"address\": {\"zip\": null}}, "
+        "{\"id\": 2, \"name\": \"\", \"active\": false}]"));
+    mu_assert(reads_like_json_parse(
+        "{name: 'lenient', list: [1 2 3,], /* comment */ flag: true}"));
+}
+
+// Tests that the tape of `input` reads as json_parse's result does, or, if
+// json_parse rejects it, that the tape fails with the same error.
+static int parses_like_json_parse(const char* input)
+{
+    Json_parse_error expected, actual;
+
+    static const Json_handler no_events;
+
+    if (json_parse_events(input, &no_events, NULL, &expected))
+        return reads_like_json_parse(input);
+    return json_tape_parse(input, &actual) == NULL
+        && actual.code == expected.code
+        && actual.line == expected.line
+        && actual.column == expected.column;
+}
+
+// Reads the whole file at `path` into a nul-terminated buffer.
+static char* read_file(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    long n;
+
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    rewind(fp);
+    char* input = (char*) malloc(n + 1);
+    input[fread(input, 1, n, fp)] = '\0';
+    fclose(fp);
+    return input;
+}
+
+static void test_regression_inputs()
+{
+    glob_t g;
+    size_t i;
+
+    mu_assert(glob("tests/*.in", 0, NULL, &g) == 0);
+    for (i = 0; i < g.gl_pathc; i++) {
+        char* input = read_file(g.gl_pathv[i]);
+        mu_assert(parses_like_json_parse(input));
+        free(input);
+    }
+    globfree(&g);
+}
+
+static void test_errors()
+{
+    const char* inputs[] = { "", "[1, 2", "{\"a\" 1}", "[1] 2", "'open" };
+    int i;
+
+    for (i = 0; i < (int) (sizeof(inputs) / sizeof(inputs[0])); i++) {
+        mu_assert(json_parse(inputs[i], NULL) == NULL);
+        mu_assert(parses_like_json_parse(inputs[i]));
+        json_tape_destroy(json_tape_parse(inputs[i], NULL));
+    }
+}
+
+static void test_skip()
+{
+    const char* input = "[[1, [2, 3]], {\"a\": {\"b\": []}}, \"s\", 4, true]";
+    Json_tape* t = json_tape_parse(input, NULL);
+    size_t v = 1;
+
+    mu_assert(t != NULL);
+    mu_assert(json_tape_count_members(t, 0) == 5);
+    mu_assert(json_tape_get_type(t, v) == json_type_array);
+    mu_assert(json_tape_count_members(t, v) == 2);
+    v = json_tape_skip(t, v);
+    mu_assert(json_tape_get_type(t, v) == json_type_object);
+    mu_assert(json_tape_count_members(t, v) == 1);
+    v = json_tape_skip(t, v);
+    mu_assert(strcmp(json_tape_get_cstr(t, v), "s") == 0);
+    mu_assert(json_tape_get_cstr_length(t, v) == 1);
+    v = json_tape_skip(t, v);
+    mu_assert(json_tape_get_double(t, v) == 4);
+    v = json_tape_skip(t, v);
+    mu_assert(json_tape_get_bool(t, v));
+
+    // Past the last element is the end of the array.
+    Json_tape_iterator i;
+    json_tape_iterator_init(&i, t, 0);
+    mu_assert(json_tape_iterator_curr_key(&i) == NULL);
+    while (json_tape_iterator_curr_value(&i) != v) {
+        json_tape_iterator_advance(&i);
+    }
+    json_tape_iterator_advance(&i);
+    mu_assert(!json_tape_iterator_is_valid(&i));
+    json_tape_destroy(t);
+}
+
+static void test_get_key()
+{
+    const char* input =
+        "{\"a\": [1, 2, {\"b\": 0}], \"b\": {\"c\": \"x\"}, \"\": 3}";
+    Json_tape* t = json_tape_parse(input, NULL);
+    size_t b;
+
+    mu_assert(t != NULL);
+    mu_assert(json_tape_count_members(t, 0) == 3);
+    mu_assert(json_tape_count_members(t, json_tape_get_key(t, 0, "a")) == 3);
+    b = json_tape_get_key(t, 0, "b");
+    mu_assert(json_tape_get_type(t, b) == json_type_object);
+    mu_assert(strcmp(json_tape_get_cstr(t, json_tape_get_key(t, b, "c")),
+                     "x") == 0);
+    mu_assert(json_tape_get_double(t, json_tape_get_key(t, 0, "")) == 3);
+    mu_assert(json_tape_get_key(t, 0, "c") == 0);
+    mu_assert(json_tape_get_key(t, b, "b") == 0);
+    json_tape_destroy(t);
+}
+
+static const char* image_document =
+    "{\"id\": 7, \"tags\": [\"a\", \"b\"], \"score\": 1.5, "
+    "\"address\": {\"zip\": null, \"ok\": true}, \"empty\": []}";
+
+// An image, aligned as images must be.
+static uint64_t image[1024];
+
+// Writes the tape of `input` to `image`, returning its length in bytes.
+static size_t write_image(const char* input)
+{
+    Json_tape* t = json_tape_parse(input, NULL);
+    Json_sink* sink = json_sink_create_buffer((char*) image, sizeof(image));
+    size_t length = 0;
+
+    if (t != NULL && json_tape_write_image(t, sink) == 0)
+        length = json_sink_bytes_written(sink);
+    json_sink_destroy(sink);
+    if (t)
+        json_tape_destroy(t);
+    return length;
+}
+
+// Tests that `t` reads as the document `input`, and destroys it.
+static int reads_as(Json_tape* t, const char* input)
+{
+    Json_value* expected = json_parse(input, NULL);
+    char* e = json_stringify(expected);
+    int ok = 0;
+
+    if (t) {
+        Json_value* v = to_value(t, 0);
+        char* s = json_stringify(v);
+        ok = strcmp(s, e) == 0;
+        free(s);
+        json_value_destroy(v);
+        json_tape_destroy(t);
+    }
+    free(e);
+    json_value_destroy(expected);
+    return ok;
+}
+
+static void test_images()
+{
+    const size_t length = write_image(image_document);
+    char path[] = "/tmp/tape.t.XXXXXX";
+    const int fd = mkstemp(path);
+    Json_parse_error e;
+
+    mu_assert(length > 0);
+    mu_assert(reads_as(json_tape_from_image((const char*) image, length,
+                                            NULL), image_document));
+
+    Json_sink* sink = json_sink_create_fd(fd);
+    json_sink_write(sink, (const char*) image, length);
+    mu_assert(json_sink_flush(sink) == 0);
+    json_sink_destroy(sink);
+    close(fd);
+    mu_assert(reads_as(json_tape_map(path, NULL), image_document));
+    unlink(path);
+
+    mu_assert(json_tape_map(path, &e) == NULL);
+    mu_assert(e.code == json_parse_error_io && errno == ENOENT);
+
+    const size_t n = write_image("\"scalar\"");
+    mu_assert(reads_as(json_tape_from_image((const char*) image, n, NULL),
+                       "\"scalar\""));
+}
+
+// Tests that the image is rejected with an error at the byte `offset`.
+static int rejected_at(const char* image, size_t length, size_t offset)
+{
+    Json_parse_error e;
+    return json_tape_from_image(image, length, &e) == NULL
+        && e.code == json_parse_error_invalid_image && e.column == offset;
+}
+
+static void test_invalid_images()
+{
+    static uint64_t copy[1024];
+    char* const bytes = (char*) copy;
+    const size_t length = write_image(image_document);
+    size_t i;
+    int j;
+
+    memcpy(copy, image, length);
+    mu_assert(rejected_at(bytes, 0, 0));
+    mu_assert(rejected_at(bytes + 8, length - 8, 0));
+    mu_assert(rejected_at(bytes, length - 1, 16));
+    bytes[0] = 'j';
+    mu_assert(rejected_at(bytes, length, 0));
+    bytes[0] = 'J';
+
+    // The root object's end, at word 1 of the tape, is past the tape.
+    copy[4] += 100;
+    mu_assert(rejected_at(bytes, length, 32));
+    copy[4] -= 100;
+
+    // The last byte is the nul that ends the last string.
+    bytes[length - 1] = 'x';
+    mu_assert(json_tape_from_image(bytes, length, NULL) == NULL);
+    bytes[length - 1] = '\0';
+
+    // Whatever an image is changed to, it is either rejected or safe to
+    // read in full.
+    for (i = 0; i < length; i++) {
+        for (j = 0; j < 4; j++) {
+            const char b = bytes[i];
+            bytes[i] = j == 0 ? 0 : j == 1 ? (char) 0xff
+                : j == 2 ? b ^ 1 : b + 1;
+            Json_tape* t = json_tape_from_image(bytes, length, NULL);
+            if (t) {
+                Json_value* v = to_value(t, 0);
+                json_value_destroy(v);
+                json_tape_destroy(t);
+            }
+            bytes[i] = b;
+        }
+    }
+    mu_assert(reads_as(json_tape_from_image(bytes, length, NULL),
+                       image_document));
+}
+
+static void run_all_tests()
+{
+    mu_run_test(test_documents);
+    mu_run_test(test_errors);
+    mu_run_test(test_regression_inputs);
+    mu_run_test(test_skip);
+    mu_run_test(test_get_key);
+    mu_run_test(test_images);
+    mu_run_test(test_invalid_images);
+}
+
+int main()
+{
+    run_all_tests();
+    return mu_summarize();
+}
@@ -72,7 +72,7 @@ int main()
             print_value(v);
             json_value_destroy(v);
         } else {
-            fprintf(stderr, "Parse error on line %d, column %d: %d\n",
+            fprintf(stderr, "Parse error on line %zu, column %zu: %d\n",
                     error.line, error.column, error.code);
 
         }
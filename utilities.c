@@ -40,7 +40,7 @@ void* emalloc(size_t n)
 {
     void* p = malloc(n);
     if (p == NULL) {
-        JSON_PANIC(("malloc of %u bytes failed:", n));
+        JSON_PANIC(("malloc of %zu bytes failed:", n));
     }
     return p;
 }
@@ -49,7 +49,7 @@ void* erealloc(void* vp, size_t n)
 {
 	void *p = realloc(vp, n);
 	if (p == NULL) {
-		JSON_PANIC(("realloc of %u bytes failed:", n));
+		JSON_PANIC(("realloc of %zu bytes failed:", n));
     }
 	return p;
 }
@@ -67,3 +67,25 @@ char* estrdup(const char* s)
     memcpy(t, s, n);
     return t;
 }
+
+size_t egrow(size_t size, size_t min)
+{
+    if (size == 0) {
+        size = 1;
+    }
+    while (size < min) {
+        if (size > (size_t) -1 / 2) {
+            JSON_PANIC(("size overflow growing to %zu", min));
+        }
+        size *= 2;
+    }
+    return size;
+}
+
+size_t emul(size_t n, size_t size)
+{
+    if (size != 0 && n > (size_t) -1 / size) {
+        JSON_PANIC(("size overflow: %zu * %zu", n, size));
+    }
+    return n * size;
+}
@@ -27,4 +27,11 @@ void* emalloc(size_t n);
 void* erealloc(void* vp, size_t n);
 char* estrdup(const char* s);
 
+// Returns `size` (if nonzero) doubled as many times as it takes to reach at
+// least `min`. Aborts if the result would not fit in a size_t.
+size_t egrow(size_t size, size_t min);
+
+// Returns `n * size`, aborting if the product would not fit in a size_t.
+size_t emul(size_t n, size_t size);
+
 #endif
@@ -0,0 +1,122 @@
+#!/usr/bin/perl -w
+
+# Generates number_tables.h, the tables of 128-bit approximations of powers of
+# five used by the conversions in number.c.
+#
+#     usage: ./utilities/number_tables.pl > number_tables.h
+#
+# number_powers_of_five (parsing, Eisel-Lemire): entry q holds 5^q (for q
+# from -342 to 308), scaled by a power of two so that its most significant bit
+# is bit 127, truncated to 128 bits. Negative powers are rounded up instead,
+# so that products never underestimate.
+#
+# number_pow5_split and number_pow5_inv_split (formatting, Ryu): 5^i scaled
+# to exactly 125 bits, and 2^(bits(5^i) - 1 + 125) / 5^i rounded up.
+
+use strict;
+use Math::BigInt;
+
+my $SMALLEST = -342;
+my $LARGEST = 308;
+
+my $two128 = Math::BigInt->new(1)->blsft(128);
+my $two127 = Math::BigInt->new(1)->blsft(127);
+my $mask64 = Math::BigInt->new(1)->blsft(64)->bsub(1);
+
+# Smallest z such that 2^z >= n.
+sub bits {
+    my ($n) = @_;
+    my $z = 0;
+    $z++ while Math::BigInt->new(1)->blsft($z)->bcmp($n) < 0;
+    return $z;
+}
+
+# Number of bits in the binary representation of `n`.
+sub bit_length {
+    my ($n) = @_;
+    return length($n->as_bin()) - 2;
+}
+
+sub hex64 {
+    my ($n) = @_;
+    my $h = $n->as_hex();
+    $h =~ s/^0x//;
+    return sprintf("0x%016sull", $h) =~ tr/ /0/r;
+}
+
+print <<'END';
+// Copyright (C) 2003 Daniel Cowgill
+//
+// Usage of the works is permitted provided that this
+// instrument is retained with the works, so that any entity
+// that uses the works is notified of this instrument.
+//
+// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+// Generated by utilities/number_tables.pl; do not edit.
+
+#ifndef __INCLUDED_LIBJSON_NUMBER_TABLES__
+#define __INCLUDED_LIBJSON_NUMBER_TABLES__
+
+END
+print "enum { number_smallest_power_of_five = $SMALLEST };\n";
+print "enum { number_largest_power_of_five = $LARGEST };\n\n";
+print "// { high 64 bits, low 64 bits } of 5^q, for each q in range\n";
+print "static const unsigned long long number_powers_of_five[][2] = {\n";
+
+for my $q ($SMALLEST .. $LARGEST) {
+    my $c;
+    if ($q < 0) {
+        my $power5 = Math::BigInt->new(5)->bpow(-$q);
+        my $z = bits($power5);
+        if ($q >= -27) {
+            $c = Math::BigInt->new(1)->blsft($z + 127)->bdiv($power5)->badd(1);
+        } else {
+            $c = Math::BigInt->new(1)->blsft(2*$z + 128)->bdiv($power5)->badd(1);
+            $c->brsft(1) while $c->bcmp($two128) >= 0;
+        }
+    } else {
+        $c = Math::BigInt->new(5)->bpow($q);
+        $c->blsft(1) while $c->bcmp($two127) < 0;
+        $c->brsft(1) while $c->bcmp($two128) >= 0;
+    }
+    my $hi = $c->copy()->brsft(64);
+    my $lo = $c->copy()->band($mask64);
+    printf("    { %s, %s }, // 5^%d\n", hex64($hi), hex64($lo), $q);
+}
+
+print "};\n\n";
+
+my $POW5_BITCOUNT = 125;
+my $POW5_INV_BITCOUNT = 125;
+my $POW5_TABLE_SIZE = 326;
+my $POW5_INV_TABLE_SIZE = 342;
+
+print "enum { number_pow5_bitcount = $POW5_BITCOUNT };\n";
+print "enum { number_pow5_inv_bitcount = $POW5_INV_BITCOUNT };\n\n";
+
+print "// { low 64 bits, high 64 bits } of 5^i, scaled to $POW5_BITCOUNT bits\n";
+print "static const unsigned long long number_pow5_split[][2] = {\n";
+for my $i (0 .. $POW5_TABLE_SIZE - 1) {
+    my $pow = Math::BigInt->new(5)->bpow($i);
+    my $shift = bit_length($pow) - $POW5_BITCOUNT;
+    my $c = $shift >= 0 ? $pow->copy()->brsft($shift)
+                        : $pow->copy()->blsft(-$shift);
+    my $hi = $c->copy()->brsft(64);
+    my $lo = $c->copy()->band($mask64);
+    printf("    { %s, %s }, // 5^%d\n", hex64($lo), hex64($hi), $i);
+}
+print "};\n\n";
+
+print "// { low 64 bits, high 64 bits } of 2^(bits(5^i) - 1 + ";
+print "$POW5_INV_BITCOUNT) / 5^i, plus one\n";
+print "static const unsigned long long number_pow5_inv_split[][2] = {\n";
+for my $i (0 .. $POW5_INV_TABLE_SIZE - 1) {
+    my $pow = Math::BigInt->new(5)->bpow($i);
+    my $j = bit_length($pow) - 1 + $POW5_INV_BITCOUNT;
+    my $c = Math::BigInt->new(1)->blsft($j)->bdiv($pow)->badd(1);
+    my $hi = $c->copy()->brsft(64);
+    my $lo = $c->copy()->band($mask64);
+    printf("    { %s, %s }, // 5^-%d\n", hex64($lo), hex64($hi), $i);
+}
+print "};\n\n#endif\n";